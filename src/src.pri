@@ -1,15 +1,27 @@
 CONFIG += C++11
 INCLUDEPATH += $$PWD$$/src
 
+# keep a * b + c unfused, the SIMD kernels match their scalar paths bit for
+# bit only then ( see three/math/simd.hpp )
+gcc|clang: QMAKE_CXXFLAGS += -ffp-contract=off
+msvc: QMAKE_CXXFLAGS += /fp:precise
+
 HEADERS += \
     $$PWD/three/math/vector2.h \
     $$PWD/three/math/vector3.h \
     $$PWD/three/math/vector4.h \
     $$PWD/three/math/quaternion.h \
     $$PWD/three/math/euler.h \
+    $$PWD/three/math/rotation.h \
     $$PWD/three/math/math.hpp \
+    $$PWD/three/math/uuid.h \
+    $$PWD/three/math/random.h \
     $$PWD/three/math/math_forword_declar.h \
+    $$PWD/three/math/simd.hpp \
+    $$PWD/three/math/parallel.hpp \
     $$PWD/three/math/matrix4.h \
+    $$PWD/three/math/matrix4f.h \
+    $$PWD/three/math/vector3f.h \
     $$PWD/three/math/matrix3.h \
     $$PWD/three/math/line3.h \
     $$PWD/three/math/triangle.h \
@@ -20,11 +32,22 @@ HEADERS += \
     $$PWD/three/math/frustum.h \
     $$PWD/three/math/sphere.h \
     $$PWD/three/math/ray.h \
+    $$PWD/three/math/bvh.h \
+    $$PWD/three/math/raypacket.h \
+    $$PWD/three/math/spatialhashgrid.h \
+    $$PWD/three/math/dynamicaabbtree.h \
+    $$PWD/three/math/looseoctree.h \
+    $$PWD/three/math/kdtree.h \
     $$PWD/three/math/color.h \
     $$PWD/three/core/bufferattribute.h \
+    $$PWD/three/core/interleavedbuffer.h \
     $$PWD/three/core/face3.h \
     $$PWD/three/core/layers.h \
-    $$PWD/three/core/object3d.h
+    $$PWD/three/core/object3d.h \
+    $$PWD/three/core/scenegraph.h \
+    $$PWD/three/core/frustumculler.h \
+    $$PWD/three/animation/animationclip.h \
+    $$PWD/three/animation/animationmixer.h
 
 SOURCES += \
     $$PWD/three/math/vector2.cpp \
@@ -32,7 +55,10 @@ SOURCES += \
     $$PWD/three/math/vecotr4.cpp \
     $$PWD/three/math/quaternion.cpp \
     $$PWD/three/math/euler.cpp \
+    $$PWD/three/math/random.cpp \
+    $$PWD/three/math/rotation.cpp \
     $$PWD/three/math/matrix4.cpp \
+    $$PWD/three/math/matrix4f.cpp \
     $$PWD/three/math/matrix3.cpp \
     $$PWD/three/math/line3.cpp \
     $$PWD/three/math/triangle.cpp \
@@ -43,8 +69,18 @@ SOURCES += \
     $$PWD/three/math/frustum.cpp \
     $$PWD/three/math/sphere.cpp \
     $$PWD/three/math/ray.cpp \
+    $$PWD/three/math/bvh.cpp \
+    $$PWD/three/math/raypacket.cpp \
+    $$PWD/three/math/spatialhashgrid.cpp \
+    $$PWD/three/math/dynamicaabbtree.cpp \
+    $$PWD/three/math/looseoctree.cpp \
+    $$PWD/three/math/kdtree.cpp \
     $$PWD/three/math/color.cpp \
     $$PWD/three/core/bufferattribute.cpp \
     $$PWD/three/core/face3.cpp \
     $$PWD/three/core/layers.cpp \
-    $$PWD/three/core/object3d.cpp
+    $$PWD/three/core/object3d.cpp \
+    $$PWD/three/core/scenegraph.cpp \
+    $$PWD/three/core/frustumculler.cpp \
+    $$PWD/three/animation/animationclip.cpp \
+    $$PWD/three/animation/animationmixer.cpp
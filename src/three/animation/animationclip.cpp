@@ -0,0 +1,138 @@
+#include "animationclip.h"
+
+#include <algorithm>
+
+#include "../math/vector3.h"
+#include "../math/quaternion.h"
+#include "../math/spline.h"
+
+namespace three {
+
+int AnimationClip::addTrack(const QString &target, const Property &property, const double *times,
+                            const double *values, const int &keyCount, const Interpolation &interpolation)
+{
+    Q_ASSERT( keyCount > 0 );
+
+    const int size = AnimationClip::valueSize( property );
+
+    Track track;
+    track.target = target;
+    track.property = property;
+    track.interpolation = interpolation;
+    track.firstKey = this->times.size();
+    track.keyCount = keyCount;
+    track.valueOffset = this->values.size();
+
+    for ( int k = 0; k < keyCount; k ++ ) {
+        Q_ASSERT( k == 0 || times[ k - 1 ] <= times[ k ] );
+        this->times.append( times[ k ] );
+    }
+    for ( int i = 0; i < keyCount * size; i ++ ) {
+        this->values.append( values[ i ] );
+    }
+
+    this->tracks.append( track );
+
+    if ( this->durationFromKeys ) {
+        this->duration = std::max( this->duration, times[ keyCount - 1 ] );
+    }
+
+    return this->tracks.size() - 1;
+}
+
+int AnimationClip::addTrack(const QString &target, const Property &property, const Float32Array &times,
+                            const Vector3Array &values, const Interpolation &interpolation)
+{
+    Q_ASSERT( property != QuaternionProperty );
+    Q_ASSERT( times.size() == values.size() && !times.isEmpty() );
+    return this->addTrack( target, property, times.constData(), &values.constData()->x, times.size(), interpolation );
+}
+
+int AnimationClip::addTrack(const QString &target, const Float32Array &times, const QVector<Quaternion> &values,
+                            const Interpolation &interpolation)
+{
+    Q_ASSERT( times.size() == values.size() && !times.isEmpty() );
+    return this->addTrack( target, QuaternionProperty, times.constData(), &values.constData()->x, times.size(),
+                           interpolation );
+}
+
+AnimationClip &AnimationClip::resetDuration()
+{
+    double duration = 0;
+    for ( const Track& track : this->tracks ) {
+        duration = std::max( duration, this->times[ track.firstKey + track.keyCount - 1 ] );
+    }
+    this->duration = duration;
+    this->durationFromKeys = true;
+    return *this;
+}
+
+int AnimationClip::findKey(const int &track, const double &time, int &cursor) const
+{
+    const Track& t = this->tracks[ track ];
+    const double* times = this->times.constData() + t.firstKey;
+    const int last = t.keyCount - 2;
+
+    if ( last < 0 ) {
+        return cursor = 0;
+    }
+
+    int k = cursor;
+    if ( k >= 0 && k <= last && times[ k ] <= time ) {
+        // still in the same segment, or moved on to the next one
+        if ( time < times[ k + 1 ] || k == last ) {
+            return k;
+        }
+        if ( k + 1 == last || time < times[ k + 2 ] ) {
+            return cursor = k + 1;
+        }
+    }
+
+    k = int( std::upper_bound( times, times + t.keyCount, time ) - times ) - 1;
+    return cursor = std::max( 0, std::min( k, last ) );
+}
+
+void AnimationClip::sample(const int &track, const double &time, int &cursor, double *out) const
+{
+    const Track& t = this->tracks[ track ];
+    const int size = AnimationClip::valueSize( t.property );
+    const double* times = this->times.constData() + t.firstKey;
+    const double* values = this->values.constData() + t.valueOffset;
+
+    const int k = this->findKey( track, time, cursor );
+
+    if ( t.keyCount == 1 || time <= times[ k ] ) {
+        std::copy( values + k * size, values + ( k + 1 ) * size, out );
+        return;
+    }
+    if ( time >= times[ k + 1 ] ) {
+        std::copy( values + ( k + 1 ) * size, values + ( k + 2 ) * size, out );
+        return;
+    }
+
+    const double alpha = ( time - times[ k ] ) / ( times[ k + 1 ] - times[ k ] );
+
+    if ( t.interpolation == Discrete ) {
+        std::copy( values + k * size, values + ( k + 1 ) * size, out );
+    } else if ( t.property == QuaternionProperty ) {
+        Quaternion::slerpFlat( out, 0, values, k * 4, values, ( k + 1 ) * 4, alpha );
+    } else if ( t.interpolation == Linear ) {
+        const double* v0 = values + k * 3;
+        const double* v1 = v0 + 3;
+        for ( int c = 0; c < 3; c ++ ) {
+            out[ c ] = v0[ c ] + ( v1[ c ] - v0[ c ] ) * alpha;
+        }
+    } else {
+        // the end keys are repeated, like Spline::getPoint does
+        const double* p0 = values + std::max( k - 1, 0 ) * 3;
+        const double* p1 = values + k * 3;
+        const double* p2 = values + ( k + 1 ) * 3;
+        const double* p3 = values + std::min( k + 2, t.keyCount - 1 ) * 3;
+        const double alpha2 = alpha * alpha, alpha3 = alpha * alpha2;
+        for ( int c = 0; c < 3; c ++ ) {
+            out[ c ] = Spline::interpolate( p0[ c ], p1[ c ], p2[ c ], p3[ c ], alpha, alpha2, alpha3 );
+        }
+    }
+}
+
+} // namespace three
@@ -0,0 +1,96 @@
+#ifndef THREE_ANIMATIONCLIP_H
+#define THREE_ANIMATIONCLIP_H
+
+#include <QString>
+#include <QVector>
+
+#include "../math/math_forword_declar.h"
+
+namespace three {
+
+// Keyframe tracks of one animation, e.g. a walk cycle of a skeleton.
+//
+// The keys of all tracks share two flat pools: times holds the key times of
+// track i at [ firstKey, firstKey + keyCount ), values holds its values,
+// valueSize( property ) doubles per key from valueOffset on ( x, y, z for
+// position and scale, x, y, z, w for quaternion ). A clip is read-only
+// while it is played and may be shared by any number of AnimationMixer
+// actions, one per animated character.
+class AnimationClip
+{
+public:
+    enum Property {
+        PositionProperty,
+        QuaternionProperty,
+        ScaleProperty
+    };
+
+    // Between two keys: hold the earlier value, lerp ( slerp for
+    // quaternions ), or a Catmull-Rom curve through the neighbouring keys
+    // with Spline::interpolate. Quaternion tracks treat Smooth as Linear.
+    enum Interpolation {
+        Discrete,
+        Linear,
+        Smooth
+    };
+
+    struct Track
+    {
+        QString             target;         // node name, empty for the root
+        Property            property;
+        Interpolation       interpolation;
+        int                 firstKey;
+        int                 keyCount;
+        int                 valueOffset;
+    };
+
+    // with duration < 0 the duration is the time of the last key
+    explicit AnimationClip( const QString& name = QString(), const double& duration = -1 ):
+        name(name),
+        duration(duration < 0 ? 0 : duration),
+        durationFromKeys(duration < 0)
+    { }
+
+    // Appends a track of keyCount keys, times ascending, and returns its
+    // index. Grows duration when it was derived from the keys.
+    int addTrack( const QString& target, const Property& property, const double* times, const double* values,
+                  const int& keyCount, const Interpolation& interpolation = Linear );
+
+    int addTrack( const QString& target, const Property& property, const Float32Array& times,
+                  const Vector3Array& values, const Interpolation& interpolation = Linear );
+
+    int addTrack( const QString& target, const Float32Array& times, const QVector<Quaternion>& values,
+                  const Interpolation& interpolation = Linear );
+
+    // time of the last key of any track
+    AnimationClip& resetDuration();
+
+    // The key of track at or before time, clamped to the last segment, so
+    // key and key + 1 bound time unless the track has a single key. cursor
+    // is the key found by the previous call: a time in the same or the next
+    // segment is found in constant time, anything else by binary search.
+    int findKey( const int& track, const double& time, int& cursor ) const;
+
+    // the value of track at time, valueSize doubles into out
+    void sample( const int& track, const double& time, int& cursor, double* out ) const;
+
+    static int valueSize( const Property& property )
+    {
+        return property == QuaternionProperty ? 4 : 3;
+    }
+
+    // private:
+    QString                 name;
+    double                  duration;
+
+    QVector<Track>          tracks;
+    Float32Array            times;
+    Float32Array            values;
+
+private:
+    bool                    durationFromKeys;
+};
+
+} // namespace three
+
+#endif // THREE_ANIMATIONCLIP_H
@@ -0,0 +1,262 @@
+#include "animationmixer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+
+#include "../core/object3d.h"
+#include "../math/parallel.hpp"
+
+namespace three {
+
+namespace {
+
+const int ActionsPerTask = 64;
+const int QuaternionsPerBatch = 64;
+
+// values are written in place, as x, y, z ( , w )
+static_assert( offsetof( Vector3, y ) == sizeof( double ) && offsetof( Vector3, z ) == 2 * sizeof( double ),
+               "Vector3 must be x, y, z" );
+static_assert( offsetof( Quaternion, y ) == sizeof( double ) && offsetof( Quaternion, z ) == 2 * sizeof( double ) &&
+               offsetof( Quaternion, w ) == 3 * sizeof( double ), "Quaternion must be x, y, z, w" );
+
+// the graph's arrays, taken once per update
+struct Targets
+{
+    Vector3*            positions;
+    Quaternion*         quaternions;
+    Vector3*            scales;
+    quint16*            flags;
+    const int*          slots;
+};
+
+// quaternions waiting to be interpolated as one batch
+struct QuaternionBatch
+{
+    double              q0[ QuaternionsPerBatch * 4 ];
+    double              q1[ QuaternionsPerBatch * 4 ];
+    double              t[ QuaternionsPerBatch ];
+    Quaternion*         targets[ QuaternionsPerBatch ];
+    int                 count;
+
+    void add( const double* a, const double* b, const double& alpha, Quaternion* target, const bool& approximate )
+    {
+        std::copy( a, a + 4, this->q0 + this->count * 4 );
+        std::copy( b, b + 4, this->q1 + this->count * 4 );
+        this->t[ this->count ] = alpha;
+        this->targets[ this->count ] = target;
+
+        if ( ++ this->count == QuaternionsPerBatch ) {
+            this->flush( approximate );
+        }
+    }
+
+    void flush( const bool& approximate )
+    {
+        if ( approximate ) {
+            Quaternion::fastSlerpFlat( this->q0, this->q0, this->q1, this->count, this->t );
+        } else {
+            Quaternion::slerpFlat( this->q0, this->q0, this->q1, this->count, this->t );
+        }
+
+        for ( int i = 0; i < this->count; i ++ ) {
+            const double* q = this->q0 + i * 4;
+            this->targets[ i ]->set( q[ 0 ], q[ 1 ], q[ 2 ], q[ 3 ] );
+        }
+        this->count = 0;
+    }
+};
+
+// moves the action's time on, false if there is nothing to sample
+bool advance( AnimationMixer::Action& action, const double& deltaTime )
+{
+    if ( action.paused || action.finished )
+        return false;
+
+    const double duration = action.clip->duration;
+    double time = action.time + deltaTime * action.timeScale;
+
+    if ( action.loop == AnimationMixer::LoopRepeat ) {
+        if ( duration > 0 ) {
+            time = std::fmod( time, duration );
+            if ( time < 0 ) time += duration;
+        } else {
+            time = 0;
+        }
+    } else if ( time >= duration || time < 0 ) {
+        // the last frame ( first, when played backwards ) is still sampled
+        time = time < 0 ? 0 : duration;
+        action.finished = true;
+    }
+
+    action.time = time;
+    return true;
+}
+
+void sampleAction( const AnimationMixer::Action& action, const SceneGraph::NodeId* bindings, int* cursors,
+                   const Targets& targets, QuaternionBatch& batch, const bool& approximate )
+{
+    const AnimationClip& clip = *action.clip;
+    const double time = action.time;
+
+    for ( int i = 0; i < clip.tracks.size(); i ++ ) {
+        SceneGraph::NodeId node = bindings[ i ];
+        if ( node == SceneGraph::NoNode )
+            continue;
+
+        const AnimationClip::Track& track = clip.tracks[ i ];
+        const int s = targets.slots[ node ];
+        quint16& flags = targets.flags[ s ];
+
+        switch ( track.property ) {
+        case AnimationClip::PositionProperty:
+            clip.sample( i, time, cursors[ i ], &targets.positions[ s ].x );
+            flags |= SceneGraph::MatrixNeedsUpdate;
+            break;
+
+        case AnimationClip::ScaleProperty:
+            clip.sample( i, time, cursors[ i ], &targets.scales[ s ].x );
+            flags |= SceneGraph::MatrixNeedsUpdate;
+            break;
+
+        case AnimationClip::QuaternionProperty: {
+            Quaternion* target = targets.quaternions + s;
+            const double* times = clip.times.constData() + track.firstKey;
+            int k = clip.findKey( i, time, cursors[ i ] );
+
+            if ( track.interpolation == AnimationClip::Discrete || track.keyCount == 1 ||
+                 time <= times[ k ] || time >= times[ k + 1 ] ) {
+                clip.sample( i, time, cursors[ i ], &target->x );
+            } else {
+                const double* values = clip.values.constData() + track.valueOffset + k * 4;
+                batch.add( values, values + 4, ( time - times[ k ] ) / ( times[ k + 1 ] - times[ k ] ), target,
+                           approximate );
+            }
+
+            // the new quaternion wins over an edited rotation
+            flags = ( flags & ~SceneGraph::RotationChanged ) |
+                    SceneGraph::MatrixNeedsUpdate | SceneGraph::QuaternionChanged;
+            break;
+        }
+        }
+    }
+}
+
+} // namespace
+
+int AnimationMixer::play(const AnimationClip *clip, const Object3D &root, const Loop &loop,
+                         const double &timeScale, const double &startTime)
+{
+    Q_ASSERT( clip != nullptr );
+    Q_ASSERT( !root.isNull() && root.graph == this->graph );
+
+    Action action;
+    action.clip = clip;
+    action.time = startTime;
+    action.timeScale = timeScale;
+    action.loop = loop;
+    action.paused = false;
+    action.finished = false;
+    action.firstBinding = this->bindings.size();
+
+    for ( const AnimationClip::Track& track : clip->tracks ) {
+        SceneGraph::NodeId node = track.target.isEmpty() ? root.node
+                                                         : this->graph->findByName( track.target, root.node );
+        this->bindings.append( node );
+        this->serials.append( node == SceneGraph::NoNode ? 0 : this->graph->info( node ).serial );
+        this->cursors.append( 0 );
+    }
+
+    this->actions.append( action );
+    return this->actions.size() - 1;
+}
+
+void AnimationMixer::stop(const int &index)
+{
+    Action& action = this->actions[ index ];
+    action.time = 0;
+    action.finished = true;
+
+    const int count = action.clip->tracks.size();
+    std::fill( this->cursors.begin() + action.firstBinding, this->cursors.begin() + action.firstBinding + count, 0 );
+}
+
+void AnimationMixer::remove(const int &index)
+{
+    const Action& action = this->actions[ index ];
+    const int first = action.firstBinding;
+    const int count = action.clip->tracks.size();
+
+    this->bindings.remove( first, count );
+    this->serials.remove( first, count );
+    this->cursors.remove( first, count );
+    this->actions.remove( index );
+
+    for ( int a = index; a < this->actions.size(); a ++ ) {
+        this->actions[ a ].firstBinding -= count;
+    }
+}
+
+void AnimationMixer::validateBindings()
+{
+    const SceneGraph& graph = *this->graph;
+    if ( this->destroyedCount == graph.destroyedCount )
+        return;
+
+    // a recycled NodeId is alive again, but with a new serial
+    for ( int i = 0; i < this->bindings.size(); i ++ ) {
+        SceneGraph::NodeId node = this->bindings[ i ];
+        if ( node != SceneGraph::NoNode &&
+             ( !graph.contains( node ) || graph.info( node ).serial != this->serials[ i ] ) ) {
+            this->bindings[ i ] = SceneGraph::NoNode;
+        }
+    }
+    this->destroyedCount = graph.destroyedCount;
+}
+
+void AnimationMixer::update(const double &deltaTime, const bool &parallel)
+{
+    if ( this->actions.isEmpty() )
+        return;
+
+    this->validateBindings();
+
+    SceneGraph& graph = *this->graph;
+
+    // detach once here, the tasks below only write through the pointers
+    Targets targets;
+    targets.positions = graph.positions.data();
+    targets.quaternions = graph.quaternions.data();
+    targets.scales = graph.scales.data();
+    targets.flags = graph.flags.data();
+    targets.slots = graph.slots.constData();
+
+    Action* actions = this->actions.data();
+    const SceneGraph::NodeId* bindings = this->bindings.constData();
+    int* cursors = this->cursors.data();
+    const bool approximate = this->approximateSlerp;
+
+    auto body = [=]( int begin, int end ) {
+        QuaternionBatch batch;
+        batch.count = 0;
+
+        for ( int a = begin; a < end; a ++ ) {
+            Action& action = actions[ a ];
+            if ( advance( action, deltaTime ) ) {
+                sampleAction( action, bindings + action.firstBinding, cursors + action.firstBinding, targets,
+                              batch, approximate );
+            }
+        }
+        batch.flush( approximate );
+    };
+
+    if ( parallel ) {
+        Parallel::forRange( this->actions.size(), ActionsPerTask, body );
+    } else {
+        body( 0, this->actions.size() );
+    }
+
+    graph.pendingChanges = true;
+}
+
+} // namespace three
@@ -0,0 +1,107 @@
+#ifndef THREE_ANIMATIONMIXER_H
+#define THREE_ANIMATIONMIXER_H
+
+#include <QVector>
+
+#include "../core/scenegraph.h"
+#include "animationclip.h"
+
+namespace three {
+
+class Object3D;
+
+// Plays AnimationClips on the nodes of a SceneGraph, e.g. one action per
+// character of a crowd sharing a handful of clips.
+//
+// play() resolves the tracks of a clip to nodes once. update() then
+// advances every action and samples all of its tracks straight into the
+// graph's position / quaternion / scale arrays, marking the nodes changed
+// for the next updateMatrixWorld(). Each track keeps the key it found last,
+// so sampling forward in time costs no search. Interpolated quaternions of
+// many tracks are gathered and blended as one Quaternion::slerpFlat batch,
+// or fastSlerpFlat with approximateSlerp set.
+//
+// Actions are not blended: a property animated by two actions ends up with
+// the value of the later one, and in the parallel mode no two actions may
+// animate the same node.
+//
+// Nodes destroyed while an action plays are dropped from its bindings on
+// the next update(), even when create() has handed their NodeId out again.
+class AnimationMixer
+{
+public:
+    enum Loop {
+        LoopOnce,       // holds the last frame and finishes
+        LoopRepeat
+    };
+
+    struct Action
+    {
+        const AnimationClip*    clip;
+        double                  time;
+        double                  timeScale;
+        Loop                    loop;
+        bool                    paused;
+        bool                    finished;
+        int                     firstBinding;   // tracks of the clip from here on in bindings / cursors
+    };
+
+    explicit AnimationMixer( SceneGraph* graph ):
+        graph(graph),
+        approximateSlerp(false),
+        destroyedCount(graph->destroyedCount)
+    { }
+
+    // Starts clip on root and the nodes below it, returns the action's
+    // index. Tracks are bound by name, a track with an empty target animates
+    // root, tracks whose target is not found are skipped. clip must outlive
+    // the action.
+    int play( const AnimationClip* clip, const Object3D& root, const Loop& loop = LoopRepeat,
+              const double& timeScale = 1, const double& startTime = 0 );
+
+    Action& action( const int& index )
+    {
+        return this->actions[ index ];
+    }
+
+    const Action& action( const int& index ) const
+    {
+        return this->actions[ index ];
+    }
+
+    int size() const
+    {
+        return this->actions.size();
+    }
+
+    // Finishes the action and rewinds it, its nodes keep their last
+    // values. Clear finished to play it again.
+    void stop( const int& index );
+
+    // Removes the action and its bindings, the actions after it move down
+    // by one index.
+    void remove( const int& index );
+
+    // Advances every action that is neither paused nor finished by
+    // deltaTime * timeScale and writes its tracks into the graph. With
+    // parallel set, the actions are spread across the global thread pool.
+    void update( const double& deltaTime, const bool& parallel = false );
+
+    // private:
+    SceneGraph*                     graph;
+    bool                            approximateSlerp;
+
+    QVector<Action>                 actions;
+    QVector<SceneGraph::NodeId>     bindings;   // NoNode for unbound tracks
+    QVector<quint64>                serials;    // NodeInfo::serial of the bound nodes
+    QVector<int>                    cursors;
+    quint64                         destroyedCount;     // of the graph when the bindings were last checked
+
+private:
+    // unbinds the tracks whose nodes were destroyed since the last check
+    void validateBindings();
+};
+
+} // namespace three
+
+#endif // THREE_ANIMATIONMIXER_H
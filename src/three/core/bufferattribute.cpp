@@ -2,7 +2,117 @@
 
 namespace three {
 
+BufferAttribute &BufferAttribute::copyArray(const Float32Array &array)
+{
+    int count = std::min( this->count(), array.size() / this->itemSize );
 
+    for ( int i = 0, k = 0; i < count; i ++ ) {
+        for ( int c = 0; c < this->itemSize; c ++, k ++ ) {
+            this->set( i, c, array[ k ] );
+        }
+    }
+    return *this;
+}
 
-} // namespace three
+Float32Array BufferAttribute::toArray() const
+{
+    Float32Array array( this->count() * this->itemSize );
+
+    for ( int i = 0, k = 0; i < this->count(); i ++ ) {
+        for ( int c = 0; c < this->itemSize; c ++, k ++ ) {
+            array[ k ] = this->get( i, c );
+        }
+    }
+    return array;
+}
+
+BufferAttribute BufferAttribute::clone() const
+{
+    // packs the items into a buffer of their own
+    BufferAttribute attribute( this->type, this->itemSize, this->count() );
+    int itemBytes = this->itemSize * componentSize( this->type );
+
+    for ( int i = 0; i < this->count(); i ++ ) {
+        std::memcpy( attribute.itemData( i ), this->itemData( i ), itemBytes );
+    }
+    return attribute;
+}
+
+// https://en.wikipedia.org/wiki/Half-precision_floating-point_format
+float BufferAttribute::halfToFloat(const quint16 &h)
+{
+    quint32 sign = quint32( h & 0x8000 ) << 16;
+    quint32 exponent = ( h >> 10 ) & 0x1f;
+    quint32 mantissa = h & 0x3ff;
+    quint32 bits;
+
+    if ( exponent == 0 ) {
+        if ( mantissa == 0 ) {
+            bits = sign;
+        } else {
+            // subnormal, renormalize
+            exponent = 127 - 15 + 1;
+            while ( ( mantissa & 0x400 ) == 0 ) {
+                mantissa <<= 1;
+                exponent --;
+            }
+            bits = sign | ( exponent << 23 ) | ( ( mantissa & 0x3ff ) << 13 );
+        }
+    } else if ( exponent == 0x1f ) {
+        // inf / nan
+        bits = sign | 0x7f800000 | ( mantissa << 13 );
+    } else {
+        bits = sign | ( ( exponent + 127 - 15 ) << 23 ) | ( mantissa << 13 );
+    }
+
+    float f;
+    std::memcpy( &f, &bits, sizeof( f ) );
+    return f;
+}
 
+quint16 BufferAttribute::floatToHalf(const float &f)
+{
+    quint32 bits;
+    std::memcpy( &bits, &f, sizeof( bits ) );
+
+    quint16 sign = quint16( ( bits >> 16 ) & 0x8000 );
+    qint32 exponent = qint32( ( bits >> 23 ) & 0xff ) - 127 + 15;
+    quint32 mantissa = bits & 0x7fffff;
+
+    if ( ( ( bits >> 23 ) & 0xff ) == 0xff ) {
+        // inf / nan, keep nan a nan
+        return sign | 0x7c00 | ( mantissa ? 0x200 : 0 );
+    }
+
+    if ( exponent >= 0x1f ) {
+        // overflow to inf
+        return sign | 0x7c00;
+    }
+
+    if ( exponent <= 0 ) {
+        // subnormal or zero
+        if ( exponent < -10 ) {
+            return sign;
+        }
+        mantissa |= 0x800000;
+        int shift = 14 - exponent;
+        quint32 half = mantissa >> shift;
+        // round to nearest even
+        quint32 rest = mantissa & ( ( 1u << shift ) - 1 );
+        quint32 halfway = 1u << ( shift - 1 );
+        if ( rest > halfway || ( rest == halfway && ( half & 1 ) ) ) {
+            half ++;
+        }
+        return sign | quint16( half );
+    }
+
+    quint16 half = sign | quint16( exponent << 10 ) | quint16( mantissa >> 13 );
+    // round to nearest even, a carry into the exponent is still correct
+    quint32 rest = mantissa & 0x1fff;
+    if ( rest > 0x1000 || ( rest == 0x1000 && ( half & 1 ) ) ) {
+        half ++;
+    }
+    return half;
+}
+
+} // namespace three
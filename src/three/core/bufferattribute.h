@@ -1,16 +1,223 @@
 #ifndef THREE_BUFFERATTRIBUTE_H
 #define THREE_BUFFERATTRIBUTE_H
 
+#include "../math/math_forword_declar.h"
+#include "../math/math.hpp"
+#include "interleavedbuffer.h"
+
+#include <cstring>
 
 namespace three {
 
+// Typed view over an InterleavedBuffer: `count` items of `itemSize`
+// components, item i starting `offset + i * stride` bytes into the buffer.
+// Components are read and written as double whatever the storage type.
 class BufferAttribute
 {
 public:
-    BufferAttribute()
+    enum Type {
+        Float32,
+        Float64,            // read in place by the double math kernels
+        Int16Normalized,    // [ -1, 1 ] <-> [ -32767, 32767 ]
+        UInt8,
+        Half                // IEEE 754 binary16
+    };
+
+    BufferAttribute():
+        type(Float32),
+        itemSize(0),
+        offset(0)
+    { }
+
+    // packed, owned storage for `count` items
+    BufferAttribute(const Type& type, const int& itemSize, const int& count):
+        data(InterleavedBufferPtr(new InterleavedBuffer( count, itemSize * componentSize( type ) ))),
+        type(type),
+        itemSize(itemSize),
+        offset(0)
+    { }
+
+    // copies ( and converts ) `array`
+    BufferAttribute(const Float32Array& array, const int& itemSize, const Type& type = Float64):
+        data(InterleavedBufferPtr(new InterleavedBuffer( array.size() / itemSize, itemSize * componentSize( type ) ))),
+        type(type),
+        itemSize(itemSize),
+        offset(0)
+    {
+        this->copyArray( array );
+    }
+
+    // view into a shared, possibly interleaved buffer, `offset` in bytes
+    BufferAttribute(const InterleavedBufferPtr& data, const Type& type, const int& itemSize, const int& offset = 0):
+        data(data),
+        type(type),
+        itemSize(itemSize),
+        offset(offset)
+    {
+        Q_ASSERT( offset + itemSize * componentSize( type ) <= data->stride );
+    }
+
+    // wraps externally owned memory without copying, `stride` in bytes
+    // ( 0: packed items )
+    static BufferAttribute fromRawData(void* memory, const Type& type, const int& itemSize, const int& count,
+                                       const int& stride = 0, const int& offset = 0)
+    {
+        int itemStride = stride != 0 ? stride : itemSize * componentSize( type );
+        InterleavedBufferPtr buffer( new InterleavedBuffer( memory, count, itemStride ) );
+        return BufferAttribute( buffer, type, itemSize, offset );
+    }
+
+    static int componentSize(const Type& type)
+    {
+        switch ( type ) {
+        case Float32: return 4;
+        case Float64: return 8;
+        case Int16Normalized: return 2;
+        case UInt8: return 1;
+        case Half: return 2;
+        }
+        return 0;
+    }
+
+    bool isNull() const
+    {
+        return this->data.isNull();
+    }
+
+    // 0 for a null attribute
+    int count() const
+    {
+        return this->data.isNull() ? 0 : this->data->count;
+    }
+
+    int stride() const
+    {
+        return this->data.isNull() ? 0 : this->data->stride;
+    }
+
+    // Whether the components can be accessed in place through a T*: the
+    // offset, the stride and the start of the buffer all aligned for T.
+    // Views at odd byte offsets or unaligned raw memory must go through
+    // get() / set() instead.
+    template<typename T>
+    bool isAlignedFor() const
+    {
+        return !this->data.isNull() &&
+                this->offset % int( sizeof( T ) ) == 0 && this->data->stride % int( sizeof( T ) ) == 0 &&
+                quintptr( this->itemData( 0 ) ) % alignof( T ) == 0;
+    }
+
+    // first byte of item `index`
+    char* itemData(const int& index)
+    {
+        return this->data->data() + this->offset + qptrdiff( index ) * this->data->stride;
+    }
+
+    const char* itemData(const int& index) const
+    {
+        return this->data->data() + this->offset + qptrdiff( index ) * this->data->stride;
+    }
+
+    double get(const int& index, const int& component) const
     {
+        Q_ASSERT( component < this->itemSize );
+        return readComponent( this->type, this->itemData( index ) + component * componentSize( this->type ) );
+    }
+
+    BufferAttribute& set(const int& index, const int& component, const double& value)
+    {
+        Q_ASSERT( component < this->itemSize );
+        writeComponent( this->type, this->itemData( index ) + component * componentSize( this->type ), value );
+        return *this;
+    }
+
+    double getX(const int& index) const { return this->get( index, 0 ); }
+    double getY(const int& index) const { return this->get( index, 1 ); }
+    double getZ(const int& index) const { return this->get( index, 2 ); }
+    double getW(const int& index) const { return this->get( index, 3 ); }
+
+    BufferAttribute& setX(const int& index, const double& x) { return this->set( index, 0, x ); }
+    BufferAttribute& setY(const int& index, const double& y) { return this->set( index, 1, y ); }
+    BufferAttribute& setZ(const int& index, const double& z) { return this->set( index, 2, z ); }
+    BufferAttribute& setW(const int& index, const double& w) { return this->set( index, 3, w ); }
+
+    BufferAttribute& setXY(const int& index, const double& x, const double& y)
+    {
+        return this->set( index, 0, x ).set( index, 1, y );
+    }
+
+    BufferAttribute& setXYZ(const int& index, const double& x, const double& y, const double& z)
+    {
+        return this->set( index, 0, x ).set( index, 1, y ).set( index, 2, z );
+    }
+
+    BufferAttribute& setXYZW(const int& index, const double& x, const double& y, const double& z, const double& w)
+    {
+        return this->set( index, 0, x ).set( index, 1, y ).set( index, 2, z ).set( index, 3, w );
+    }
+
+    BufferAttribute& copyArray(const Float32Array& array);
+
+    Float32Array toArray() const;
 
+    // setters do not track changes, report them here for partial uploads
+    BufferAttribute& markDirty(const int& index, const int& count)
+    {
+        this->data->markDirty( index, count );
+        return *this;
     }
+
+    BufferAttribute& setNeedsUpdate()
+    {
+        this->data->setNeedsUpdate();
+        return *this;
+    }
+
+    // not a deep copy: shares the buffer, see clone()
+    BufferAttribute& copy(const BufferAttribute& source )
+    {
+        *this = source;
+        return *this;
+    }
+
+    BufferAttribute clone() const;
+
+    static double readComponent(const Type& type, const char* p)
+    {
+        switch ( type ) {
+        case Float32: { float v; std::memcpy( &v, p, sizeof( v ) ); return v; }
+        case Float64: { double v; std::memcpy( &v, p, sizeof( v ) ); return v; }
+        case Int16Normalized: { qint16 v; std::memcpy( &v, p, sizeof( v ) ); return std::max( v / 32767.0, -1.0 ); }
+        case UInt8: return static_cast<quint8>( *p );
+        case Half: { quint16 v; std::memcpy( &v, p, sizeof( v ) ); return halfToFloat( v ); }
+        }
+        return 0;
+    }
+
+    static void writeComponent(const Type& type, char* p, const double& value)
+    {
+        switch ( type ) {
+        case Float32: { float v = float( value ); std::memcpy( p, &v, sizeof( v ) ); break; }
+        case Float64: { std::memcpy( p, &value, sizeof( value ) ); break; }
+        case Int16Normalized: {
+            qint16 v = qint16( std::round( Math::clamp<double>( value, -1, 1 ) * 32767 ) );
+            std::memcpy( p, &v, sizeof( v ) );
+            break;
+        }
+        case UInt8: { *p = char( quint8( Math::clamp<double>( std::round( value ), 0, 255 ) ) ); break; }
+        case Half: { quint16 v = floatToHalf( float( value ) ); std::memcpy( p, &v, sizeof( v ) ); break; }
+        }
+    }
+
+    static float halfToFloat(const quint16& h);
+
+    static quint16 floatToHalf(const float& f);
+
+    // private:
+    InterleavedBufferPtr data;
+    Type type;
+    int itemSize;
+    int offset;
 };
 
 } // namespace three
@@ -0,0 +1,121 @@
+#include "frustumculler.h"
+
+namespace three {
+
+namespace {
+
+const int AllPlanes = ( 1 << 6 ) - 1;
+
+} // namespace
+
+void FrustumCuller::updateBounds()
+{
+    SceneGraph& graph = *this->graph;
+    int count = graph.nodes.size();
+
+    this->worldSpheres.resize( count );
+    this->subtreeBoxes.resize( count );
+    this->cullable.resize( count );
+
+    for ( int s = 0; s < count; s ++ ) {
+        Sphere& sphere = this->worldSpheres[ s ];
+        Box3& box = this->subtreeBoxes[ s ];
+
+        sphere.copy( graph.boundingSpheres[ s ] );
+        if ( sphere.radius >= 0 ) {
+            sphere.applyMatrix4( graph.matrixWorlds[ s ] );
+            box.set( sphere.center, sphere.center ).expandByScalar( sphere.radius );
+        } else {
+            box.makeEmpty();
+        }
+
+        this->cullable[ s ] = ( graph.flags[ s ] & SceneGraph::FrustumCulled ) ? 1 : 0;
+    }
+
+    // children come after their parent, so walking backwards every subtree
+    // is complete before it is merged into its parent
+    for ( int s = count - 1; s > 0; s -- ) {
+        int p = graph.parentSlots[ s ];
+        if ( p >= 0 ) {
+            this->subtreeBoxes[ p ].union_( this->subtreeBoxes[ s ] );
+            this->cullable[ p ] &= this->cullable[ s ];
+        }
+    }
+}
+
+void FrustumCuller::cull(const Frustum &frustum, const Layers &layers, QVector<SceneGraph::NodeId> &visible)
+{
+    SceneGraph& graph = *this->graph;
+    graph.ensureOrder();
+    this->updateBounds();
+
+    int count = graph.nodes.size();
+    this->planeMasks.resize( count );
+    if ( this->lastPlanes.size() < graph.infos.size() ) {
+        this->lastPlanes.resize( graph.infos.size() );
+    }
+
+    int tested = 0;
+
+    for ( int s = 0; s < count; ) {
+        quint16 flags = graph.flags[ s ];
+        if ( !( flags & SceneGraph::Visible ) ) {
+            s = graph.subtreeEnds[ s ];
+            continue;
+        }
+
+        SceneGraph::NodeId node = graph.nodes[ s ];
+        int p = graph.parentSlots[ s ];
+        int parentMask = p >= 0 ? this->planeMasks[ p ] : AllPlanes;
+        int mask = parentMask;
+        int lastPlane = this->lastPlanes[ node ];
+
+        const Box3& box = this->subtreeBoxes[ s ];
+        bool inside;
+        if ( box.isEmpty() ) {
+            inside = false;
+        } else if ( mask == 0 ) {
+            inside = true;
+        } else {
+            inside = frustum.intersectsBox( box, mask, lastPlane );
+            tested ++;
+        }
+
+        if ( !inside && this->cullable[ s ] ) {
+            this->lastPlanes[ node ] = qint8( lastPlane );
+            s = graph.subtreeEnds[ s ];
+            continue;
+        }
+
+        // an outside subtree that holds nodes with frustumCulled off is
+        // still walked, its nodes are tested on their own
+        this->planeMasks[ s ] = quint8( inside ? mask : parentMask );
+
+        if ( graph.info( node ).layers.test( layers ) ) {
+            const Sphere& sphere = this->worldSpheres[ s ];
+
+            if ( !( flags & SceneGraph::FrustumCulled ) ) {
+                visible.append( node );
+            } else if ( inside && sphere.radius >= 0 ) {
+                // a leaf's box is its own box, that test was enough
+                bool leaf = graph.subtreeEnds[ s ] == s + 1;
+                if ( leaf || mask == 0 ) {
+                    visible.append( node );
+                } else {
+                    int sphereMask = mask;
+                    tested ++;
+                    if ( frustum.intersectsSphere( sphere, sphereMask, lastPlane ) ) {
+                        visible.append( node );
+                    }
+                }
+            }
+        }
+
+        this->lastPlanes[ node ] = qint8( lastPlane );
+        s ++;
+    }
+
+    this->lastTestedCount = tested;
+}
+
+} // namespace three
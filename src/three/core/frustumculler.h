@@ -0,0 +1,64 @@
+#ifndef THREE_FRUSTUMCULLER_H
+#define THREE_FRUSTUMCULLER_H
+
+#include <QVector>
+
+#include "../math/math_forword_declar.h"
+#include "../math/box3.h"
+#include "../math/sphere.h"
+#include "../math/frustum.h"
+#include "layers.h"
+#include "scenegraph.h"
+
+namespace three {
+
+// Hierarchical view frustum culling over a SceneGraph.
+//
+// Every node gets a world space box around its own boundingSphere and those
+// of its descendants. The tree is walked top down with a mask of the planes
+// still worth testing: a plane the parent's box lies entirely in front of
+// can not reject anything below it, so it is dropped for the subtree, and a
+// subtree with an empty mask is accepted without further tests. A rejected
+// subtree is skipped as a whole. Each node remembers the plane that last
+// rejected it and tests that one first, from one frame to the next that
+// is usually the plane that rejects it again.
+//
+// Following WebGLRenderer::projectObject, invisible nodes hide their
+// subtree and layers only decide about the node itself. Nodes with
+// frustumCulled off are always reported, nodes without a bounding sphere
+// never ( they have nothing to draw ), unless frustumCulled is off.
+class FrustumCuller
+{
+public:
+    explicit FrustumCuller( SceneGraph* graph ):
+        graph(graph),
+        lastTestedCount(0)
+    { }
+
+    // Appends the nodes that are ( possibly ) in the frustum to visible, in
+    // depth-first order. matrixWorld must be current.
+    void cull( const Frustum& frustum, const Layers& layers, QVector<SceneGraph::NodeId>& visible );
+
+    // private:
+
+    SceneGraph*             graph;
+
+    // by slot, rebuilt by every cull()
+    QVector<Sphere>         worldSpheres;
+    QVector<Box3>           subtreeBoxes;
+    QVector<quint8>         cullable;       // whole subtree may be culled
+    QVector<quint8>         planeMasks;     // planes the subtree still needs
+
+    // by NodeId, kept between frames
+    QVector<qint8>          lastPlanes;
+
+    // volumes tested by the last cull()
+    int                     lastTestedCount;
+
+private:
+    void updateBounds();
+};
+
+} // namespace three
+
+#endif // THREE_FRUSTUMCULLER_H
@@ -0,0 +1,119 @@
+#ifndef THREE_INTERLEAVEDBUFFER_H
+#define THREE_INTERLEAVEDBUFFER_H
+
+#include <QByteArray>
+#include <QSharedPointer>
+#include <QtGlobal>
+
+#include <algorithm>
+
+namespace three {
+
+// A block of `count` vertices, `stride` bytes apart. Several BufferAttribute
+// views can share one buffer ( position / normal / uv interleaved ).
+class InterleavedBuffer
+{
+public:
+    // vertices changed since the last upload, count == -1: nothing changed
+    struct UpdateRange
+    {
+        int offset;
+        int count;
+    };
+
+    // owns zero-initialised storage
+    InterleavedBuffer(const int& count, const int& stride):
+        storage(count * stride, 0),
+        bytes(storage.data()),
+        count(count),
+        stride(stride),
+        dynamic(false),
+        version(0)
+    {
+        this->clearUpdateRange();
+    }
+
+    // wraps externally owned memory without copying, the memory must
+    // outlive the buffer and every attribute viewing it
+    InterleavedBuffer(void* data, const int& count, const int& stride):
+        bytes(static_cast<char*>(data)),
+        count(count),
+        stride(stride),
+        dynamic(false),
+        version(0)
+    {
+        this->clearUpdateRange();
+    }
+
+    bool ownsData() const
+    {
+        return !this->storage.isEmpty();
+    }
+
+    char* data()
+    {
+        return this->bytes;
+    }
+
+    const char* data() const
+    {
+        return this->bytes;
+    }
+
+    int byteLength() const
+    {
+        return this->count * this->stride;
+    }
+
+    // grows updateRange to cover [ offset, offset + count )
+    void markDirty(const int& offset, const int& count)
+    {
+        Q_ASSERT( offset >= 0 && offset + count <= this->count );
+
+        if ( this->updateRange.count < 0 ) {
+            this->updateRange.offset = offset;
+            this->updateRange.count = count;
+        } else {
+            int end = std::max( this->updateRange.offset + this->updateRange.count, offset + count );
+            this->updateRange.offset = std::min( this->updateRange.offset, offset );
+            this->updateRange.count = end - this->updateRange.offset;
+        }
+        this->version ++;
+    }
+
+    void setNeedsUpdate()
+    {
+        this->markDirty( 0, this->count );
+    }
+
+    bool needsUpdate() const
+    {
+        return this->updateRange.count >= 0;
+    }
+
+    // called by the uploader once the range is on the GPU
+    void clearUpdateRange()
+    {
+        this->updateRange.offset = 0;
+        this->updateRange.count = -1;
+    }
+
+private:
+    Q_DISABLE_COPY(InterleavedBuffer)
+
+    QByteArray storage;
+    char* bytes;
+
+public:
+    int count;
+    int stride;
+    bool dynamic;
+    UpdateRange updateRange;
+    int version;
+};
+
+typedef QSharedPointer<InterleavedBuffer> InterleavedBufferPtr;
+
+} // namespace three
+
+#endif // THREE_INTERLEAVEDBUFFER_H
@@ -2,9 +2,212 @@
 
 namespace three {
 
-Vector3                   Object3D::DefaultUp;
+Vector3                   Object3D::DefaultUp( 0, 1, 0 );
 bool                      Object3D::DefaultMatrixAutoUpdate = true; // true
 qint64                    Object3D::Object3DIdCount = 0;       // 0
 
-} // namespace three
+Object3D::Object3D(SceneGraph *graph):
+    graph(graph),
+    node(graph->create())
+{
+    SceneGraph::NodeInfo& info = this->info();
+
+    this->graph->setId( this->node, Object3D::Object3DIdCount++ );
+    this->graph->setUuid( this->node, Uuid::create() );
+    info.type = QStringLiteral( "Object3D" );
+    info.up = Object3D::DefaultUp.clone();
+
+    this->setMatrixAutoUpdate( Object3D::DefaultMatrixAutoUpdate );
+}
+
+Object3D &Object3D::add(const Object3D &object)
+{
+    Q_ASSERT( object.graph == this->graph );
+
+    if ( object == *this ) {
+        qWarning() << "THREE.Object3D.add: object can't be added as a child of itself.";
+        return *this;
+    }
+
+    this->graph->add( this->node, object.node );
+    return *this;
+}
+
+Object3D &Object3D::remove(const Object3D &object)
+{
+    Q_ASSERT( object.graph == this->graph );
+
+    this->graph->remove( this->node, object.node );
+    return *this;
+}
+
+QVector<Object3D> Object3D::children() const
+{
+    const QVector<SceneGraph::NodeId>& nodes = this->graph->children( this->node );
+
+    QVector<Object3D> children;
+    children.reserve( nodes.size() );
+    for ( int i = 0; i < nodes.size(); i ++ ) {
+        children.append( Object3D( this->graph, nodes[ i ] ) );
+    }
+    return children;
+}
+
+Object3D Object3D::getObjectById(const qint64 &id) const
+{
+    SceneGraph::NodeId n = this->graph->findById( id, this->node );
+    return n != SceneGraph::NoNode ? Object3D( this->graph, n ) : Object3D();
+}
+
+Object3D Object3D::getObjectByName(const QString &name) const
+{
+    SceneGraph::NodeId n = this->graph->findByName( name, this->node );
+    return n != SceneGraph::NoNode ? Object3D( this->graph, n ) : Object3D();
+}
+
+Object3D Object3D::getObjectByUuid(const Uuid &uuid) const
+{
+    SceneGraph::NodeId n = this->graph->findByUuid( uuid, this->node );
+    return n != SceneGraph::NoNode ? Object3D( this->graph, n ) : Object3D();
+}
+
+Vector3 Object3D::getWorldPosition()
+{
+    Vector3 result;
+
+    this->updateMatrixWorld( true );
+
+    return result.setFromMatrixPosition( this->matrixWorld() );
+}
+
+Quaternion Object3D::getWorldQuaternion()
+{
+    Vector3 position;
+    Vector3 scale;
+    Quaternion result;
+
+    this->updateMatrixWorld( true );
+
+    this->matrixWorld().decompose( position, result, scale );
+
+    return result;
+}
+
+Euler Object3D::getWorldRotation()
+{
+    Quaternion quaternion = this->getWorldQuaternion();
+    Euler result;
+
+    const Object3D& self = *this;
+    return result.setFromQuaternion( quaternion, self.rotation().order );
+}
+
+Vector3 Object3D::getWorldScale()
+{
+    Vector3 position;
+    Quaternion quaternion;
+    Vector3 result;
 
+    this->updateMatrixWorld( true );
+
+    this->matrixWorld().decompose( position, quaternion, result );
+
+    return result;
+}
+
+Vector3 Object3D::getWorldDirection()
+{
+    Quaternion quaternion = this->getWorldQuaternion();
+    Vector3 result;
+
+    return result.set( 0, 0, 1 ).applyQuaternion( quaternion );
+}
+
+void Object3D::traverse(const Object3D::Callback &callback)
+{
+    this->graph->ensureOrder();
+
+    // the subtree is a contiguous run of slots
+    int first = this->slot();
+    for ( int s = first, end = this->graph->subtreeEnds[ first ]; s < end; s ++ ) {
+        Object3D object( this->graph, this->graph->nodes[ s ] );
+        callback( object );
+    }
+}
+
+void Object3D::traverseVisible(const Object3D::Callback &callback)
+{
+    this->graph->ensureOrder();
+
+    int first = this->slot();
+    int end = this->graph->subtreeEnds[ first ];
+    int s = first;
+    while ( s < end ) {
+        if ( ( this->graph->flags[ s ] & SceneGraph::Visible ) == 0 ) {
+            s = this->graph->subtreeEnds[ s ];
+            continue;
+        }
+        Object3D object( this->graph, this->graph->nodes[ s ] );
+        callback( object );
+        s ++;
+    }
+}
+
+void Object3D::traverseAncestors(const Object3D::Callback &callback)
+{
+    SceneGraph::NodeId parent = this->graph->parent( this->node );
+
+    while ( parent != SceneGraph::NoNode ) {
+        Object3D object( this->graph, parent );
+        callback( object );
+        parent = this->graph->parent( parent );
+    }
+}
+
+Object3D Object3D::clone(const bool &recursive) const
+{
+    Object3D object( this->graph );
+    object.copy( *this, recursive );
+    return object;
+}
+
+Object3D &Object3D::copy(const Object3D &source, const bool &recursive)
+{
+    const SceneGraph::NodeInfo& from = source.info();
+    SceneGraph::NodeInfo& to = this->info();
+
+    this->setName( from.name );
+
+    to.up.copy( from.up );
+    to.rotation.copy( from.rotation );
+
+    this->position().copy( source.position() );
+    this->quaternion().copy( source.quaternion() );
+    this->scale().copy( source.scale() );
+
+    this->matrix().copy( source.matrix() );
+    this->matrixWorld().copy( source.matrixWorld() );
+    this->boundingSphere().copy( source.boundingSphere() );
+
+    // MatrixAutoUpdate, Visible, ... the copied matrixWorld is relative to
+    // the source's parent, so it is recomputed
+    this->graph->flags[ this->slot() ] = source.graph->flags[ source.slot() ];
+    this->graph->touch( this->node, SceneGraph::MatrixNeedsUpdate | SceneGraph::MatrixWorldNeedsUpdate );
+
+    to.layers = from.layers;
+    to.renderOrder = from.renderOrder;
+    to.userData = from.userData;
+
+    if ( recursive == true ) {
+        QVector<Object3D> children = source.children();
+        for ( int i = 0; i < children.size(); i ++ ) {
+            Object3D child( this->graph );
+            child.copy( children[ i ], true );
+            this->add( child );
+        }
+    }
+
+    return *this;
+}
+
+} // namespace three
@@ -10,6 +10,9 @@
 #include "../math/matrix3.h"
 #include "../math/matrix4.h"
 #include "layers.h"
+#include "scenegraph.h"
+
+#include <functional>
 
 namespace three {
 
@@ -20,125 +23,154 @@ class Matrix4;
 class Matrix3;
 class Layers;
 
+// A lightweight handle to a node of a SceneGraph, copying an Object3D
+// copies the handle, not the node ( see clone() ). The accessors return
+// references into the graph's arrays. They are invalidated when the graph
+// re-sorts itself ( after add / remove, on the next updateMatrixWorld ) and
+// whenever a node is created: SceneGraph::create(), a new Object3D, clone()
+// and a recursive copy() append to the arrays, which may move them. Don't
+// hold on to a reference across any of these.
+//
+// The non-const position() / quaternion() / scale() / rotation() mark the
+// local transform changed, updateMatrixWorld() only recomposes those nodes.
+// rotation and quaternion are kept in sync lazily, the one written last wins.
 class Object3D
 {
     // Q_GADGET
 public:
-    Object3D()
-    {
-        this->id = Object3D::Object3DIdCount++;
-        this->uuid = three::Math::generateUUID();
-        this->name = '';
-        this->type = 'Object3D';
-
-        this->parent = nullptr;
-        // this->children = [];
-        this->children.clear();
-
-        this->up = Object3D::DefaultUp.clone();
-
-        //        var position = new THREE.Vector3();
-        //        var rotation = new THREE.Euler();
-        //        var quaternion = new THREE.Quaternion();
-        //        var scale = new THREE.Vector3( 1, 1, 1 );
-
-        //        function onRotationChange() {
-
-        //            quaternion.setFromEuler( rotation, false );
-
-        //        }
+    typedef std::function<void(Object3D&)> Callback;
 
-        //        function onQuaternionChange() {
+    Object3D():
+        graph(nullptr),
+        node(SceneGraph::NoNode)
+    { }
 
-        //            rotation.setFromQuaternion( quaternion, undefined, false );
+    // creates a new node in graph
+    explicit Object3D(SceneGraph* graph);
 
-        //        }
+    Object3D(SceneGraph* graph, const SceneGraph::NodeId& node):
+        graph(graph),
+        node(node)
+    { }
 
-        //        rotation.onChange( onRotationChange );
-        //        quaternion.onChange( onQuaternionChange );
-
-        // TODO
-        //        Object.defineProperties( this, {
-        //                position: {
-        //                    enumerable: true,
-        //                    value: position
-        //                }
-        //                rotation: {
-        //                    enumerable: true,
-        //                    value: rotation
-        //                }
-        //                quaternion: {
-        //                    enumerable: true,
-        //                    value: quaternion
-        //                }
-        //                scale: {
-        //                    enumerable: true,
-        //                    value: scale
-        //                }
-        //                modelViewMatrix: {
-        //                    value: new THREE.Matrix4()
-        //                }
-        //                normalMatrix: {
-        //                    value: new THREE.Matrix3()
-        //                }
-        //            } );
-
-        this->rotationAutoUpdate = true;
-
-        //        this->matrix = new THREE.Matrix4();
-        //        this->matrixWorld = new THREE.Matrix4();
+    bool isNull() const
+    {
+        return this->graph == nullptr || !this->graph->contains( this->node );
+    }
 
-        this->matrixAutoUpdate = Object3D::DefaultMatrixAutoUpdate;
-        this->matrixWorldNeedsUpdate = false;
+    bool operator==(const Object3D& other) const
+    {
+        return this->graph == other.graph && this->node == other.node;
+    }
 
-        //        this->layers = new THREE.Layers();
-        this->visible = true;
+    bool operator!=(const Object3D& other) const
+    {
+        return !( *this == other );
+    }
 
-        this->castShadow = false;
-        this->receiveShadow = false;
+    qint64 id() const { return this->info().id; }
+    const Uuid& uuid() const { return this->info().uuid; }
+    const QString& name() const { return this->info().name; }
+    void setName( const QString& name ) { this->graph->setName( this->node, name ); }
+    QString& type() { return this->info().type; }
+    const QString& type() const { return this->info().type; }
 
-        this->frustumCulled = true;
-        this->renderOrder = 0;
+    Vector3& up() { return this->info().up; }
+    Euler& rotation()
+    {
+        this->graph->syncRotation( this->node );
+        this->graph->touch( this->node, SceneGraph::MatrixNeedsUpdate | SceneGraph::RotationChanged );
+        return this->info().rotation;
+    }
 
-        // this->userData = {};
+    const Euler& rotation() const
+    {
+        this->graph->syncRotation( this->node );
+        return this->info().rotation;
     }
 
-    void applyMatrix( matrix ) {
+    Matrix4& modelViewMatrix() { return this->info().modelViewMatrix; }
+    Matrix3& normalMatrix() { return this->info().normalMatrix; }
+    Layers& layers() { return this->info().layers; }
+    const Layers& layers() const { return this->info().layers; }
+    double& renderOrder() { return this->info().renderOrder; }
+    QVariant& userData() { return this->info().userData; }
 
-        this->matrix.multiplyMatrices( matrix, this->matrix );
+    Vector3& position() { return this->graph->positions[ this->graph->touch( this->node ) ]; }
+    const Vector3& position() const { return this->graph->positions[ this->slot() ]; }
+    Vector3& scale() { return this->graph->scales[ this->graph->touch( this->node ) ]; }
+    const Vector3& scale() const { return this->graph->scales[ this->slot() ]; }
 
-        this->matrix.decompose( this->position, this->quaternion, this->scale );
+    Quaternion& quaternion()
+    {
+        this->graph->syncQuaternion( this->node );
+        int s = this->graph->touch( this->node, SceneGraph::MatrixNeedsUpdate | SceneGraph::QuaternionChanged );
+        return this->graph->quaternions[ s ];
+    }
 
+    const Quaternion& quaternion() const
+    {
+        this->graph->syncQuaternion( this->node );
+        return this->graph->quaternions[ this->slot() ];
     }
 
-    void setRotationFromAxisAngle( axis, angle ) {
+    Matrix4& matrix() { return this->graph->matrices[ this->slot() ]; }
+    const Matrix4& matrix() const { return this->graph->matrices[ this->slot() ]; }
+    Matrix4& matrixWorld() { return this->graph->matrixWorlds[ this->slot() ]; }
+    const Matrix4& matrixWorld() const { return this->graph->matrixWorlds[ this->slot() ]; }
+
+    // local space bounds of what this object draws, used by FrustumCuller,
+    // a negative radius ( the default ) means there is nothing to draw
+    Sphere& boundingSphere() { return this->graph->boundingSpheres[ this->slot() ]; }
+    const Sphere& boundingSphere() const { return this->graph->boundingSpheres[ this->slot() ]; }
+
+    bool rotationAutoUpdate() const { return this->flag( SceneGraph::RotationAutoUpdate ); }
+    void setRotationAutoUpdate(const bool& on) { this->setFlag( SceneGraph::RotationAutoUpdate, on ); }
+    bool matrixAutoUpdate() const { return this->flag( SceneGraph::MatrixAutoUpdate ); }
+    void setMatrixAutoUpdate(const bool& on) { this->setFlag( SceneGraph::MatrixAutoUpdate, on ); }
+    bool matrixWorldNeedsUpdate() const { return this->flag( SceneGraph::MatrixWorldNeedsUpdate ); }
+    void setMatrixWorldNeedsUpdate(const bool& on) { this->setFlag( SceneGraph::MatrixWorldNeedsUpdate, on ); }
+    bool visible() const { return this->flag( SceneGraph::Visible ); }
+    void setVisible(const bool& on) { this->setFlag( SceneGraph::Visible, on ); }
+    bool castShadow() const { return this->flag( SceneGraph::CastShadow ); }
+    void setCastShadow(const bool& on) { this->setFlag( SceneGraph::CastShadow, on ); }
+    bool receiveShadow() const { return this->flag( SceneGraph::ReceiveShadow ); }
+    void setReceiveShadow(const bool& on) { this->setFlag( SceneGraph::ReceiveShadow, on ); }
+    bool frustumCulled() const { return this->flag( SceneGraph::FrustumCulled ); }
+    void setFrustumCulled(const bool& on) { this->setFlag( SceneGraph::FrustumCulled, on ); }
+
+    Object3D& applyMatrix( const Matrix4& matrix )
+    {
+        this->matrix().multiplyMatrices( matrix, this->matrix() );
+        this->matrix().decompose( this->position(), this->quaternion(), this->scale() );
+        return *this;
+    }
 
+    Object3D& setRotationFromAxisAngle( const Vector3& axis, const double& angle )
+    {
         // assumes axis is normalized
-
-        this->quaternion.setFromAxisAngle( axis, angle );
-
+        this->quaternion().setFromAxisAngle( axis, angle );
+        return *this;
     }
 
-    void setRotationFromEuler( euler ) {
-
-        this->quaternion.setFromEuler( euler, true );
-
+    Object3D& setRotationFromEuler( const Euler& euler )
+    {
+        this->quaternion().setFromEuler( euler, true );
+        return *this;
     }
 
-    void  setRotationFromMatrix( m ) {
-
+    Object3D& setRotationFromMatrix( const Matrix4& m )
+    {
         // assumes the upper 3x3 of m is a pure rotation matrix (i.e, unscaled)
-
-        this->quaternion.setFromRotationMatrix( m );
-
+        this->quaternion().setFromRotationMatrix( m );
+        return *this;
     }
 
-    void setRotationFromQuaternion( q ) {
-
+    Object3D& setRotationFromQuaternion( const Quaternion& q )
+    {
         // assumes q is normalized
-
-        this->quaternion.copy( q );
-
+        this->quaternion().copy( q );
+        return *this;
     }
 
     Object3D& rotateOnAxis(const Vector3& axis,const double& angle)
@@ -146,7 +178,7 @@ public:
         Quaternion q1 ;
         q1.setFromAxisAngle( axis, angle );
 
-        this->quaternion.multiply( q1 );
+        this->quaternion().multiply( q1 );
         return *this;
     }
 
@@ -172,10 +204,13 @@ public:
 
     Object3D& translateOnAxis(const Vector3&  axis, const double& distance )
     {
+        // the quaternion is only read, the const accessor keeps an edited
+        // rotation the one that wins
+        const Object3D& self = *this;
         Vector3 v1 ;
-        v1.copy( axis ).applyQuaternion( this->quaternion );
+        v1.copy( axis ).applyQuaternion( self.quaternion() );
 
-        this->position.add( v1.multiplyScalar( distance ) );
+        this->position().add( v1.multiplyScalar( distance ) );
 
         return *this;
     }
@@ -201,501 +236,120 @@ public:
 
     Vector3& localToWorld(Vector3& vector ) const
     {
-        return vector.applyMatrix4( this->matrixWorld );
+        return vector.applyMatrix4( this->matrixWorld() );
     }
 
-
-
     Vector3 & worldToLocal( Vector3& vector ) const
     {
         Matrix4 m1;
-        return vector.applyMatrix4( m1.getInverse( this->matrixWorld ) );
+        return vector.applyMatrix4( m1.getInverse( this->matrixWorld() ) );
     }
 
-
-    void lookAt() (const Vector3& vector )
+    Object3D& lookAt(const Vector3& vector )
     {
         // This routine does not support objects with rotated and/or translated parent(s)
+        const Object3D& self = *this;
         Matrix4 m1;
-        m1.lookAt( vector, this->position, this->up );
-
-        this->quaternion.setFromRotationMatrix( m1 );
-    }
-
-//   Object3D& add( object ) {
-
-//        if ( arguments.length > 1 ) {
-
-//            for ( var i = 0; i < arguments.length; i ++ ) {
-
-//                this->add( arguments[ i ] );
-
-//            }
-
-//            return *this;
-
-//        }
-
-//        if ( object == this ) {
-
-//            console.error( "THREE.Object3D.add: object can't be added as a child of itself.", object );
-//            return *this;
-
-//        }
-
-//        if ( object instanceof THREE.Object3D ) {
-
-//            if ( object.parent != null ) {
-
-//                object.parent.remove( object );
-
-//            }
-
-//            object.parent = this;
-//            object.dispatchEvent( { type: 'added' } );
-
-//            this->children.push( object );
-
-//        } else {
-
-//            console.error( "THREE.Object3D.add: object not an instance of THREE.Object3D.", object );
-
-//        }
-
-//        return *this;
-
-//    }
-
-
-//    remove( object ) {
-
-//        if ( arguments.length > 1 ) {
-
-//            for ( var i = 0; i < arguments.length; i ++ ) {
-
-//                this->remove( arguments[ i ] );
-
-//            }
-
-//        }
-
-//        var index = this->children.indexOf( object );
-
-//        if ( index != - 1 ) {
-
-//            object.parent = null;
-
-//            object.dispatchEvent( { type: 'removed' } );
-
-//            this->children.splice( index, 1 );
-
-//        }
-
-//    }
-
-    getObjectById( id ) {
-
-        return this->getObjectByProperty( 'id', id );
-
-    }
-
-    getObjectByName( name ) {
-
-        return this->getObjectByProperty( 'name', name );
-
-    }
-
-    getObjectByProperty( name, value ) {
-
-        if ( this[ name ] == value ) return *this;
-
-        for ( var i = 0, l = this->children.length; i < l; i ++ ) {
-
-            var child = this->children[ i ];
-            var object = child.getObjectByProperty( name, value );
-
-            if ( object != undefined ) {
-
-                return object;
-
-            }
-
-        }
-
-        return undefined;
+        m1.lookAt( vector, self.position(), this->up() );
 
+        this->quaternion().setFromRotationMatrix( m1 );
+        return *this;
     }
 
-    getWorldPosition( optionalTarget ) {
-
-        var result = optionalTarget || new THREE.Vector3();
-
-        this->updateMatrixWorld( true );
+    Object3D& add( const Object3D& object );
 
-        return result.setFromMatrixPosition( this->matrixWorld );
+    Object3D& remove( const Object3D& object );
 
+    Object3D parent() const
+    {
+        return Object3D( this->graph, this->graph->parent( this->node ) );
     }
 
-    getWorldQuaternion() {
-
-        var position = new THREE.Vector3();
-        var scale = new THREE.Vector3();
-
-        return function ( optionalTarget ) {
-
-            var result = optionalTarget || new THREE.Quaternion();
-
-            this->updateMatrixWorld( true );
-
-            this->matrixWorld.decompose( position, result, scale );
-
-            return result;
-
-        };
-
-    }(),
-
-    getWorldRotation() {
-
-        var quaternion = new THREE.Quaternion();
-
-        return function ( optionalTarget ) {
-
-            var result = optionalTarget || new THREE.Euler();
-
-            this->getWorldQuaternion( quaternion );
-
-            return result.setFromQuaternion( quaternion, this->rotation.order, false );
-
-        };
-
-    }(),
-
-    getWorldScale() {
+    QVector<Object3D> children() const;
 
-        var position = new THREE.Vector3();
-        var quaternion = new THREE.Quaternion();
+    // searches this object and its descendants, returns a null handle if
+    // nothing matches
+    Object3D getObjectById( const qint64& id ) const;
 
-        return function ( optionalTarget ) {
+    Object3D getObjectByName( const QString& name ) const;
 
-            var result = optionalTarget || new THREE.Vector3();
+    Object3D getObjectByUuid( const Uuid& uuid ) const;
 
-            this->updateMatrixWorld( true );
+    Vector3 getWorldPosition();
 
-            this->matrixWorld.decompose( position, quaternion, result );
+    Quaternion getWorldQuaternion();
 
-            return result;
+    Euler getWorldRotation();
 
-        };
+    Vector3 getWorldScale();
 
-    }(),
+    Vector3 getWorldDirection();
 
-    getWorldDirection() {
+    // TODO
+    //    raycast() {}
 
-        var quaternion = new THREE.Quaternion();
+    // pre-order, callback must not add or remove objects
+    void traverse( const Callback& callback );
 
-        return function ( optionalTarget ) {
+    void traverseVisible( const Callback& callback );
 
-            var result = optionalTarget || new THREE.Vector3();
-
-            this->getWorldQuaternion( quaternion );
-
-            return result.set( 0, 0, 1 ).applyQuaternion( quaternion );
-
-        };
-
-    }(),
-
-    raycast() {}
-
-    traverse( callback ) {
-
-        callback( this );
-
-        var children = this->children;
-
-        for ( var i = 0, l = children.length; i < l; i ++ ) {
-
-            children[ i ].traverse( callback );
-
-        }
+    void traverseAncestors( const Callback& callback );
 
+    void updateMatrix()
+    {
+        this->graph->updateMatrix( this->node );
     }
 
-    traverseVisible( callback ) {
-
-        if ( this->visible == false ) return;
-
-        callback( this );
-
-        var children = this->children;
-
-        for ( var i = 0, l = children.length; i < l; i ++ ) {
-
-            children[ i ].traverseVisible( callback );
-
-        }
-
+    // see SceneGraph::updateMatrixWorld() for the parallel mode
+    void updateMatrixWorld( const bool& force = false, const bool& parallel = false )
+    {
+        this->graph->updateMatrixWorld( this->node, force, parallel );
     }
 
-    traverseAncestors( callback ) {
+    // TODO
+    //    toJSON( meta ) {
+    //    }
 
-        var parent = this->parent;
+    // new node in the same graph, with copies of the descendants if recursive
+    Object3D clone( const bool& recursive = true ) const;
 
-        if ( parent != null ) {
+    Object3D& copy( const Object3D& source, const bool& recursive = true );
 
-            callback( parent );
-
-            parent.traverseAncestors( callback );
-
-        }
-
-    }
-
-    updateMatrix() {
-
-        this->matrix.compose( this->position, this->quaternion, this->scale );
+    // private:
+    SceneGraph*                     graph;
+    SceneGraph::NodeId              node;
 
-        this->matrixWorldNeedsUpdate = true;
+    static Vector3                  DefaultUp;
+    static bool                     DefaultMatrixAutoUpdate; // true
+    static qint64                   Object3DIdCount;       // 0
 
+private:
+    int slot() const
+    {
+        return this->graph->slotOf( this->node );
     }
 
-    updateMatrixWorld( force ) {
-
-        if ( this->matrixAutoUpdate == true ) this->updateMatrix();
-
-        if ( this->matrixWorldNeedsUpdate == true || force == true ) {
-
-            if ( this->parent == null ) {
-
-                this->matrixWorld.copy( this->matrix );
-
-            } else {
-
-                this->matrixWorld.multiplyMatrices( this->parent.matrixWorld, this->matrix );
-
-            }
-
-            this->matrixWorldNeedsUpdate = false;
-
-            force = true;
-
-        }
-
-        // update children
-
-        for ( var i = 0, l = this->children.length; i < l; i ++ ) {
-
-            this->children[ i ].updateMatrixWorld( force );
-
-        }
-
+    SceneGraph::NodeInfo& info()
+    {
+        return this->graph->info( this->node );
     }
 
-    toJSON( meta ) {
-
-        var isRootObject = ( meta == undefined );
-
-        var output = {};
-
-        // meta is a hash used to collect geometries, materials.
-        // not providing it implies that this is the root object
-        // being serialized.
-        if ( isRootObject ) {
-
-            // initialize meta obj
-            meta = {
-                geometries: {}
-                materials: {}
-                textures: {}
-                images: {}
-            };
-
-            output.metadata = {
-                version: 4.4,
-                type: 'Object',
-                generator: 'Object3D.toJSON'
-            };
-
-        }
-
-        // standard Object3D serialization
-
-        var object = {};
-
-        object.uuid = this->uuid;
-        object.type = this->type;
-
-        if ( this->name != '' ) object.name = this->name;
-        if ( JSON.stringify( this->userData ) != '{}' ) object.userData = this->userData;
-        if ( this->castShadow == true ) object.castShadow = true;
-        if ( this->receiveShadow == true ) object.receiveShadow = true;
-        if ( this->visible == false ) object.visible = false;
-
-        object.matrix = this->matrix.toArray();
-
-        //
-
-        if ( this->geometry != undefined ) {
-
-            if ( meta.geometries[ this->geometry.uuid ] == undefined ) {
-
-                meta.geometries[ this->geometry.uuid ] = this->geometry.toJSON( meta );
-
-            }
-
-            object.geometry = this->geometry.uuid;
-
-        }
-
-        if ( this->material != undefined ) {
-
-            if ( meta.materials[ this->material.uuid ] == undefined ) {
-
-                meta.materials[ this->material.uuid ] = this->material.toJSON( meta );
-
-            }
-
-            object.material = this->material.uuid;
-
-        }
-
-        //
-
-        if ( this->children.length > 0 ) {
-
-            object.children = [];
-
-            for ( var i = 0; i < this->children.length; i ++ ) {
-
-                object.children.push( this->children[ i ].toJSON( meta ).object );
-
-            }
-
-        }
-
-        if ( isRootObject ) {
-
-            var geometries = extractFromCache( meta.geometries );
-            var materials = extractFromCache( meta.materials );
-            var textures = extractFromCache( meta.textures );
-            var images = extractFromCache( meta.images );
-
-            if ( geometries.length > 0 ) output.geometries = geometries;
-            if ( materials.length > 0 ) output.materials = materials;
-            if ( textures.length > 0 ) output.textures = textures;
-            if ( images.length > 0 ) output.images = images;
-
-        }
-
-        output.object = object;
-
-        return output;
-
-        // extract data from the cache hash
-        // remove metadata on each item
-        // and return as array
-        function extractFromCache ( cache ) {
-
-            var values = [];
-            for ( var key in cache ) {
-
-                var data = cache[ key ];
-                delete data.metadata;
-                values.push( data );
-
-            }
-            return values;
-
-        }
-
+    const SceneGraph::NodeInfo& info() const
+    {
+        return this->graph->info( this->node );
     }
 
-    clone( recursive ) {
-
-        return new this->constructor().copy( this, recursive );
-
+    bool flag(const SceneGraph::Flag& flag) const
+    {
+        return this->graph->hasFlag( this->node, flag );
     }
 
-    copy( source, recursive ) {
-
-        if ( recursive == undefined ) recursive = true;
-
-        this->name = source.name;
-
-        this->up.copy( source.up );
-
-        this->position.copy( source.position );
-        this->quaternion.copy( source.quaternion );
-        this->scale.copy( source.scale );
-
-        this->rotationAutoUpdate = source.rotationAutoUpdate;
-
-        this->matrix.copy( source.matrix );
-        this->matrixWorld.copy( source.matrixWorld );
-
-        this->matrixAutoUpdate = source.matrixAutoUpdate;
-        this->matrixWorldNeedsUpdate = source.matrixWorldNeedsUpdate;
-
-        this->visible = source.visible;
-
-        this->castShadow = source.castShadow;
-        this->receiveShadow = source.receiveShadow;
-
-        this->frustumCulled = source.frustumCulled;
-        this->renderOrder = source.renderOrder;
-
-        this->userData = JSON.parse( JSON.stringify( source.userData ) );
-
-        if ( recursive == true ) {
-
-            for ( var i = 0; i < source.children.length; i ++ ) {
-
-                var child = source.children[ i ];
-                this->add( child.clone() );
-
-            }
-
-        }
-
-        return *this;
-
+    void setFlag(const SceneGraph::Flag& flag, const bool& on)
+    {
+        this->graph->setFlag( this->node, flag, on );
     }
-
-    // private:
-    qint64                          id;
-    QString                         uuid;
-    QString                         name;
-    QString                         type;
-    Object3D                           parent;     // TODO
-    QVector<Object3D>               children;     // TODO
-    Vector3                         up;
-    Vector3                         position;
-    Vector3                         rotation;
-    Quaternion                      quaternion;
-    double                          scale;
-    Matrix4                         modelViewMatrix;
-    Matrix3                         normalMatrix;
-    bool                            rotationAutoUpdate;
-    Matrix4                         matrix;
-    Matrix4                         matrixWorld;
-    bool                            matrixAutoUpdate;
-    bool                            matrixWorldNeedsUpdate;
-    Layers                          layers;
-    bool                            visible;
-    bool                            castShadow;
-    bool                            receiveShadow;
-    bool                            frustumCulled;
-    double                          renderOrder;     // TODO
-    QVariant                        userData;    // TODO
-
-    static Vector3                  DefaultUp;
-    static bool                     DefaultMatrixAutoUpdate; // true
-    static qint64                   Object3DIdCount;       // 0
 };
 
-
-
 } // namespace three
 
 #endif // THREE_OBJECT3D_H
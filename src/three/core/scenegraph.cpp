@@ -0,0 +1,428 @@
+#include "scenegraph.h"
+
+#include "../math/parallel.hpp"
+
+namespace three {
+
+namespace {
+
+// subtrees up to this size are updated as one task by the parallel pass
+const int NodesPerTask = 1 << 12;
+
+// data[ k ] = old data[ oldSlots[ order[ k ] ] ]
+template<typename T>
+void permute(QVector<T>& data, const QVector<SceneGraph::NodeId>& order, const QVector<int>& oldSlots)
+{
+    QVector<T> sorted;
+    sorted.reserve( order.size() );
+    for ( int k = 0; k < order.size(); k ++ ) {
+        sorted.append( data[ oldSlots[ order[ k ] ] ] );
+    }
+    data.swap( sorted );
+}
+
+} // namespace
+
+const SceneGraph::NodeId SceneGraph::NoNode;
+
+SceneGraph::NodeId SceneGraph::create()
+{
+    NodeId node;
+    if ( !this->freeNodes.isEmpty() ) {
+        node = this->freeNodes.takeLast();
+        this->infos[ node ] = NodeInfo();
+    } else {
+        node = this->infos.size();
+        this->infos.append( NodeInfo() );
+        this->slots.append( -1 );
+    }
+    this->infos[ node ].alive = true;
+    this->infos[ node ].serial = ++ this->createdCount;
+
+    // a new root goes last, which keeps the depth-first order valid
+    int slot = this->positions.size();
+    this->slots[ node ] = slot;
+
+    this->positions.append( Vector3() );
+    this->quaternions.append( Quaternion() );
+    this->scales.append( Vector3( 1, 1, 1 ) );
+    this->matrices.append( Matrix4() );
+    this->matrixWorlds.append( Matrix4() );
+    this->boundingSpheres.append( Sphere( Vector3(), -1 ) );
+    this->parentSlots.append( -1 );
+    this->subtreeEnds.append( slot + 1 );
+    this->flags.append( MatrixAutoUpdate | Visible | FrustumCulled | RotationAutoUpdate |
+                        MatrixNeedsUpdate | MatrixWorldNeedsUpdate );
+    this->nodes.append( node );
+
+    this->roots.append( node );
+    this->liveCount ++;
+    this->pendingChanges = true;
+
+    return node;
+}
+
+void SceneGraph::destroy(const NodeId& node)
+{
+    Q_ASSERT( this->contains( node ) );
+
+    NodeId parent = this->infos[ node ].parent;
+    if ( parent != NoNode ) {
+        this->remove( parent, node );
+    }
+    this->roots.removeAt( this->roots.indexOf( node ) );
+
+    QVector<NodeId> stack;
+    stack.append( node );
+    while ( !stack.isEmpty() ) {
+        NodeId n = stack.takeLast();
+        NodeInfo& info = this->infos[ n ];
+        stack += info.children;
+
+        if ( this->idIndex.value( info.id, NoNode ) == n ) {
+            this->idIndex.remove( info.id );
+        }
+        if ( this->uuidIndex.value( info.uuid, NoNode ) == n ) {
+            this->uuidIndex.remove( info.uuid );
+        }
+        this->nameIndex.remove( info.name, n );
+
+        info = NodeInfo();
+        this->slots[ n ] = -1;
+        this->freeNodes.append( n );
+        this->liveCount --;
+        this->destroyedCount ++;
+    }
+
+    this->orderDirty = true;
+}
+
+void SceneGraph::add(const NodeId& parent, const NodeId& child)
+{
+    Q_ASSERT( this->contains( parent ) && this->contains( child ) );
+    Q_ASSERT_X( !this->isAncestor( child, parent ), "add", "THREE.Object3D.add: object can't be added as a child of itself." );
+
+    NodeInfo& info = this->infos[ child ];
+    if ( info.parent != NoNode ) {
+        this->remove( info.parent, child );
+    }
+    this->roots.removeAt( this->roots.indexOf( child ) );
+
+    info.parent = parent;
+    this->infos[ parent ].children.append( child );
+
+    this->touch( child, MatrixWorldNeedsUpdate );
+    this->orderDirty = true;
+}
+
+void SceneGraph::remove(const NodeId& parent, const NodeId& child)
+{
+    QVector<NodeId>& children = this->infos[ parent ].children;
+    int index = children.indexOf( child );
+
+    if ( index != - 1 ) {
+        children.removeAt( index );
+        this->infos[ child ].parent = NoNode;
+        this->roots.append( child );
+
+        this->touch( child, MatrixWorldNeedsUpdate );
+        this->orderDirty = true;
+    }
+}
+
+bool SceneGraph::isAncestor(const NodeId& ancestor, NodeId node) const
+{
+    while ( node != NoNode ) {
+        if ( node == ancestor )
+            return true;
+        node = this->infos[ node ].parent;
+    }
+    return false;
+}
+
+void SceneGraph::setId(const NodeId& node, const qint64& id)
+{
+    NodeInfo& info = this->infos[ node ];
+    if ( this->idIndex.value( info.id, NoNode ) == node ) {
+        this->idIndex.remove( info.id );
+    }
+    info.id = id;
+    this->idIndex.insert( id, node );
+}
+
+void SceneGraph::setUuid(const NodeId& node, const Uuid& uuid)
+{
+    NodeInfo& info = this->infos[ node ];
+    if ( this->uuidIndex.value( info.uuid, NoNode ) == node ) {
+        this->uuidIndex.remove( info.uuid );
+    }
+    info.uuid = uuid;
+    this->uuidIndex.insert( uuid, node );
+}
+
+void SceneGraph::setName(const NodeId& node, const QString& name)
+{
+    NodeInfo& info = this->infos[ node ];
+    this->nameIndex.remove( info.name, node );
+    info.name = name;
+    this->nameIndex.insert( name, node );
+}
+
+SceneGraph::NodeId SceneGraph::findById(const qint64& id, const NodeId& root) const
+{
+    NodeId node = this->idIndex.value( id, NoNode );
+    if ( node == NoNode || root == NoNode || this->isAncestor( root, node ) )
+        return node;
+    return NoNode;
+}
+
+SceneGraph::NodeId SceneGraph::findByUuid(const Uuid& uuid, const NodeId& root) const
+{
+    NodeId node = this->uuidIndex.value( uuid, NoNode );
+    if ( node == NoNode || root == NoNode || this->isAncestor( root, node ) )
+        return node;
+    return NoNode;
+}
+
+SceneGraph::NodeId SceneGraph::findByName(const QString& name, const NodeId& root)
+{
+    this->ensureOrder();
+
+    // the subtree of root is the slot range [ first, end )
+    int first = 0, end = this->nodes.size();
+    if ( root != NoNode ) {
+        first = this->slots[ root ];
+        end = this->subtreeEnds[ first ];
+    }
+
+    int found = end;
+    QMultiHash<QString, NodeId>::const_iterator it = this->nameIndex.constFind( name );
+    for ( ; it != this->nameIndex.constEnd() && it.key() == name; ++ it ) {
+        int s = this->slots[ it.value() ];
+        if ( s >= first && s < found ) {
+            found = s;
+        }
+    }
+    return found < end ? this->nodes[ found ] : NoNode;
+}
+
+void SceneGraph::ensureOrder()
+{
+    if ( !this->orderDirty )
+        return;
+
+    // depth-first order of the live nodes, children in insertion order
+    QVector<NodeId> order;
+    order.reserve( this->liveCount );
+
+    QVector<NodeId> stack;
+    for ( int r = 0; r < this->roots.size(); r ++ ) {
+        stack.append( this->roots[ r ] );
+        while ( !stack.isEmpty() ) {
+            NodeId n = stack.takeLast();
+            order.append( n );
+            const QVector<NodeId>& children = this->infos[ n ].children;
+            for ( int c = children.size() - 1; c >= 0; c -- ) {
+                stack.append( children[ c ] );
+            }
+        }
+    }
+
+    permute( this->positions, order, this->slots );
+    permute( this->quaternions, order, this->slots );
+    permute( this->scales, order, this->slots );
+    permute( this->matrices, order, this->slots );
+    permute( this->matrixWorlds, order, this->slots );
+    permute( this->boundingSpheres, order, this->slots );
+    permute( this->flags, order, this->slots );
+
+    int count = order.size();
+    for ( int k = 0; k < count; k ++ ) {
+        this->slots[ order[ k ] ] = k;
+    }
+
+    this->nodes = order;
+    this->parentSlots.resize( count );
+    this->subtreeEnds.resize( count );
+
+    for ( int k = 0; k < count; k ++ ) {
+        NodeId parent = this->infos[ order[ k ] ].parent;
+        this->parentSlots[ k ] = parent == NoNode ? -1 : this->slots[ parent ];
+        this->subtreeEnds[ k ] = k + 1;
+    }
+
+    // children come after their parent, so one backwards sweep settles the ends
+    for ( int k = count - 1; k >= 0; k -- ) {
+        int p = this->parentSlots[ k ];
+        if ( p >= 0 ) {
+            this->subtreeEnds[ p ] = std::max( this->subtreeEnds[ p ], this->subtreeEnds[ k ] );
+        }
+    }
+
+    this->orderDirty = false;
+}
+
+void SceneGraph::syncRotation(const NodeId& node)
+{
+    int s = this->slots[ node ];
+    if ( this->flags[ s ] & QuaternionChanged ) {
+        Euler& rotation = this->infos[ node ].rotation;
+        rotation.setFromQuaternion( this->quaternions[ s ], rotation.order );
+        this->flags[ s ] &= ~QuaternionChanged;
+    }
+}
+
+void SceneGraph::syncQuaternion(const NodeId& node)
+{
+    int s = this->slots[ node ];
+    if ( this->flags[ s ] & RotationChanged ) {
+        this->quaternions[ s ].setFromEuler( this->infos[ node ].rotation, false );
+        this->flags[ s ] &= ~RotationChanged;
+    }
+}
+
+void SceneGraph::updateMatrix(const NodeId& node)
+{
+    this->syncQuaternion( node );
+
+    int s = this->slots[ node ];
+    this->matrices[ s ].compose( this->positions[ s ], this->quaternions[ s ], this->scales[ s ] );
+    this->flags[ s ] = ( this->flags[ s ] & ~MatrixNeedsUpdate ) | MatrixWorldNeedsUpdate;
+    this->pendingChanges = true;
+}
+
+void SceneGraph::updateMatrixWorld(const bool& force, const bool& parallel)
+{
+    this->lastComposedCount = 0;
+    this->lastUpdatedCount = 0;
+
+    if ( !this->pendingChanges && !force )
+        return;
+
+    this->ensureOrder();
+    this->updatePass( 0, this->nodes.size(), force, parallel );
+    this->pendingChanges = false;
+}
+
+void SceneGraph::updateMatrixWorld(const NodeId& node, const bool& force, const bool& parallel)
+{
+    this->lastComposedCount = 0;
+    this->lastUpdatedCount = 0;
+
+    if ( !this->pendingChanges && !force )
+        return;
+
+    this->ensureOrder();
+    int s = this->slots[ node ];
+    this->updatePass( s, this->subtreeEnds[ s ], force, parallel );
+}
+
+void SceneGraph::updatePass(const int& first, const int& end, const bool& force, const bool& parallel)
+{
+    this->worldUpdated.resize( this->nodes.size() );
+
+    PassCounts counts = { 0, 0 };
+
+    if ( !parallel || end - first < 2 * NodesPerTask ) {
+        this->updateRange( first, end, first, force, counts );
+        this->lastComposedCount = counts.composed;
+        this->lastUpdatedCount = counts.updated;
+        return;
+    }
+
+    // The tasks write to the arrays through operator[], detach them here
+    // so that no task has to.
+    this->positions.data();
+    this->quaternions.data();
+    this->scales.data();
+    this->matrices.data();
+    this->matrixWorlds.data();
+    this->parentSlots.data();
+    this->flags.data();
+    this->nodes.data();
+    this->infos.data();
+    this->worldUpdated.data();
+
+    // Nodes heading more than NodesPerTask nodes are updated here, in
+    // order, so a parent is always done before its children. Every other
+    // subtree hanging off them is contiguous and becomes a task.
+    QVector<Parallel::Range> tasks;
+    for ( int s = first; s < end; ) {
+        int subtreeEnd = this->subtreeEnds[ s ];
+        if ( subtreeEnd - s > NodesPerTask ) {
+            this->updateRange( s, s + 1, first, force, counts );
+            s ++;
+        } else {
+            tasks.append( Parallel::Range( s, subtreeEnd ) );
+            s = subtreeEnd;
+        }
+    }
+
+    // group small neighbouring subtrees ( e.g. the leaves of a wide node )
+    // into batches of about NodesPerTask nodes
+    QVector<Parallel::Range> batches;
+    for ( int t = 0; t < tasks.size(); ) {
+        int b = t, size = 0;
+        while ( t < tasks.size() && size < NodesPerTask ) {
+            size += tasks[ t ].second - tasks[ t ].first;
+            t ++;
+        }
+        batches.append( Parallel::Range( b, t ) );
+    }
+
+    QVector<PassCounts> batchCounts( batches.size() );
+    Parallel::forRange( batches.size(), 1, [&]( int begin, int end ) {
+        for ( int i = begin; i < end; i ++ ) {
+            PassCounts local = { 0, 0 };
+            for ( int t = batches[ i ].first; t < batches[ i ].second; t ++ ) {
+                this->updateRange( tasks[ t ].first, tasks[ t ].second, first, force, local );
+            }
+            batchCounts[ i ] = local;
+        }
+    } );
+
+    for ( int i = 0; i < batchCounts.size(); i ++ ) {
+        counts.composed += batchCounts[ i ].composed;
+        counts.updated += batchCounts[ i ].updated;
+    }
+
+    this->lastComposedCount = counts.composed;
+    this->lastUpdatedCount = counts.updated;
+}
+
+void SceneGraph::updateRange(const int& begin, const int& end, const int& first, const bool& force, PassCounts& counts)
+{
+    for ( int s = begin; s < end; s ++ ) {
+        quint16 f = this->flags[ s ];
+
+        if ( f & RotationChanged ) {
+            this->quaternions[ s ].setFromEuler( this->infos[ this->nodes[ s ] ].rotation, false );
+            f &= ~RotationChanged;
+        }
+
+        if ( ( f & MatrixAutoUpdate ) && ( f & MatrixNeedsUpdate ) ) {
+            this->matrices[ s ].compose( this->positions[ s ], this->quaternions[ s ], this->scales[ s ] );
+            f = ( f & ~MatrixNeedsUpdate ) | MatrixWorldNeedsUpdate;
+            counts.composed ++;
+        }
+
+        // a node is updated if it changed or its parent was updated in this pass
+        int p = this->parentSlots[ s ];
+        bool update = force || ( f & MatrixWorldNeedsUpdate ) || ( p >= first && this->worldUpdated[ p ] );
+
+        if ( update ) {
+            if ( p < 0 ) {
+                this->matrixWorlds[ s ] = this->matrices[ s ];
+            } else {
+                this->matrixWorlds[ s ].multiplyMatrices( this->matrixWorlds[ p ], this->matrices[ s ] );
+            }
+            f &= ~MatrixWorldNeedsUpdate;
+            counts.updated ++;
+        }
+
+        this->worldUpdated[ s ] = update;
+        this->flags[ s ] = f;
+    }
+}
+
+} // namespace three
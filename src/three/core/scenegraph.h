@@ -0,0 +1,251 @@
+#ifndef THREE_SCENEGRAPH_H
+#define THREE_SCENEGRAPH_H
+
+#include <QHash>
+#include <QString>
+#include <QVariant>
+#include <QVector>
+
+#include "../math/math_forword_declar.h"
+#include "../math/vector3.h"
+#include "../math/euler.h"
+#include "../math/quaternion.h"
+#include "../math/matrix3.h"
+#include "../math/matrix4.h"
+#include "../math/sphere.h"
+#include "../math/uuid.h"
+#include "layers.h"
+
+namespace three {
+
+// Storage behind Object3D. The transform data of every node lives in
+// parallel arrays indexed by "slot", slots are kept in depth-first order:
+// a parent always precedes its children and the subtree of slot s is
+// [ s, subtreeEnds[ s ] ). updateMatrixWorld() is then one linear pass.
+//
+// Nodes are addressed by a stable NodeId, slotOf() maps it to its current
+// slot. Hierarchy changes only mark the order dirty, the arrays are
+// re-sorted lazily by ensureOrder() before the next pass.
+class SceneGraph
+{
+public:
+    typedef int NodeId;
+    static const NodeId NoNode = -1;
+
+    enum Flag {
+        MatrixAutoUpdate        = 1 << 0,
+        MatrixWorldNeedsUpdate  = 1 << 1,
+        Visible                 = 1 << 2,
+        CastShadow              = 1 << 3,
+        ReceiveShadow           = 1 << 4,
+        FrustumCulled           = 1 << 5,
+        RotationAutoUpdate      = 1 << 6,
+
+        // change tracking, see touch()
+        MatrixNeedsUpdate       = 1 << 7,   // position / quaternion / scale changed
+        RotationChanged         = 1 << 8,   // quaternion is stale
+        QuaternionChanged       = 1 << 9    // rotation is stale
+    };
+
+    // per node data that is not touched by the transform passes
+    struct NodeInfo
+    {
+        NodeInfo():
+            id(0),
+            serial(0),
+            parent(NoNode),
+            renderOrder(0),
+            alive(false)
+        { }
+
+        qint64              id;
+        quint64             serial;     // from create(), tells a recycled NodeId from its previous node
+        Uuid                uuid;
+        QString             name;
+        QString             type;
+        NodeId              parent;
+        QVector<NodeId>     children;
+        Vector3             up;
+        Euler               rotation;
+        Matrix4             modelViewMatrix;
+        Matrix3             normalMatrix;
+        Layers              layers;
+        double              renderOrder;
+        QVariant            userData;
+        bool                alive;
+    };
+
+    SceneGraph():
+        liveCount(0),
+        createdCount(0),
+        destroyedCount(0),
+        orderDirty(false),
+        pendingChanges(false),
+        lastComposedCount(0),
+        lastUpdatedCount(0)
+    { }
+
+    NodeId create();
+
+    // destroys node and its whole subtree
+    void destroy(const NodeId& node);
+
+    bool contains(const NodeId& node) const
+    {
+        return node >= 0 && node < this->infos.size() && this->infos[ node ].alive;
+    }
+
+    int size() const
+    {
+        return this->liveCount;
+    }
+
+    NodeId parent(const NodeId& node) const
+    {
+        return this->infos[ node ].parent;
+    }
+
+    const QVector<NodeId>& children(const NodeId& node) const
+    {
+        return this->infos[ node ].children;
+    }
+
+    // appends child to parent's children, detaching it from its old parent
+    void add(const NodeId& parent, const NodeId& child);
+
+    // detaches child from parent, it becomes a root
+    void remove(const NodeId& parent, const NodeId& child);
+
+    bool isAncestor(const NodeId& ancestor, NodeId node) const;
+
+    // id, uuid and name are indexed, set them through these
+    void setId(const NodeId& node, const qint64& id);
+
+    void setUuid(const NodeId& node, const Uuid& uuid);
+
+    void setName(const NodeId& node, const QString& name);
+
+    // NoNode if there is no such node, or it is not in the subtree of root
+    NodeId findById(const qint64& id, const NodeId& root = NoNode) const;
+
+    NodeId findByUuid(const Uuid& uuid, const NodeId& root = NoNode) const;
+
+    // names are not unique, the first match in depth-first order wins
+    NodeId findByName(const QString& name, const NodeId& root = NoNode);
+
+    NodeInfo& info(const NodeId& node)
+    {
+        return this->infos[ node ];
+    }
+
+    const NodeInfo& info(const NodeId& node) const
+    {
+        return this->infos[ node ];
+    }
+
+    int slotOf(const NodeId& node) const
+    {
+        return this->slots[ node ];
+    }
+
+    // slot arrays are in depth-first order after this
+    void ensureOrder();
+
+    bool hasFlag(const NodeId& node, const Flag& flag) const
+    {
+        return ( this->flags[ this->slots[ node ] ] & flag ) != 0;
+    }
+
+    void setFlag(const NodeId& node, const Flag& flag, const bool& on)
+    {
+        quint16& f = this->flags[ this->slots[ node ] ];
+        f = on ? ( f | flag ) : ( f & ~flag );
+        this->pendingChanges = true;
+    }
+
+    // Records a change to node, returns its slot. Everything that writes
+    // position / quaternion / scale / rotation must go through here ( the
+    // Object3D accessors do ), the passes skip nodes that were not touched.
+    int touch(const NodeId& node, const int& changes = MatrixNeedsUpdate)
+    {
+        int s = this->slots[ node ];
+        this->flags[ s ] |= changes;
+        this->pendingChanges = true;
+        return s;
+    }
+
+    // bring rotation up to date with an edited quaternion, and vice versa
+    void syncRotation(const NodeId& node);
+
+    void syncQuaternion(const NodeId& node);
+
+    // composes matrix from position / quaternion / scale
+    void updateMatrix(const NodeId& node);
+
+    // One pass over every node. Only touched nodes are recomposed and only
+    // they and their descendants get a new matrixWorld, a pass over an
+    // unchanged graph returns immediately unless forced.
+    //
+    // With parallel set, nodes heading large subtrees are updated first on
+    // the calling thread, the subtrees below them then run as independent
+    // tasks on the global thread pool. Every node sees the same operations
+    // in the same order as in the serial pass, so the results are identical.
+    void updateMatrixWorld(const bool& force = false, const bool& parallel = false);
+
+    // one pass over the subtree of node, its parent's matrixWorld is
+    // assumed to be current
+    void updateMatrixWorld(const NodeId& node, const bool& force, const bool& parallel = false);
+
+    // private:
+
+    // slot arrays
+    QVector<Vector3>        positions;
+    QVector<Quaternion>     quaternions;
+    QVector<Vector3>        scales;
+    QVector<Matrix4>        matrices;
+    QVector<Matrix4>        matrixWorlds;
+    QVector<Sphere>         boundingSpheres;    // local space, radius < 0 = none
+    QVector<int>            parentSlots;
+    QVector<int>            subtreeEnds;
+    QVector<quint16>        flags;
+    QVector<NodeId>         nodes;
+
+    // NodeId arrays
+    QVector<int>            slots;
+    QVector<NodeInfo>       infos;
+    QVector<NodeId>         freeNodes;
+    QVector<NodeId>         roots;
+
+    QHash<qint64, NodeId>   idIndex;
+    QHash<Uuid, NodeId>     uuidIndex;
+    QMultiHash<QString, NodeId> nameIndex;
+
+    int                     liveCount;
+    quint64                 createdCount;
+    quint64                 destroyedCount;     // grows with every destroyed node, e.g. to revalidate NodeIds
+    bool                    orderDirty;
+    bool                    pendingChanges;
+
+    // work done by the last updateMatrixWorld()
+    int                     lastComposedCount;  // matrices recomposed
+    int                     lastUpdatedCount;   // matrixWorlds recomputed
+
+private:
+    struct PassCounts
+    {
+        int composed;
+        int updated;
+    };
+
+    void updatePass(const int& first, const int& end, const bool& force, const bool& parallel);
+
+    // updates [ begin, end ), parents below first are taken as current
+    void updateRange(const int& begin, const int& end, const int& first, const bool& force, PassCounts& counts);
+
+    // scratch for the passes: 1 if the slot's matrixWorld changed
+    QVector<quint8>         worldUpdated;
+};
+
+} // namespace three
+
+#endif // THREE_SCENEGRAPH_H
@@ -1,6 +1,7 @@
 #include "box3.h"
 
 #include "sphere.h"
+#include "../core/object3d.h"
 
 namespace three {
 
@@ -14,6 +15,29 @@ bool Box3::intersectsSphere(const Sphere &sphere) const
     return closestPoint.distanceToSquared( sphere.center ) <= ( sphere.radius * sphere.radius );
 }
 
+Box3 &Box3::setFromObject(Object3D &object)
+{
+    this->makeEmpty();
+
+    object.updateMatrixWorld( true );
+
+    // the subtree is one run of slots after updateMatrixWorld()
+    const SceneGraph& graph = *object.graph;
+    int first = graph.slotOf( object.node );
+
+    Sphere sphere;
+    Box3 box;
+    for ( int s = first; s < graph.subtreeEnds[ first ]; s ++ ) {
+        if ( graph.boundingSpheres[ s ].radius < 0 )
+            continue;
+
+        sphere.copy( graph.boundingSpheres[ s ] ).applyMatrix4( graph.matrixWorlds[ s ] );
+        this->union_( sphere.getBoundingBox( box ) );
+    }
+
+    return *this;
+}
+
 Sphere Box3::getBoundingSphere(Sphere &optionalTarget) const
 {
     Vector3 v1 ;
@@ -14,6 +14,7 @@ class Vector3;
 class Sphere;
 class Plane;
 class Matrix4;
+class Object3D;
 
 class Box3
 {
@@ -88,41 +89,10 @@ public:
         return *this;
     }
 
-    // TODO
-    //    Box3& setFromObject ( object ) {
-    //        // Computes the world-axis-aligned bounding box of an object (including its children),
-    //        // accounting for both the object's, and children's, world transforms
-
-    //        Box3 box;
-
-    //        auto scope = this;
-
-    //        this->makeEmpty();
-
-    //        object.updateMatrixWorld( true );
-
-    //        object.traverse( function ( node ) {
-
-    //                             auto geometry = node.geometry;
-
-    //                             if ( geometry !== undefined ) {
-
-    //                                 if ( geometry.boundingBox === null ) {
-
-    //                                     geometry.computeBoundingBox();
-
-    //                                 }
-
-    //                                 box.copy( geometry.boundingBox );
-    //                                 box.applyMatrix4( node.matrixWorld );
-    //                                 scope.union( box );
-
-    //                             }
-
-    //                         } );
-
-    //        return *this;
-    //    }
+    // Computes the world-axis-aligned bounding box of an object (including its children),
+    // accounting for both the object's, and children's, world transforms. Uses
+    // the boundingSphere of every node, objects without one add nothing.
+    Box3& setFromObject( Object3D& object );
 
     Box3 clone() const
     {
@@ -138,8 +108,8 @@ public:
 
     Box3& makeEmpty()
     {
-        this->min.x = this->min.y = this->min.z = 0;
-        this->max.x = this->max.y = this->max.z = 0;
+        this->min.x = this->min.y = this->min.z = std::numeric_limits<double>::infinity();
+        this->max.x = this->max.y = this->max.z = - std::numeric_limits<double>::infinity();
         return *this;
     }
 
@@ -0,0 +1,726 @@
+#include "bvh.h"
+
+#include <algorithm>
+
+#include <QElapsedTimer>
+#include <QMutex>
+
+#include "parallel.hpp"
+
+namespace three {
+
+namespace {
+
+const int BinCount = 16;
+const int MaxLeafSize = 8;      // larger leaves only where SAH finds no split
+const int MaxDepth = 64;        // also the size of the traversal stacks
+const double TraversalCost = 1; // relative to one primitive test
+
+// parallel builds: subtrees up to PrimitivesPerTask primitives are built by
+// one task, loops over more than PrimitivesPerChunk are split
+const int PrimitivesPerTask = 1 << 14;
+const int PrimitivesPerChunk = 1 << 15;
+
+double halfArea( const Box3& box )
+{
+    if ( box.isEmpty() )
+        return 0;
+
+    double dx = box.max.x - box.min.x, dy = box.max.y - box.min.y, dz = box.max.z - box.min.z;
+    return dx * dy + dy * dz + dz * dx;
+}
+
+// Slab test against the ray between minDistance and maxDistance, entry
+// gets the parameter the ray enters the box. NaN ( 0 * infinity for rays in
+// a slab plane ) is dropped by the min / max order, the slab counts as hit.
+inline bool intersectSlabs( const Box3& box, const Vector3& origin, const Vector3& inverseDirection,
+                            double minDistance, double maxDistance, double& entry )
+{
+    double t1 = ( box.min.x - origin.x ) * inverseDirection.x;
+    double t2 = ( box.max.x - origin.x ) * inverseDirection.x;
+    minDistance = std::max( minDistance, std::min( t1, t2 ) );
+    maxDistance = std::min( maxDistance, std::max( t1, t2 ) );
+
+    t1 = ( box.min.y - origin.y ) * inverseDirection.y;
+    t2 = ( box.max.y - origin.y ) * inverseDirection.y;
+    minDistance = std::max( minDistance, std::min( t1, t2 ) );
+    maxDistance = std::min( maxDistance, std::max( t1, t2 ) );
+
+    t1 = ( box.min.z - origin.z ) * inverseDirection.z;
+    t2 = ( box.max.z - origin.z ) * inverseDirection.z;
+    minDistance = std::max( minDistance, std::min( t1, t2 ) );
+    maxDistance = std::min( maxDistance, std::max( t1, t2 ) );
+
+    entry = minDistance;
+    return minDistance <= maxDistance;
+}
+
+struct Bin
+{
+    Box3 bounds;
+    int count;
+};
+
+// bins of the three axes
+struct Bins
+{
+    Bins()
+    {
+        for ( int a = 0; a < 3; a ++ ) {
+            for ( int b = 0; b < BinCount; b ++ ) {
+                this->bins[ a ][ b ].bounds.makeEmpty();
+                this->bins[ a ][ b ].count = 0;
+            }
+        }
+    }
+
+    void merge( const Bins& other )
+    {
+        for ( int a = 0; a < 3; a ++ ) {
+            for ( int b = 0; b < BinCount; b ++ ) {
+                this->bins[ a ][ b ].bounds.union_( other.bins[ a ][ b ].bounds );
+                this->bins[ a ][ b ].count += other.bins[ a ][ b ].count;
+            }
+        }
+    }
+
+    Bin bins[ 3 ][ BinCount ];
+};
+
+inline int binOf( const double& centroid, const double& low, const double& scale )
+{
+    return std::min( BinCount - 1, int( ( centroid - low ) * scale ) );
+}
+
+// a small subtree left to a task by the top of a parallel build
+struct Subtree
+{
+    int begin;
+    int end;
+    int depth;
+    QVector<BVH::Node> nodes;
+};
+
+// Recursive binned SAH split of order[ begin, end ). The top builder of a
+// parallel build splits its loops over the thread pool and stops at
+// subtrees of PrimitivesPerTask, marking them with count = -1 - subtree.
+// The split decisions do not depend on that, so the tree is the same.
+struct Builder
+{
+    const QVector<Box3>&    bounds;
+    const Vector3Array&     centroids;
+    QVector<int>&           order;
+    QVector<BVH::Node>&     nodes;
+    QVector<Subtree>*       subtrees;
+
+    template<typename Body>
+    void forChunks( const int& begin, const int& end, Body body )
+    {
+        if ( this->subtrees != nullptr && end - begin > PrimitivesPerChunk ) {
+            Parallel::forRange( end - begin, PrimitivesPerChunk, [&]( int first, int last ) {
+                body( begin + first, begin + last );
+            } );
+        } else {
+            body( begin, end );
+        }
+    }
+
+    void computeBounds( const int& begin, const int& end, Box3& box, Box3& centroidBox )
+    {
+        QMutex mutex;
+        box.makeEmpty();
+        centroidBox.makeEmpty();
+
+        this->forChunks( begin, end, [&]( int first, int last ) {
+            Box3 chunkBox, chunkCentroids;
+            chunkBox.makeEmpty();
+            chunkCentroids.makeEmpty();
+            for ( int i = first; i < last; i ++ ) {
+                chunkBox.union_( this->bounds[ this->order[ i ] ] );
+                chunkCentroids.expandByPoint( this->centroids[ this->order[ i ] ] );
+            }
+
+            QMutexLocker locker( &mutex );
+            box.union_( chunkBox );
+            centroidBox.union_( chunkCentroids );
+        } );
+    }
+
+    void computeBins( const int& begin, const int& end, const double low[ 3 ], const double scale[ 3 ], Bins& bins )
+    {
+        QMutex mutex;
+
+        this->forChunks( begin, end, [&]( int first, int last ) {
+            Bins chunk;
+            for ( int i = first; i < last; i ++ ) {
+                int p = this->order[ i ];
+                for ( int a = 0; a < 3; a ++ ) {
+                    if ( scale[ a ] > 0 ) {
+                        Bin& bin = chunk.bins[ a ][ binOf( this->centroids[ p ].getComponent( a ), low[ a ], scale[ a ] ) ];
+                        bin.bounds.union_( this->bounds[ p ] );
+                        bin.count ++;
+                    }
+                }
+            }
+
+            QMutexLocker locker( &mutex );
+            bins.merge( chunk );
+        } );
+    }
+
+    void build( const int& begin, const int& end, const int& depth )
+    {
+        int index = this->nodes.size();
+        this->nodes.append( BVH::Node() );
+
+        int count = end - begin;
+
+        if ( this->subtrees != nullptr && count <= PrimitivesPerTask ) {
+            Subtree subtree;
+            subtree.begin = begin;
+            subtree.end = end;
+            subtree.depth = depth;
+            this->nodes[ index ].count = -1 - this->subtrees->size();
+            this->subtrees->append( subtree );
+            return;
+        }
+
+        Box3 box, centroidBox;
+        this->computeBounds( begin, end, box, centroidBox );
+
+        BVH::Node& node = this->nodes[ index ];
+        node.bounds = box;
+        node.first = begin;
+        node.count = count;
+        node.axis = 0;
+        node.depth = depth;
+
+        if ( count <= 1 || depth >= MaxDepth - 1 )
+            return;
+
+        double area = halfArea( box );
+        double low[ 3 ], scale[ 3 ];
+        for ( int a = 0; a < 3; a ++ ) {
+            low[ a ] = centroidBox.min.getComponent( a );
+            double extent = centroidBox.max.getComponent( a ) - low[ a ];
+            scale[ a ] = ( extent > 0 && area > 0 ) ? BinCount / extent : 0;
+        }
+
+        Bins bins;
+        this->computeBins( begin, end, low, scale, bins );
+
+        int axis = -1, splitBin = 0;
+        double bestCost = std::numeric_limits<double>::infinity();
+
+        for ( int a = 0; a < 3; a ++ ) {
+            if ( !( scale[ a ] > 0 ) )
+                continue;
+
+            // sweep from the right, then from the left
+            double rightArea[ BinCount ];
+            int rightCount[ BinCount ];
+            Box3 right;
+            right.makeEmpty();
+            int n = 0;
+            for ( int b = BinCount - 1; b > 0; b -- ) {
+                right.union_( bins.bins[ a ][ b ].bounds );
+                n += bins.bins[ a ][ b ].count;
+                rightArea[ b ] = halfArea( right );
+                rightCount[ b ] = n;
+            }
+
+            Box3 left;
+            left.makeEmpty();
+            n = 0;
+            for ( int b = 1; b < BinCount; b ++ ) {
+                left.union_( bins.bins[ a ][ b - 1 ].bounds );
+                n += bins.bins[ a ][ b - 1 ].count;
+                if ( n == 0 || rightCount[ b ] == 0 )
+                    continue;
+
+                double cost = TraversalCost + ( halfArea( left ) * n + rightArea[ b ] * rightCount[ b ] ) / area;
+                if ( cost < bestCost ) {
+                    bestCost = cost;
+                    axis = a;
+                    splitBin = b;
+                }
+            }
+        }
+
+        // a leaf is cheaper, or there is nothing to split along
+        if ( count <= MaxLeafSize && bestCost >= count )
+            return;
+
+        int* first = this->order.data() + begin;
+        int* last = this->order.data() + end;
+        int* middle;
+
+        if ( axis >= 0 ) {
+            const Vector3Array& centroids = this->centroids;
+            double axisLow = low[ axis ], axisScale = scale[ axis ];
+            middle = std::partition( first, last, [&]( int p ) {
+                return binOf( centroids[ p ].getComponent( axis ), axisLow, axisScale ) < splitBin;
+            } );
+        } else {
+            // all centroids in one point: split in the middle, in any order
+            axis = 0;
+            middle = first + count / 2;
+        }
+
+        int mid = int( middle - this->order.data() );
+
+        this->nodes[ index ].count = 0;
+        this->nodes[ index ].axis = axis;
+
+        this->build( begin, mid, depth + 1 );
+        this->nodes[ index ].first = this->nodes.size();
+        this->build( mid, end, depth + 1 );
+    }
+};
+
+// copies the top tree depth first into nodes, with the subtrees in place
+// of their markers
+void splice( const QVector<BVH::Node>& top, const int& index, const QVector<Subtree>& subtrees, QVector<BVH::Node>& nodes )
+{
+    const BVH::Node& node = top[ index ];
+
+    if ( node.count < 0 ) {
+        const QVector<BVH::Node>& subtree = subtrees[ -1 - node.count ].nodes;
+        int base = nodes.size();
+        for ( int i = 0; i < subtree.size(); i ++ ) {
+            nodes.append( subtree[ i ] );
+            if ( subtree[ i ].count == 0 ) {
+                nodes.last().first += base;
+            }
+        }
+        return;
+    }
+
+    int at = nodes.size();
+    nodes.append( node );
+    if ( node.count > 0 )
+        return;
+
+    splice( top, index + 1, subtrees, nodes );
+    nodes[ at ].first = nodes.size();
+    splice( top, node.first, subtrees, nodes );
+}
+
+template<typename Body>
+void run( int count, bool parallel, Body body )
+{
+    if ( parallel ) {
+        Parallel::forRange( count, PrimitivesPerChunk, body );
+    } else {
+        body( 0, count );
+    }
+}
+
+struct StackEntry
+{
+    int node;
+    double entry;
+};
+
+} // namespace
+
+BVH &BVH::build(const Vector3Array &positions, const QVector<int> &indices, const bool &parallel)
+{
+    Q_ASSERT( indices.isEmpty() ? positions.size() % 3 == 0 : indices.size() % 3 == 0 );
+
+    QElapsedTimer timer;
+    timer.start();
+
+    this->type = Triangles;
+    this->indices = indices;
+    this->boxes.clear();
+
+    int count = indices.isEmpty() ? positions.size() / 3 : indices.size() / 3;
+
+    QVector<Box3> bounds( count );
+    Vector3Array centroids( count );
+    run( count, parallel, [&]( int begin, int end ) {
+        for ( int t = begin; t < end; t ++ ) {
+            const Vector3& a = positions[ indices.isEmpty() ? 3 * t : indices[ 3 * t ] ];
+            const Vector3& b = positions[ indices.isEmpty() ? 3 * t + 1 : indices[ 3 * t + 1 ] ];
+            const Vector3& c = positions[ indices.isEmpty() ? 3 * t + 2 : indices[ 3 * t + 2 ] ];
+
+            bounds[ t ].set( a, a ).expandByPoint( b ).expandByPoint( c );
+            centroids[ t ] = bounds[ t ].center();
+        }
+    } );
+
+    this->buildNodes( bounds, centroids, parallel );
+    this->gatherTriangles( positions, parallel );
+
+    this->computeStats( timer.nsecsElapsed() );
+    return *this;
+}
+
+BVH &BVH::build(const QVector<Box3> &boxes, const bool &parallel)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    this->type = Boxes;
+    this->indices.clear();
+    this->vertices.clear();
+
+    Vector3Array centroids( boxes.size() );
+    run( boxes.size(), parallel, [&]( int begin, int end ) {
+        for ( int i = begin; i < end; i ++ ) {
+            centroids[ i ] = boxes[ i ].center();
+        }
+    } );
+
+    this->buildNodes( boxes, centroids, parallel );
+
+    this->boxes.resize( boxes.size() );
+    for ( int k = 0; k < this->primitives.size(); k ++ ) {
+        this->boxes[ k ] = boxes[ this->primitives[ k ] ];
+    }
+
+    this->computeStats( timer.nsecsElapsed() );
+    return *this;
+}
+
+BVH &BVH::refit(const Vector3Array &positions)
+{
+    Q_ASSERT( this->type == Triangles );
+
+    this->gatherTriangles( positions, false );
+    this->refitNodes();
+    return *this;
+}
+
+BVH &BVH::refit(const QVector<Box3> &boxes)
+{
+    Q_ASSERT( this->type == Boxes && boxes.size() == this->primitives.size() );
+
+    for ( int k = 0; k < this->primitives.size(); k ++ ) {
+        this->boxes[ k ] = boxes[ this->primitives[ k ] ];
+    }
+    this->refitNodes();
+    return *this;
+}
+
+void BVH::buildNodes(const QVector<Box3> &bounds, const Vector3Array &centroids, const bool &parallel)
+{
+    this->nodes.clear();
+    this->primitives.resize( bounds.size() );
+    for ( int i = 0; i < bounds.size(); i ++ ) {
+        this->primitives[ i ] = i;
+    }
+
+    if ( bounds.isEmpty() )
+        return;
+
+    // at most 2n - 1 nodes
+    this->nodes.reserve( 2 * bounds.size() - 1 );
+
+    if ( !parallel ) {
+        Builder builder = { bounds, centroids, this->primitives, this->nodes, nullptr };
+        builder.build( 0, bounds.size(), 0 );
+        this->nodes.squeeze();
+        return;
+    }
+
+    QVector<BVH::Node> top;
+    QVector<Subtree> subtrees;
+    Builder topBuilder = { bounds, centroids, this->primitives, top, &subtrees };
+    topBuilder.build( 0, bounds.size(), 0 );
+
+    // the subtrees work on disjoint ranges of primitives
+    Subtree* data = subtrees.data();
+    Parallel::forRange( subtrees.size(), 1, [&]( int begin, int end ) {
+        for ( int i = begin; i < end; i ++ ) {
+            Builder builder = { bounds, centroids, this->primitives, data[ i ].nodes, nullptr };
+            builder.build( data[ i ].begin, data[ i ].end, data[ i ].depth );
+        }
+    } );
+
+    splice( top, 0, subtrees, this->nodes );
+    this->nodes.squeeze();
+}
+
+void BVH::gatherTriangles(const Vector3Array &positions, const bool &parallel)
+{
+    const QVector<int>& indices = this->indices;
+
+    this->vertices.resize( 3 * this->primitives.size() );
+    run( this->primitives.size(), parallel, [&]( int begin, int end ) {
+        for ( int k = begin; k < end; k ++ ) {
+            int t = this->primitives[ k ];
+            for ( int j = 0; j < 3; j ++ ) {
+                this->vertices[ 3 * k + j ] = positions[ indices.isEmpty() ? 3 * t + j : indices[ 3 * t + j ] ];
+            }
+        }
+    } );
+}
+
+void BVH::computeStats(const qint64 &buildTime)
+{
+    BuildStats& stats = this->buildStats;
+    stats = BuildStats();
+    stats.buildTime = buildTime / 1e6;
+    stats.nodeCount = this->nodes.size();
+
+    if ( this->nodes.isEmpty() )
+        return;
+
+    double rootArea = halfArea( this->nodes[ 0 ].bounds );
+    int primitives = 0;
+
+    for ( int i = 0; i < this->nodes.size(); i ++ ) {
+        const Node& node = this->nodes[ i ];
+        double weight = rootArea > 0 ? halfArea( node.bounds ) / rootArea : 1;
+
+        stats.maxDepth = std::max( stats.maxDepth, node.depth );
+        if ( node.count > 0 ) {
+            stats.leafCount ++;
+            stats.maxLeafSize = std::max( stats.maxLeafSize, node.count );
+            stats.sahCost += weight * node.count;
+            primitives += node.count;
+        } else {
+            stats.sahCost += weight * TraversalCost;
+        }
+    }
+
+    stats.averageLeafSize = double( primitives ) / stats.leafCount;
+}
+
+void BVH::refitNodes()
+{
+    // children are stored after their parent
+    for ( int i = this->nodes.size() - 1; i >= 0; i -- ) {
+        Node& node = this->nodes[ i ];
+
+        if ( node.count == 0 ) {
+            node.bounds.copy( this->nodes[ i + 1 ].bounds ).union_( this->nodes[ node.first ].bounds );
+            continue;
+        }
+
+        node.bounds.makeEmpty();
+        for ( int k = node.first; k < node.first + node.count; k ++ ) {
+            if ( this->type == Triangles ) {
+                node.bounds.expandByPoint( this->vertices[ 3 * k ] );
+                node.bounds.expandByPoint( this->vertices[ 3 * k + 1 ] );
+                node.bounds.expandByPoint( this->vertices[ 3 * k + 2 ] );
+            } else {
+                node.bounds.union_( this->boxes[ k ] );
+            }
+        }
+    }
+}
+
+bool BVH::intersectPrimitive(const int &index, const Vector3 &origin, const Vector3 &direction, const Vector3 &inverseDirection,
+                             const bool &backfaceCulling, const double &minDistance, const double &maxDistance, Hit &hit) const
+{
+    if ( this->type == Boxes ) {
+        double entry;
+        if ( !intersectSlabs( this->boxes[ index ], origin, inverseDirection, minDistance, maxDistance, entry ) )
+            return false;
+
+        hit.distance = entry;
+        hit.primitive = this->primitives[ index ];
+        hit.u = hit.v = 0;
+        return true;
+    }
+
+    // Moller-Trumbore, det > 0 for front faces ( counter clockwise )
+    const Vector3& a = this->vertices[ 3 * index ];
+    const Vector3& b = this->vertices[ 3 * index + 1 ];
+    const Vector3& c = this->vertices[ 3 * index + 2 ];
+
+    double e1x = b.x - a.x, e1y = b.y - a.y, e1z = b.z - a.z;
+    double e2x = c.x - a.x, e2y = c.y - a.y, e2z = c.z - a.z;
+
+    double px = direction.y * e2z - direction.z * e2y;
+    double py = direction.z * e2x - direction.x * e2z;
+    double pz = direction.x * e2y - direction.y * e2x;
+
+    double det = e1x * px + e1y * py + e1z * pz;
+    if ( backfaceCulling ? !( det > 0 ) : det == 0 )
+        return false;
+
+    double inverseDet = 1 / det;
+    double sx = origin.x - a.x, sy = origin.y - a.y, sz = origin.z - a.z;
+
+    double u = ( sx * px + sy * py + sz * pz ) * inverseDet;
+    if ( u < 0 || u > 1 )
+        return false;
+
+    double qx = sy * e1z - sz * e1y;
+    double qy = sz * e1x - sx * e1z;
+    double qz = sx * e1y - sy * e1x;
+
+    double v = ( direction.x * qx + direction.y * qy + direction.z * qz ) * inverseDet;
+    if ( v < 0 || u + v > 1 )
+        return false;
+
+    double t = ( e2x * qx + e2y * qy + e2z * qz ) * inverseDet;
+    if ( t < minDistance || t > maxDistance )
+        return false;
+
+    hit.distance = t;
+    hit.primitive = this->primitives[ index ];
+    hit.u = u;
+    hit.v = v;
+    return true;
+}
+
+bool BVH::intersect(const Ray &ray, Hit &hit, const bool &backfaceCulling, const double &minDistance, const double &maxDistance) const
+{
+    hit = Hit();
+
+    if ( this->nodes.isEmpty() )
+        return false;
+
+    const Vector3& origin = ray.origin;
+    const Vector3& direction = ray.direction;
+    Vector3 inverseDirection( 1 / direction.x, 1 / direction.y, 1 / direction.z );
+
+    double best = maxDistance;
+    double entry;
+    if ( !intersectSlabs( this->nodes[ 0 ].bounds, origin, inverseDirection, minDistance, best, entry ) )
+        return false;
+
+    StackEntry stack[ MaxDepth ];
+    int top = 0;
+    int index = 0;
+
+    for ( ;; ) {
+        const Node& node = this->nodes[ index ];
+
+        if ( node.count > 0 ) {
+            Hit candidate;
+            for ( int k = node.first; k < node.first + node.count; k ++ ) {
+                if ( this->intersectPrimitive( k, origin, direction, inverseDirection, backfaceCulling, minDistance, best, candidate ) ) {
+                    best = candidate.distance;
+                    hit = candidate;
+                }
+            }
+        } else {
+            // visit the nearer child first, the other one waits on the stack
+            int left = index + 1, right = node.first;
+            double leftEntry, rightEntry;
+            bool hitLeft = intersectSlabs( this->nodes[ left ].bounds, origin, inverseDirection, minDistance, best, leftEntry );
+            bool hitRight = intersectSlabs( this->nodes[ right ].bounds, origin, inverseDirection, minDistance, best, rightEntry );
+
+            if ( hitLeft && hitRight ) {
+                if ( rightEntry < leftEntry ) {
+                    std::swap( left, right );
+                    std::swap( leftEntry, rightEntry );
+                }
+                stack[ top ].node = right;
+                stack[ top ].entry = rightEntry;
+                top ++;
+                index = left;
+                continue;
+            }
+            if ( hitLeft || hitRight ) {
+                index = hitLeft ? left : right;
+                continue;
+            }
+        }
+
+        // next pending node that is still closer than the best hit
+        for ( ;; ) {
+            if ( top == 0 )
+                return hit.primitive >= 0;
+
+            top --;
+            if ( stack[ top ].entry <= best ) {
+                index = stack[ top ].node;
+                break;
+            }
+        }
+    }
+}
+
+int BVH::intersect(const RayPacket &packet, RayPacket::Hits &hits, const bool &backfaceCulling) const
+{
+    hits.reset( packet );
+
+    if ( this->nodes.isEmpty() )
+        return 0;
+
+    // children are visited near to far along the split axis, as seen by
+    // the first ray
+    const double* directions[ 3 ] = { packet.directionX, packet.directionY, packet.directionZ };
+
+    int stack[ MaxDepth ];
+    int top = 0;
+    stack[ top ++ ] = 0;
+
+    int mask = 0;
+    while ( top > 0 ) {
+        int index = stack[ -- top ];
+        const Node& node = this->nodes[ index ];
+
+        if ( packet.intersectBox( node.bounds, hits.distances ) == 0 )
+            continue;
+
+        if ( node.count == 0 ) {
+            bool leftFirst = directions[ node.axis ][ 0 ] >= 0;
+            stack[ top ++ ] = leftFirst ? node.first : index + 1;
+            stack[ top ++ ] = leftFirst ? index + 1 : node.first;
+            continue;
+        }
+
+        for ( int k = node.first; k < node.first + node.count; k ++ ) {
+            if ( this->type == Triangles ) {
+                mask |= packet.intersectTriangle( this->vertices[ 3 * k ], this->vertices[ 3 * k + 1 ], this->vertices[ 3 * k + 2 ],
+                                                  this->primitives[ k ], backfaceCulling, hits );
+            } else {
+                alignas( 32 ) double entries[ RayPacket::Size ];
+                int bits = packet.intersectBox( this->boxes[ k ], hits.distances, entries );
+                for ( int i = 0; i < RayPacket::Size; i ++ ) {
+                    if ( bits & ( 1 << i ) ) {
+                        hits.distances[ i ] = entries[ i ];
+                        hits.us[ i ] = hits.vs[ i ] = 0;
+                        hits.primitives[ i ] = this->primitives[ k ];
+                    }
+                }
+                mask |= bits;
+            }
+        }
+    }
+    return mask;
+}
+
+bool BVH::intersectsAny(const Ray &ray, const bool &backfaceCulling, const double &minDistance, const double &maxDistance) const
+{
+    if ( this->nodes.isEmpty() )
+        return false;
+
+    const Vector3& origin = ray.origin;
+    const Vector3& direction = ray.direction;
+    Vector3 inverseDirection( 1 / direction.x, 1 / direction.y, 1 / direction.z );
+
+    int stack[ MaxDepth ];
+    int top = 0;
+    stack[ top ++ ] = 0;
+
+    Hit hit;
+    while ( top > 0 ) {
+        const Node& node = this->nodes[ stack[ -- top ] ];
+
+        double entry;
+        if ( !intersectSlabs( node.bounds, origin, inverseDirection, minDistance, maxDistance, entry ) )
+            continue;
+
+        if ( node.count > 0 ) {
+            for ( int k = node.first; k < node.first + node.count; k ++ ) {
+                if ( this->intersectPrimitive( k, origin, direction, inverseDirection, backfaceCulling, minDistance, maxDistance, hit ) )
+                    return true;
+            }
+        } else {
+            stack[ top ++ ] = node.first;
+            stack[ top ++ ] = int( &node - this->nodes.constData() ) + 1;
+        }
+    }
+    return false;
+}
+
+} // namespace three
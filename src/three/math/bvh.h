@@ -0,0 +1,128 @@
+#ifndef THREE_BVH_H
+#define THREE_BVH_H
+
+#include <limits>
+
+#include "math_forword_declar.h"
+
+#include "vector3.h"
+#include "box3.h"
+#include "ray.h"
+#include "raypacket.h"
+
+namespace three {
+
+class Ray;
+class Box3;
+
+// Bounding volume hierarchy over triangles or boxes, for Ray queries.
+//
+// Built top down with binned SAH. The nodes are stored depth first in one
+// array, the left child of an inner node directly follows it so only the
+// right child's index is kept. The primitives are copied in leaf order, the
+// triangles of a leaf sit next to each other in memory.
+class BVH
+{
+public:
+    struct Node
+    {
+        Box3    bounds;
+        int     first;      // leaf: first primitive in leaf order, inner: right child
+        int     count;      // primitives in the leaf, 0 for inner nodes
+        int     axis;       // split axis of inner nodes
+        int     depth;
+    };
+
+    typedef Ray::Hit Hit;
+
+    enum PrimitiveType { Triangles, Boxes };
+
+    // filled by build()
+    struct BuildStats
+    {
+        BuildStats():
+            nodeCount( 0 ),
+            leafCount( 0 ),
+            maxDepth( 0 ),
+            maxLeafSize( 0 ),
+            averageLeafSize( 0 ),
+            sahCost( 0 ),
+            buildTime( 0 )
+        { }
+
+        int     nodeCount;
+        int     leafCount;
+        int     maxDepth;
+        int     maxLeafSize;
+        double  averageLeafSize;
+        double  sahCost;    // expected node + primitive tests of a ray hitting the root
+        double  buildTime;  // milliseconds
+    };
+
+    BVH():
+        type( Triangles )
+    { }
+
+    // Triangles from indices into positions, 3 per triangle, or from
+    // consecutive positions when indices is empty. A parallel build runs on
+    // the global thread pool and gives the same tree as a serial one.
+    BVH& build( const Vector3Array& positions, const QVector<int>& indices = QVector<int>(), const bool& parallel = false );
+
+    BVH& build( const QVector<Box3>& boxes, const bool& parallel = false );
+
+    // Takes the moved vertices ( same indices ) or boxes and recomputes the
+    // node bounds bottom up. The tree is kept, so after large motion a
+    // rebuild gives faster queries.
+    BVH& refit( const Vector3Array& positions );
+
+    BVH& refit( const QVector<Box3>& boxes );
+
+    bool isEmpty() const
+    {
+        return this->nodes.isEmpty();
+    }
+
+    int primitiveCount() const
+    {
+        return this->primitives.size();
+    }
+
+    // nearest primitive with minDistance <= hit.distance <= maxDistance
+    bool intersect( const Ray& ray, Hit& hit, const bool& backfaceCulling = false,
+                    const double& minDistance = 0, const double& maxDistance = std::numeric_limits<double>::infinity() ) const;
+
+    // Nearest hits for a packet of rays, returns the mask of rays that hit.
+    // A node is entered when any ray of the packet enters it, so this pays
+    // off for coherent rays ( camera / shadow rays from one origin ).
+    int intersect( const RayPacket& packet, RayPacket::Hits& hits, const bool& backfaceCulling = false ) const;
+
+    // stops at the first primitive found between minDistance and
+    // maxDistance, for occlusion / line of sight tests
+    bool intersectsAny( const Ray& ray, const bool& backfaceCulling = false,
+                        const double& minDistance = 0, const double& maxDistance = std::numeric_limits<double>::infinity() ) const;
+
+    // private:
+    PrimitiveType       type;
+    QVector<Node>       nodes;
+    QVector<int>        primitives;     // leaf order -> original index
+    QVector<int>        indices;        // as given to build(), for refit()
+    Vector3Array        vertices;       // 3 per triangle, leaf order
+    QVector<Box3>       boxes;          // leaf order
+    BuildStats          buildStats;
+
+private:
+    void buildNodes( const QVector<Box3>& bounds, const Vector3Array& centroids, const bool& parallel );
+
+    void gatherTriangles( const Vector3Array& positions, const bool& parallel );
+
+    void computeStats( const qint64& buildTime );
+
+    void refitNodes();
+
+    bool intersectPrimitive( const int& index, const Vector3& origin, const Vector3& direction, const Vector3& inverseDirection,
+                             const bool& backfaceCulling, const double& minDistance, const double& maxDistance, Hit& hit ) const;
+};
+
+} // namespace three
+
+#endif // THREE_BVH_H
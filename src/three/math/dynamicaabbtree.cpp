@@ -0,0 +1,406 @@
+#include "dynamicaabbtree.h"
+
+#include <algorithm>
+
+namespace three {
+
+namespace {
+
+// the rotations keep the height near log2( leaves ), far below this
+const int StackSize = 256;
+
+const int AllPlanes = ( 1 << 6 ) - 1;
+
+double halfArea( const Box3& box )
+{
+    double dx = box.max.x - box.min.x, dy = box.max.y - box.min.y, dz = box.max.z - box.min.z;
+    return dx * dy + dy * dz + dz * dx;
+}
+
+double unionArea( const Box3& a, const Box3& b )
+{
+    double dx = std::max( a.max.x, b.max.x ) - std::min( a.min.x, b.min.x );
+    double dy = std::max( a.max.y, b.max.y ) - std::min( a.min.y, b.min.y );
+    double dz = std::max( a.max.z, b.max.z ) - std::min( a.min.z, b.min.z );
+    return dx * dy + dy * dz + dz * dx;
+}
+
+// Whether the ray enters box before maxDistance. NaN ( 0 * infinity for
+// rays in a slab plane ) is dropped by the min / max order, the slab counts
+// as hit.
+inline bool entersBox( const Box3& box, const Vector3& origin, const Vector3& inverseDirection, const double& maxDistance )
+{
+    double entry = 0, exit = maxDistance;
+
+    double t1 = ( box.min.x - origin.x ) * inverseDirection.x, t2 = ( box.max.x - origin.x ) * inverseDirection.x;
+    entry = std::max( entry, std::min( t1, t2 ) );
+    exit = std::min( exit, std::max( t1, t2 ) );
+
+    t1 = ( box.min.y - origin.y ) * inverseDirection.y, t2 = ( box.max.y - origin.y ) * inverseDirection.y;
+    entry = std::max( entry, std::min( t1, t2 ) );
+    exit = std::min( exit, std::max( t1, t2 ) );
+
+    t1 = ( box.min.z - origin.z ) * inverseDirection.z, t2 = ( box.max.z - origin.z ) * inverseDirection.z;
+    entry = std::max( entry, std::min( t1, t2 ) );
+    exit = std::min( exit, std::max( t1, t2 ) );
+
+    return entry <= exit;
+}
+
+} // namespace
+
+const int DynamicAABBTree::NoNode;
+
+DynamicAABBTree::DynamicAABBTree(const double &margin):
+    root( NoNode ),
+    freeList( NoNode ),
+    leafCount( 0 ),
+    fatMargin( margin )
+{
+    Q_ASSERT( margin >= 0 );
+}
+
+DynamicAABBTree::ProxyId DynamicAABBTree::insert(const Box3 &box, const int &data)
+{
+    Q_ASSERT( !box.isEmpty() );
+
+    int leaf = this->allocateNode();
+    Node& node = this->nodes[ leaf ];
+    node.bounds.copy( box ).expandByScalar( this->fatMargin );
+    node.data = data;
+    this->boxes[ leaf ] = box;
+
+    this->insertLeaf( leaf );
+    this->leafCount ++;
+    return leaf;
+}
+
+void DynamicAABBTree::remove(const ProxyId &proxy)
+{
+    Q_ASSERT( proxy >= 0 && proxy < this->nodes.size() && this->nodes[ proxy ].height == 0 );
+
+    this->removeLeaf( proxy );
+    this->freeNode( proxy );
+    this->leafCount --;
+}
+
+bool DynamicAABBTree::move(const ProxyId &proxy, const Box3 &box, const Vector3 &displacement)
+{
+    Q_ASSERT( proxy >= 0 && proxy < this->nodes.size() && this->nodes[ proxy ].height == 0 );
+    Q_ASSERT( !box.isEmpty() );
+
+    this->boxes[ proxy ] = box;
+    if ( this->nodes[ proxy ].bounds.containsBox( box ) )
+        return false;
+
+    this->removeLeaf( proxy );
+
+    Box3& fat = this->nodes[ proxy ].bounds;
+    fat.copy( box ).expandByScalar( this->fatMargin );
+
+    // extend in the direction of motion
+    ( displacement.x < 0 ? fat.min.x : fat.max.x ) += displacement.x;
+    ( displacement.y < 0 ? fat.min.y : fat.max.y ) += displacement.y;
+    ( displacement.z < 0 ? fat.min.z : fat.max.z ) += displacement.z;
+
+    this->insertLeaf( proxy );
+    return true;
+}
+
+void DynamicAABBTree::clear()
+{
+    this->nodes.clear();
+    this->boxes.clear();
+    this->root = NoNode;
+    this->freeList = NoNode;
+    this->leafCount = 0;
+}
+
+void DynamicAABBTree::query(const Box3 &box, QVector<ProxyId> &result) const
+{
+    if ( this->root == NoNode )
+        return;
+
+    int stack[ StackSize ];
+    int top = 0;
+    stack[ top ++ ] = this->root;
+
+    while ( top > 0 ) {
+        int index = stack[ -- top ];
+        const Node& node = this->nodes[ index ];
+
+        if ( !node.bounds.intersectsBox( box ) )
+            continue;
+
+        if ( node.height == 0 ) {
+            if ( this->boxes[ index ].intersectsBox( box ) ) {
+                result.append( index );
+            }
+        } else {
+            Q_ASSERT( top + 2 <= StackSize );
+            stack[ top ++ ] = node.child1;
+            stack[ top ++ ] = node.child2;
+        }
+    }
+}
+
+void DynamicAABBTree::query(const Frustum &frustum, QVector<ProxyId> &result) const
+{
+    if ( this->root == NoNode )
+        return;
+
+    // the planes left to test below a node, none for subtrees fully inside
+    struct Entry { int index; int planes; };
+    Entry stack[ StackSize ];
+    int top = 0;
+    stack[ top ++ ] = { this->root, AllPlanes };
+
+    int firstPlane = 0;
+
+    while ( top > 0 ) {
+        Entry entry = stack[ -- top ];
+        const Node& node = this->nodes[ entry.index ];
+
+        if ( entry.planes != 0 && !frustum.intersectsBox( node.bounds, entry.planes, firstPlane ) )
+            continue;
+
+        if ( node.height == 0 ) {
+            int planes = entry.planes;
+            if ( planes == 0 || frustum.intersectsBox( this->boxes[ entry.index ], planes, firstPlane ) ) {
+                result.append( entry.index );
+            }
+        } else {
+            Q_ASSERT( top + 2 <= StackSize );
+            stack[ top ++ ] = { node.child1, entry.planes };
+            stack[ top ++ ] = { node.child2, entry.planes };
+        }
+    }
+}
+
+bool DynamicAABBTree::intersect(const Ray &ray, Ray::Hit &hit) const
+{
+    if ( this->root == NoNode )
+        return false;
+
+    Vector3 inverseDirection( 1 / ray.direction.x, 1 / ray.direction.y, 1 / ray.direction.z );
+
+    int stack[ StackSize ];
+    int top = 0;
+    stack[ top ++ ] = this->root;
+
+    bool found = false;
+
+    while ( top > 0 ) {
+        int index = stack[ -- top ];
+        const Node& node = this->nodes[ index ];
+
+        if ( !entersBox( node.bounds, ray.origin, inverseDirection, hit.distance ) )
+            continue;
+
+        if ( node.height == 0 ) {
+            if ( ray.intersectBox( this->boxes[ index ], hit ) ) {
+                hit.primitive = index;
+                found = true;
+            }
+        } else {
+            Q_ASSERT( top + 2 <= StackSize );
+            stack[ top ++ ] = node.child1;
+            stack[ top ++ ] = node.child2;
+        }
+    }
+    return found;
+}
+
+int DynamicAABBTree::allocateNode()
+{
+    int index;
+    if ( this->freeList == NoNode ) {
+        index = this->nodes.size();
+        this->nodes.append( Node() );
+        this->boxes.append( Box3() );
+    } else {
+        index = this->freeList;
+        this->freeList = this->nodes[ index ].parent;
+    }
+
+    Node& node = this->nodes[ index ];
+    node.parent = NoNode;
+    node.child1 = NoNode;
+    node.child2 = NoNode;
+    node.height = 0;
+    node.data = -1;
+    return index;
+}
+
+void DynamicAABBTree::freeNode(const int &node)
+{
+    this->nodes[ node ].parent = this->freeList;
+    this->nodes[ node ].height = -1;
+    this->freeList = node;
+}
+
+void DynamicAABBTree::insertLeaf(const int &leaf)
+{
+    if ( this->root == NoNode ) {
+        this->root = leaf;
+        this->nodes[ leaf ].parent = NoNode;
+        return;
+    }
+
+    // Find the best sibling: going down, the cost of pairing with a node is
+    // its grown area plus what its ancestors grew.
+    const Box3 leafBounds = this->nodes[ leaf ].bounds;
+    int index = this->root;
+
+    while ( this->nodes[ index ].height > 0 ) {
+        const Node& node = this->nodes[ index ];
+
+        double area = halfArea( node.bounds );
+        double combinedArea = unionArea( node.bounds, leafBounds );
+
+        // cost of a new parent for this node and the leaf
+        double cost = 2 * combinedArea;
+
+        // minimum cost of pushing the leaf further down the tree
+        double inheritanceCost = 2 * ( combinedArea - area );
+
+        double costs[ 2 ];
+        int children[ 2 ] = { node.child1, node.child2 };
+        for ( int i = 0; i < 2; i ++ ) {
+            const Node& child = this->nodes[ children[ i ] ];
+            double grown = unionArea( child.bounds, leafBounds );
+            costs[ i ] = ( child.height == 0 ? grown : grown - halfArea( child.bounds ) ) + inheritanceCost;
+        }
+
+        if ( cost < costs[ 0 ] && cost < costs[ 1 ] )
+            break;
+
+        index = costs[ 0 ] < costs[ 1 ] ? children[ 0 ] : children[ 1 ];
+    }
+
+    int sibling = index;
+
+    // a new parent for sibling and leaf
+    int oldParent = this->nodes[ sibling ].parent;
+    int newParent = this->allocateNode();
+
+    Node& parent = this->nodes[ newParent ];
+    parent.parent = oldParent;
+    parent.bounds.copy( leafBounds ).union_( this->nodes[ sibling ].bounds );
+    parent.height = this->nodes[ sibling ].height + 1;
+    parent.child1 = sibling;
+    parent.child2 = leaf;
+
+    if ( oldParent != NoNode ) {
+        Node& old = this->nodes[ oldParent ];
+        ( old.child1 == sibling ? old.child1 : old.child2 ) = newParent;
+    } else {
+        this->root = newParent;
+    }
+
+    this->nodes[ sibling ].parent = newParent;
+    this->nodes[ leaf ].parent = newParent;
+
+    this->fixUpwards( newParent );
+}
+
+void DynamicAABBTree::removeLeaf(const int &leaf)
+{
+    if ( leaf == this->root ) {
+        this->root = NoNode;
+        return;
+    }
+
+    int parent = this->nodes[ leaf ].parent;
+    int grandParent = this->nodes[ parent ].parent;
+    int sibling = this->nodes[ parent ].child1 == leaf ? this->nodes[ parent ].child2 : this->nodes[ parent ].child1;
+
+    // the sibling takes the parent's place
+    this->nodes[ sibling ].parent = grandParent;
+    this->freeNode( parent );
+
+    if ( grandParent != NoNode ) {
+        Node& node = this->nodes[ grandParent ];
+        ( node.child1 == parent ? node.child1 : node.child2 ) = sibling;
+        this->fixUpwards( grandParent );
+    } else {
+        this->root = sibling;
+    }
+}
+
+void DynamicAABBTree::fixUpwards(int index)
+{
+    while ( index != NoNode ) {
+        index = this->balance( index );
+
+        Node& node = this->nodes[ index ];
+        const Node& child1 = this->nodes[ node.child1 ];
+        const Node& child2 = this->nodes[ node.child2 ];
+
+        node.height = 1 + std::max( child1.height, child2.height );
+        node.bounds.copy( child1.bounds ).union_( child2.bounds );
+
+        index = node.parent;
+    }
+}
+
+int DynamicAABBTree::balance(const int &a)
+{
+    // Rotates the higher child of A up when the heights of A's children
+    // differ by more than one: for A( B, C( F, G ) ) with C too high and F
+    // higher than G, C( A( B, G ), F ). Returns the node now in A's place.
+    Node& A = this->nodes[ a ];
+    if ( A.height < 2 )
+        return a;
+
+    int b = A.child1;
+    int c = A.child2;
+    int difference = this->nodes[ c ].height - this->nodes[ b ].height;
+
+    if ( difference >= -1 && difference <= 1 )
+        return a;
+
+    // rotate the higher child up, mirrored for the left one
+    int up = difference > 1 ? c : b;
+    int other = difference > 1 ? b : c;
+    Node& U = this->nodes[ up ];
+
+    int f = U.child1;
+    int g = U.child2;
+    Node& F = this->nodes[ f ];
+    Node& G = this->nodes[ g ];
+
+    // U replaces A
+    U.child1 = a;
+    U.parent = A.parent;
+    A.parent = up;
+
+    if ( U.parent != NoNode ) {
+        Node& parent = this->nodes[ U.parent ];
+        ( parent.child1 == a ? parent.child1 : parent.child2 ) = up;
+    } else {
+        this->root = up;
+    }
+
+    // the higher grandchild stays with U, the lower one goes to A
+    int keep = F.height > G.height ? f : g;
+    int give = F.height > G.height ? g : f;
+
+    U.child2 = keep;
+    ( difference > 1 ? A.child2 : A.child1 ) = give;
+    this->nodes[ give ].parent = a;
+
+    const Node& O = this->nodes[ other ];
+    const Node& K = this->nodes[ keep ];
+    const Node& R = this->nodes[ give ];
+
+    A.bounds.copy( O.bounds ).union_( R.bounds );
+    A.height = 1 + std::max( O.height, R.height );
+
+    U.bounds.copy( A.bounds ).union_( K.bounds );
+    U.height = 1 + std::max( A.height, K.height );
+
+    return up;
+}
+
+} // namespace three
@@ -0,0 +1,124 @@
+#ifndef THREE_DYNAMICAABBTREE_H
+#define THREE_DYNAMICAABBTREE_H
+
+#include <QVector>
+
+#include "math_forword_declar.h"
+
+#include "box3.h"
+#include "frustum.h"
+#include "ray.h"
+
+namespace three {
+
+class Box3;
+class Frustum;
+class Ray;
+
+// Bounding box tree for volumes that move every frame, after Box2D's
+// b2DynamicTree. Leaves keep a fat box, the volume's box grown by margin
+// ( and by the displacement passed to move() ), so a small move only
+// replaces the tight box. A leaf is reinserted only when the volume leaves
+// its fat box, so an update costs in proportion to the volumes that moved.
+// Single rotations on the way up after an insertion / removal keep the
+// tree roughly balanced.
+//
+// The nodes are pooled in one array, removed nodes are reused. Proxy ids
+// are leaf node indices and stay valid until remove(). Queries test the fat
+// boxes on the way down and the tight boxes at the leaves.
+class DynamicAABBTree
+{
+public:
+    typedef int ProxyId;
+
+    static const int NoNode = -1;
+
+    struct Node
+    {
+        Box3    bounds;     // fat box for leaves
+        int     parent;     // next free node for unused nodes
+        int     child1;     // NoNode for leaves
+        int     child2;
+        int     height;     // 0 for leaves, -1 for unused nodes
+        int     data;       // leaves: as given to insert()
+    };
+
+    explicit DynamicAABBTree( const double& margin = 0.1 );
+
+    double margin() const
+    {
+        return this->fatMargin;
+    }
+
+    int count() const
+    {
+        return this->leafCount;
+    }
+
+    int height() const
+    {
+        return this->root == NoNode ? 0 : this->nodes[ this->root ].height;
+    }
+
+    // data is kept for the caller, e.g. a SceneGraph::NodeId
+    ProxyId insert( const Box3& box, const int& data = -1 );
+
+    void remove( const ProxyId& proxy );
+
+    // Returns whether the leaf had to be reinserted. The fat box is extended
+    // along displacement ( the expected move until the next update ) so a
+    // steadily moving volume stays in its leaf longer.
+    bool move( const ProxyId& proxy, const Box3& box, const Vector3& displacement = Vector3() );
+
+    void clear();
+
+    const Box3& bounds( const ProxyId& proxy ) const
+    {
+        return this->boxes[ proxy ];
+    }
+
+    const Box3& fatBounds( const ProxyId& proxy ) const
+    {
+        return this->nodes[ proxy ].bounds;
+    }
+
+    int data( const ProxyId& proxy ) const
+    {
+        return this->nodes[ proxy ].data;
+    }
+
+    // append the proxies whose box overlaps box / frustum to result
+    void query( const Box3& box, QVector<ProxyId>& result ) const;
+
+    void query( const Frustum& frustum, QVector<ProxyId>& result ) const;
+
+    // nearest proxy box along the ray ( see Ray::intersectBox ), hit.primitive
+    // gets the proxy id
+    bool intersect( const Ray& ray, Ray::Hit& hit ) const;
+
+    // private:
+    QVector<Node>   nodes;
+    QVector<Box3>   boxes;      // tight boxes, by leaf node
+    int             root;
+    int             freeList;
+    int             leafCount;
+    double          fatMargin;
+
+private:
+    int allocateNode();
+
+    void freeNode( const int& node );
+
+    void insertLeaf( const int& leaf );
+
+    void removeLeaf( const int& leaf );
+
+    // from index up to the root: rotations, heights and bounds
+    void fixUpwards( int index );
+
+    int balance( const int& a );
+};
+
+} // namespace three
+
+#endif // THREE_DYNAMICAABBTREE_H
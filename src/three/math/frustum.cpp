@@ -1,8 +1,223 @@
 #include "frustum.h"
 
+#include "simd.hpp"
+#include "parallel.hpp"
+
 namespace three {
 
+namespace {
 
+// volumes per task of the parallel batch tests, a multiple of 64 so no two
+// tasks write to the same mask word
+const int VolumesPerTask = 1 << 14;
 
-} // namespace three
+// The six planes as component arrays, the layout the kernels broadcast
+// from. positive* records the sign test intersectsBox does per plane.
+struct PlaneSet
+{
+    explicit PlaneSet( const PlaneArray& planes )
+    {
+        Q_ASSERT( planes.size() == 6 );
+
+        for ( int k = 0; k < 6; k ++ ) {
+            const Plane& plane = planes[ k ];
+            nx[ k ] = plane.normal.x;
+            ny[ k ] = plane.normal.y;
+            nz[ k ] = plane.normal.z;
+            constant[ k ] = plane.constant;
+            positiveX[ k ] = plane.normal.x > 0;
+            positiveY[ k ] = plane.normal.y > 0;
+            positiveZ[ k ] = plane.normal.z > 0;
+        }
+    }
+
+    double nx[ 6 ], ny[ 6 ], nz[ 6 ], constant[ 6 ];
+    bool positiveX[ 6 ], positiveY[ 6 ], positiveZ[ 6 ];
+};
+
+// Plane::distanceToPoint, same evaluation order
+template<typename T>
+inline T distance( const PlaneSet& planes, int k, T x, T y, T z )
+{
+    using namespace Simd;
+    return add( add( add( mul( set1( planes.nx[ k ] ), x ), mul( set1( planes.ny[ k ] ), y ) ),
+                     mul( set1( planes.nz[ k ] ), z ) ), set1( planes.constant[ k ] ) );
+}
+
+inline double distance( const PlaneSet& planes, int k, double x, double y, double z )
+{
+    return planes.nx[ k ] * x + planes.ny[ k ] * y + planes.nz[ k ] * z + planes.constant[ k ];
+}
+
+// Calls culled( i ) for every group of DoubleLanes volumes and scalarCulled( i )
+// for the tail, both return a bit per culled volume, and writes the mask
+// words covering volumes [ begin, end ). begin is a multiple of 64.
+template<typename Culled, typename ScalarCulled>
+void cullRange( int begin, int end, quint64* visible, Culled culled, ScalarCulled scalarCulled )
+{
+    for ( int word = begin; word < end; word += 64 ) {
+        int wordEnd = std::min( word + 64, end );
+        quint64 bits = 0;
+
+        int i = word;
+        for ( ; i + Simd::DoubleLanes <= wordEnd; i += Simd::DoubleLanes ) {
+            quint64 lanes = quint64( ~culled( i ) & ( ( 1 << Simd::DoubleLanes ) - 1 ) );
+            bits |= lanes << ( i - word );
+        }
+        for ( ; i < wordEnd; i ++ ) {
+            if ( !scalarCulled( i ) ) {
+                bits |= quint64( 1 ) << ( i - word );
+            }
+        }
+
+        visible[ word / 64 ] = bits;
+    }
+}
+
+template<typename Body>
+void run( int count, bool parallel, Body body )
+{
+    if ( parallel ) {
+        int words = ( count + 63 ) / 64;
+        Parallel::forRange( words, VolumesPerTask / 64, [&]( int begin, int end ) {
+            body( begin * 64, std::min( end * 64, count ) );
+        } );
+    } else {
+        body( 0, count );
+    }
+}
+
+} // namespace
+
+bool Frustum::intersectsSphere(const Sphere &sphere, int &planeMask, int &firstPlane) const
+{
+    const auto& planes = this->planes;
+    double negRadius = - sphere.radius;
+
+    for ( int i = 0; i < 6; i ++ ) {
+        int k = ( firstPlane + i ) % 6;
+        if ( !( planeMask & ( 1 << k ) ) )
+            continue;
+
+        double distance = planes[ k ].distanceToPoint( sphere.center );
+        if ( distance < negRadius ) {
+            firstPlane = k;
+            return false;
+        }
+        if ( distance >= sphere.radius ) {
+            planeMask &= ~( 1 << k );
+        }
+    }
+    return true;
+}
+
+bool Frustum::intersectsBox(const Box3 &box, int &planeMask, int &firstPlane) const
+{
+    const auto& planes = this->planes;
+    Vector3 p1, p2;
 
+    for ( int i = 0; i < 6; i ++ ) {
+        int k = ( firstPlane + i ) % 6;
+        if ( !( planeMask & ( 1 << k ) ) )
+            continue;
+
+        const Plane& plane = planes[ k ];
+        p1.x = plane.normal.x > 0 ? box.min.x : box.max.x;
+        p2.x = plane.normal.x > 0 ? box.max.x : box.min.x;
+        p1.y = plane.normal.y > 0 ? box.min.y : box.max.y;
+        p2.y = plane.normal.y > 0 ? box.max.y : box.min.y;
+        p1.z = plane.normal.z > 0 ? box.min.z : box.max.z;
+        p2.z = plane.normal.z > 0 ? box.max.z : box.min.z;
+
+        double d1 = plane.distanceToPoint( p1 );
+        double d2 = plane.distanceToPoint( p2 );
+        if ( d1 < 0 && d2 < 0 ) {
+            firstPlane = k;
+            return false;
+        }
+        // p1 is the corner furthest behind the plane
+        if ( d1 >= 0 ) {
+            planeMask &= ~( 1 << k );
+        }
+    }
+    return true;
+}
+
+void Frustum::intersectsSpheres(const double *xs, const double *ys, const double *zs, const double *radii,
+                                int count, quint64 *visible, bool parallel) const
+{
+    const PlaneSet planes( this->planes );
+
+    auto culled = [&]( int i ) {
+        using namespace Simd;
+        VDouble x = load( xs + i ), y = load( ys + i ), z = load( zs + i );
+        VDouble negRadius = sub( set1( 0.0 ), load( radii + i ) );
+
+        VDouble outside = cmplt( distance( planes, 0, x, y, z ), negRadius );
+        for ( int k = 1; k < 6; k ++ ) {
+            outside = or_( outside, cmplt( distance( planes, k, x, y, z ), negRadius ) );
+        }
+        return movemask( outside );
+    };
+
+    auto scalarCulled = [&]( int i ) {
+        double negRadius = - radii[ i ];
+        for ( int k = 0; k < 6; k ++ ) {
+            if ( distance( planes, k, xs[ i ], ys[ i ], zs[ i ] ) < negRadius )
+                return true;
+        }
+        return false;
+    };
+
+    run( count, parallel, [&]( int begin, int end ) {
+        cullRange( begin, end, visible, culled, scalarCulled );
+    } );
+}
+
+void Frustum::intersectsBoxes(const double *minXs, const double *minYs, const double *minZs,
+                              const double *maxXs, const double *maxYs, const double *maxZs,
+                              int count, quint64 *visible, bool parallel) const
+{
+    const PlaneSet planes( this->planes );
+
+    // per plane, p1 is the corner furthest along -normal, p2 along +normal,
+    // the box is out if both are behind the plane
+    auto culled = [&]( int i ) {
+        using namespace Simd;
+        VDouble minX = load( minXs + i ), minY = load( minYs + i ), minZ = load( minZs + i );
+        VDouble maxX = load( maxXs + i ), maxY = load( maxYs + i ), maxZ = load( maxZs + i );
+        VDouble zero = set1( 0.0 );
+
+        VDouble outside = cmplt( zero, zero );
+        for ( int k = 0; k < 6; k ++ ) {
+            VDouble d1 = distance( planes, k, planes.positiveX[ k ] ? minX : maxX,
+                                              planes.positiveY[ k ] ? minY : maxY,
+                                              planes.positiveZ[ k ] ? minZ : maxZ );
+            VDouble d2 = distance( planes, k, planes.positiveX[ k ] ? maxX : minX,
+                                              planes.positiveY[ k ] ? maxY : minY,
+                                              planes.positiveZ[ k ] ? maxZ : minZ );
+            outside = or_( outside, and_( cmplt( d1, zero ), cmplt( d2, zero ) ) );
+        }
+        return movemask( outside );
+    };
+
+    auto scalarCulled = [&]( int i ) {
+        for ( int k = 0; k < 6; k ++ ) {
+            double d1 = distance( planes, k, planes.positiveX[ k ] ? minXs[ i ] : maxXs[ i ],
+                                             planes.positiveY[ k ] ? minYs[ i ] : maxYs[ i ],
+                                             planes.positiveZ[ k ] ? minZs[ i ] : maxZs[ i ] );
+            double d2 = distance( planes, k, planes.positiveX[ k ] ? maxXs[ i ] : minXs[ i ],
+                                             planes.positiveY[ k ] ? maxYs[ i ] : minYs[ i ],
+                                             planes.positiveZ[ k ] ? maxZs[ i ] : minZs[ i ] );
+            if ( d1 < 0 && d2 < 0 )
+                return true;
+        }
+        return false;
+    };
+
+    run( count, parallel, [&]( int begin, int end ) {
+        cullRange( begin, end, visible, culled, scalarCulled );
+    } );
+}
+
+} // namespace three
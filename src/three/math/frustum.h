@@ -20,7 +20,8 @@ class Box3;
 class Frustum
 {
 public:
-    Frustum()
+    Frustum():
+        planes( 6 )
     {}
 
     Frustum(const PlaneArray& planes):
@@ -103,7 +104,7 @@ public:
 
         for ( auto i = 0; i < 6 ; i ++ ) {
 
-            auto plane = planes[ i ];
+            const Plane& plane = planes[ i ];
             p1.x = plane.normal.x > 0 ? box.min.x : box.max.x;
             p2.x = plane.normal.x > 0 ? box.max.x : box.min.x;
             p1.y = plane.normal.y > 0 ? box.min.y : box.max.y;
@@ -122,6 +123,15 @@ public:
     }
 
 
+    // Variants for hierarchical culling. Only the planes set in planeMask
+    // ( bit k for planes[ k ] ) are tested, starting with firstPlane. When
+    // the volume is outside firstPlane is set to the rejecting plane, so it
+    // is tried first next time. Otherwise the planes the volume lies entirely
+    // in front of are cleared from planeMask, 0 means it is fully inside.
+    bool intersectsSphere( const Sphere& sphere, int& planeMask, int& firstPlane ) const;
+
+    bool intersectsBox( const Box3& box, int& planeMask, int& firstPlane ) const;
+
     bool containsPoint(const Vector3& point ) const
     {
         const auto& planes = this->planes;
@@ -135,6 +145,19 @@ public:
     }
 
 
+    // Batch versions of intersectsSphere / intersectsBox over SoA input,
+    // several volumes per vector register. Bit i % 64 of visible[ i / 64 ]
+    // is set when volume i is ( possibly ) inside, the answers are the same
+    // as the single volume tests give. visible must hold ( count + 63 ) / 64
+    // words, bits past count are cleared. With parallel set large batches
+    // are split over the global thread pool.
+    void intersectsSpheres( const double* xs, const double* ys, const double* zs, const double* radii,
+                            int count, quint64* visible, bool parallel = false ) const;
+
+    void intersectsBoxes( const double* minXs, const double* minYs, const double* minZs,
+                          const double* maxXs, const double* maxYs, const double* maxZs,
+                          int count, quint64* visible, bool parallel = false ) const;
+
     //private:
     PlaneArray planes;
 };
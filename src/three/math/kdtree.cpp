@@ -0,0 +1,409 @@
+#include "kdtree.h"
+
+#include <algorithm>
+#include <limits>
+
+#include "parallel.hpp"
+#include "simd.hpp"
+
+#include "../core/bufferattribute.h"
+
+namespace three {
+
+namespace {
+
+// parallel builds: subtrees of up to PointsPerTask points are one task
+const int PointsPerTask = 1 << 16;
+
+const int StackSize = 64;
+
+struct Subtree
+{
+    int node;
+    int begin;
+    int end;
+};
+
+// median splits of order[ begin, end ), node numbering from 1, over
+// positions of double or float
+template<typename T>
+struct Builder
+{
+    const T*            positions;
+    int                 stride;
+    QVector<int>&       order;
+    QVector<double>&    splits;
+    QVector<qint8>&     axes;
+    QVector<Subtree>*   subtrees;   // set for the top of a parallel build
+
+    void build( const int& node, const int& begin, const int& end )
+    {
+        if ( end - begin <= KdTree::LeafSize ) {
+            this->axes[ node ] = -1;
+            return;
+        }
+
+        if ( this->subtrees != nullptr && end - begin <= PointsPerTask ) {
+            Subtree subtree = { node, begin, end };
+            this->subtrees->append( subtree );
+            return;
+        }
+
+        int* first = this->order.data() + begin;
+        int* last = this->order.data() + end;
+        int* middle = first + ( end - begin ) / 2;
+
+        double low[ 3 ], high[ 3 ];
+        for ( int a = 0; a < 3; a ++ ) {
+            low[ a ] = std::numeric_limits<double>::infinity();
+            high[ a ] = - std::numeric_limits<double>::infinity();
+        }
+        for ( int* i = first; i != last; i ++ ) {
+            const T* p = this->positions + qint64( *i ) * this->stride;
+            for ( int a = 0; a < 3; a ++ ) {
+                low[ a ] = std::min( low[ a ], double( p[ a ] ) );
+                high[ a ] = std::max( high[ a ], double( p[ a ] ) );
+            }
+        }
+
+        int axis = 0;
+        for ( int a = 1; a < 3; a ++ ) {
+            if ( high[ a ] - low[ a ] > high[ axis ] - low[ axis ] ) {
+                axis = a;
+            }
+        }
+
+        const T* coordinates = this->positions + axis;
+        qint64 stride = this->stride;
+        std::nth_element( first, middle, last, [coordinates, stride]( int a, int b ) {
+            return coordinates[ a * stride ] < coordinates[ b * stride ];
+        } );
+
+        this->axes[ node ] = qint8( axis );
+        this->splits[ node ] = coordinates[ *middle * stride ];
+
+        int mid = int( middle - this->order.data() );
+        this->build( 2 * node, begin, mid );
+        this->build( 2 * node + 1, mid, end );
+    }
+};
+
+// the sorted k best so far
+struct Neighbours
+{
+    int*    indices;
+    double* distances;
+    int     k;
+    int     found;
+
+    double worst( const double& limit ) const
+    {
+        return this->found < this->k ? limit : this->distances[ this->k - 1 ];
+    }
+
+    void insert( const int& index, const double& distance )
+    {
+        int i = this->found < this->k ? this->found ++ : this->k - 1;
+        for ( ; i > 0 && this->distances[ i - 1 ] > distance; i -- ) {
+            this->indices[ i ] = this->indices[ i - 1 ];
+            this->distances[ i ] = this->distances[ i - 1 ];
+        }
+        this->indices[ i ] = index;
+        this->distances[ i ] = distance;
+    }
+};
+
+struct StackEntry
+{
+    int     node;
+    int     begin;
+    int     end;
+    double  distance;   // lower bound of the squared distance to the node
+};
+
+// Walks the leaves near point first, calling visit( begin, end ) for each
+// leaf that may hold a point nearer than limit().
+template<typename Visit, typename Limit>
+void search( const KdTree& tree, const Vector3& point, Visit visit, Limit limit )
+{
+    StackEntry stack[ StackSize ];
+    int top = 0;
+    stack[ top ++ ] = { 1, 0, tree.pointCount, 0 };
+
+    while ( top > 0 ) {
+        StackEntry entry = stack[ -- top ];
+        if ( entry.distance > limit() )
+            continue;
+
+        // down to the leaf on point's side, pushing the far children
+        while ( tree.axes[ entry.node ] >= 0 ) {
+            int axis = tree.axes[ entry.node ];
+            double difference = point.getComponent( axis ) - tree.splits[ entry.node ];
+            int mid = entry.begin + ( entry.end - entry.begin ) / 2;
+
+            StackEntry below = { 2 * entry.node, entry.begin, mid, entry.distance };
+            StackEntry above = { 2 * entry.node + 1, mid, entry.end, entry.distance };
+            StackEntry& nearChild = difference < 0 ? below : above;
+            StackEntry& farChild = difference < 0 ? above : below;
+            farChild.distance = std::max( entry.distance, difference * difference );
+
+            Q_ASSERT( top < StackSize );
+            stack[ top ++ ] = farChild;
+            entry = nearChild;
+        }
+
+        visit( entry.begin, entry.end );
+    }
+}
+
+template<typename T>
+void buildTree( KdTree& tree, const T* positions, const int& count, const int& stride, const bool& parallel )
+{
+    Q_ASSERT( count == 0 || ( positions != nullptr && stride >= 3 ) );
+
+    tree.pointCount = count;
+
+    // a node of c > LeafSize points has children of at most ( c + 1 ) / 2
+    int depth = 0;
+    for ( int c = count; c > KdTree::LeafSize; c = ( c + 1 ) / 2 ) {
+        depth ++;
+    }
+    tree.splits.fill( 0, 2 << depth );
+    tree.axes.fill( -1, 2 << depth );
+
+    tree.indices.resize( count );
+    for ( int i = 0; i < count; i ++ ) {
+        tree.indices[ i ] = i;
+    }
+
+    if ( count > 0 ) {
+        if ( !parallel ) {
+            Builder<T> builder = { positions, stride, tree.indices, tree.splits, tree.axes, nullptr };
+            builder.build( 1, 0, count );
+        } else {
+            QVector<Subtree> subtrees;
+            Builder<T> top = { positions, stride, tree.indices, tree.splits, tree.axes, &subtrees };
+            top.build( 1, 0, count );
+
+            // disjoint ranges of indices and nodes
+            tree.indices.data();
+            tree.splits.data();
+            tree.axes.data();
+            const Subtree* tasks = subtrees.constData();
+            Parallel::forRange( subtrees.size(), 1, [&]( int begin, int end ) {
+                Builder<T> builder = { positions, stride, tree.indices, tree.splits, tree.axes, nullptr };
+                for ( int i = begin; i < end; i ++ ) {
+                    builder.build( tasks[ i ].node, tasks[ i ].begin, tasks[ i ].end );
+                }
+            } );
+        }
+    }
+
+    tree.xs.resize( count );
+    tree.ys.resize( count );
+    tree.zs.resize( count );
+
+    double* xs = tree.xs.data();
+    double* ys = tree.ys.data();
+    double* zs = tree.zs.data();
+    const int* order = tree.indices.constData();
+
+    auto gather = [&]( int begin, int end ) {
+        for ( int i = begin; i < end; i ++ ) {
+            const T* p = positions + qint64( order[ i ] ) * stride;
+            xs[ i ] = p[ 0 ];
+            ys[ i ] = p[ 1 ];
+            zs[ i ] = p[ 2 ];
+        }
+    };
+
+    if ( parallel ) {
+        Parallel::forRange( count, PointsPerTask, gather );
+    } else {
+        gather( 0, count );
+    }
+}
+
+} // namespace
+
+KdTree &KdTree::build(const Vector3Array &points, const bool &parallel)
+{
+    // Vector3 is three doubles, read it as a position array
+    static_assert( sizeof( Vector3 ) == 3 * sizeof( double ), "Vector3 must be 3 packed doubles" );
+    return this->build( points.isEmpty() ? nullptr : &points[ 0 ].x, points.size(), 3, parallel );
+}
+
+KdTree &KdTree::build(const double *positions, const int &count, const int &stride, const bool &parallel)
+{
+    buildTree( *this, positions, count, stride, parallel );
+    return *this;
+}
+
+KdTree &KdTree::build(const float *positions, const int &count, const int &stride, const bool &parallel)
+{
+    buildTree( *this, positions, count, stride, parallel );
+    return *this;
+}
+
+KdTree &KdTree::build(const BufferAttribute &positions, const bool &parallel)
+{
+    Q_ASSERT( positions.isNull() || positions.itemSize >= 3 );
+
+    const int count = positions.count();
+    if ( count == 0 )
+        return this->build( static_cast<const double*>( nullptr ), 0, 3, parallel );
+
+    // read in place when the components are aligned, copy anything else
+    if ( positions.type == BufferAttribute::Float64 && positions.isAlignedFor<double>() ) {
+        return this->build( reinterpret_cast<const double*>( positions.itemData( 0 ) ), count,
+                            positions.stride() / int( sizeof( double ) ), parallel );
+    }
+    if ( positions.type == BufferAttribute::Float32 && positions.isAlignedFor<float>() ) {
+        return this->build( reinterpret_cast<const float*>( positions.itemData( 0 ) ), count,
+                            positions.stride() / int( sizeof( float ) ), parallel );
+    }
+
+    QVector<double> copy( count * 3 );
+    for ( int i = 0; i < count; i ++ ) {
+        copy[ i * 3 ] = positions.getX( i );
+        copy[ i * 3 + 1 ] = positions.getY( i );
+        copy[ i * 3 + 2 ] = positions.getZ( i );
+    }
+    return this->build( copy.constData(), count, 3, parallel );
+}
+
+int KdTree::nearest(const Vector3 &point, double *distanceSq) const
+{
+    int index = -1;
+    double distance = std::numeric_limits<double>::infinity();
+
+    this->nearest( point, 1, &index, &distance );
+
+    if ( distanceSq != nullptr ) {
+        *distanceSq = distance;
+    }
+    return index;
+}
+
+int KdTree::nearest(const Vector3 &point, const int &k, int *indices, double *distancesSq) const
+{
+    Q_ASSERT( k > 0 );
+
+    Neighbours best = { indices, distancesSq, k, 0 };
+    for ( int i = 0; i < k; i ++ ) {
+        indices[ i ] = -1;
+        distancesSq[ i ] = std::numeric_limits<double>::infinity();
+    }
+
+    if ( this->pointCount == 0 )
+        return 0;
+
+    const double infinity = std::numeric_limits<double>::infinity();
+    const double* xs = this->xs.constData();
+    const double* ys = this->ys.constData();
+    const double* zs = this->zs.constData();
+
+    auto limit = [&]() { return best.worst( infinity ); };
+
+    auto visit = [&]( int begin, int end ) {
+        using namespace Simd;
+
+        VDouble px = set1( point.x ), py = set1( point.y ), pz = set1( point.z );
+        alignas( 32 ) double distances[ DoubleLanes ];
+
+        int i = begin;
+        for ( ; i + DoubleLanes <= end; i += DoubleLanes ) {
+            VDouble dx = sub( load( xs + i ), px ), dy = sub( load( ys + i ), py ), dz = sub( load( zs + i ), pz );
+            VDouble d = add( add( mul( dx, dx ), mul( dy, dy ) ), mul( dz, dz ) );
+
+            int mask = movemask( cmplt( d, set1( best.worst( infinity ) ) ) );
+            if ( mask == 0 )
+                continue;
+
+            store( distances, d );
+            for ( int lane = 0; lane < DoubleLanes; lane ++ ) {
+                if ( ( mask & ( 1 << lane ) ) && distances[ lane ] < best.worst( infinity ) ) {
+                    best.insert( this->indices[ i + lane ], distances[ lane ] );
+                }
+            }
+        }
+
+        for ( ; i < end; i ++ ) {
+            double dx = xs[ i ] - point.x, dy = ys[ i ] - point.y, dz = zs[ i ] - point.z;
+            double d = dx * dx + dy * dy + dz * dz;
+            if ( d < best.worst( infinity ) ) {
+                best.insert( this->indices[ i ], d );
+            }
+        }
+    };
+
+    search( *this, point, visit, limit );
+    return best.found;
+}
+
+void KdTree::nearest(const Vector3Array &points, const int &k, QVector<int> &indices, QVector<double> &distancesSq,
+                     const bool &parallel) const
+{
+    Q_ASSERT( k > 0 );
+
+    indices.resize( points.size() * k );
+    distancesSq.resize( points.size() * k );
+
+    int* indexData = indices.data();
+    double* distanceData = distancesSq.data();
+
+    auto body = [&]( int begin, int end ) {
+        for ( int i = begin; i < end; i ++ ) {
+            this->nearest( points[ i ], k, indexData + qint64( i ) * k, distanceData + qint64( i ) * k );
+        }
+    };
+
+    if ( parallel ) {
+        Parallel::forRange( points.size(), 256, body );
+    } else {
+        body( 0, points.size() );
+    }
+}
+
+void KdTree::withinRadius(const Vector3 &point, const double &radius, QVector<int> &result) const
+{
+    if ( this->pointCount == 0 )
+        return;
+
+    const double radiusSq = radius * radius;
+    const double* xs = this->xs.constData();
+    const double* ys = this->ys.constData();
+    const double* zs = this->zs.constData();
+
+    auto limit = [&]() { return radiusSq; };
+
+    auto visit = [&]( int begin, int end ) {
+        using namespace Simd;
+
+        VDouble px = set1( point.x ), py = set1( point.y ), pz = set1( point.z ), r = set1( radiusSq );
+
+        int i = begin;
+        for ( ; i + DoubleLanes <= end; i += DoubleLanes ) {
+            VDouble dx = sub( load( xs + i ), px ), dy = sub( load( ys + i ), py ), dz = sub( load( zs + i ), pz );
+            VDouble d = add( add( mul( dx, dx ), mul( dy, dy ) ), mul( dz, dz ) );
+
+            int mask = movemask( cmple( d, r ) );
+            for ( int lane = 0; mask != 0; lane ++, mask >>= 1 ) {
+                if ( mask & 1 ) {
+                    result.append( this->indices[ i + lane ] );
+                }
+            }
+        }
+
+        for ( ; i < end; i ++ ) {
+            double dx = xs[ i ] - point.x, dy = ys[ i ] - point.y, dz = zs[ i ] - point.z;
+            if ( dx * dx + dy * dy + dz * dz <= radiusSq ) {
+                result.append( this->indices[ i ] );
+            }
+        }
+    };
+
+    search( *this, point, visit, limit );
+}
+
+} // namespace three
@@ -0,0 +1,86 @@
+#ifndef THREE_KDTREE_H
+#define THREE_KDTREE_H
+
+#include <QVector>
+
+#include "math_forword_declar.h"
+
+#include "vector3.h"
+
+namespace three {
+
+class Vector3;
+
+// k-d tree for nearest neighbour and radius queries over a point cloud.
+//
+// Every node splits its points at the median along the axis of their
+// largest extent, so the tree is balanced and laid out implicitly: node i
+// has its children at 2i and 2i + 1 and only the split plane is stored.
+// The points are copied in leaf order as separate x / y / z arrays, a leaf
+// is a run of up to LeafSize points scanned Simd::DoubleLanes at a time.
+//
+// Results are indices into the points given to build().
+class KdTree
+{
+public:
+    static const int LeafSize = 16;
+
+    KdTree():
+        pointCount( 0 )
+    { }
+
+    // A parallel build splits the top of the tree serially and builds the
+    // subtrees below on the global thread pool, the tree is the same.
+    KdTree& build( const Vector3Array& points, const bool& parallel = false );
+
+    // count points of 3 coordinates, stride doubles apart, e.g. the array
+    // of a position BufferAttribute
+    KdTree& build( const double* positions, const int& count, const int& stride = 3, const bool& parallel = false );
+
+    // the same over floats, stride floats apart; the tree keeps doubles
+    KdTree& build( const float* positions, const int& count, const int& stride = 3, const bool& parallel = false );
+
+    // the first 3 components of every item, read in place when the
+    // attribute is Float64 / Float32 and aligned, converted otherwise
+    KdTree& build( const BufferAttribute& positions, const bool& parallel = false );
+
+    bool isEmpty() const
+    {
+        return this->pointCount == 0;
+    }
+
+    int size() const
+    {
+        return this->pointCount;
+    }
+
+    // nearest point, -1 for an empty tree
+    int nearest( const Vector3& point, double* distanceSq = nullptr ) const;
+
+    // Writes the k nearest points, nearest first, to indices / distancesSq
+    // ( k entries each ) and returns how many there are, less than k only
+    // when the tree has fewer points. Does not allocate.
+    int nearest( const Vector3& point, const int& k, int* indices, double* distancesSq ) const;
+
+    // Nearest k for every point: indices / distancesSq get k entries per
+    // point, padded with -1 / infinity. Runs on the global thread pool if
+    // parallel.
+    void nearest( const Vector3Array& points, const int& k, QVector<int>& indices, QVector<double>& distancesSq,
+                  const bool& parallel = true ) const;
+
+    // appends the points within radius of point, in no particular order
+    void withinRadius( const Vector3& point, const double& radius, QVector<int>& result ) const;
+
+    // private:
+    QVector<double> xs;         // leaf order
+    QVector<double> ys;
+    QVector<double> zs;
+    QVector<int>    indices;    // leaf order -> original index
+    QVector<double> splits;     // by node, from 1
+    QVector<qint8>  axes;       // by node, -1 for leaves
+    int             pointCount;
+};
+
+} // namespace three
+
+#endif // THREE_KDTREE_H
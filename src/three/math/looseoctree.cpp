@@ -0,0 +1,382 @@
+#include "looseoctree.h"
+
+#include <algorithm>
+
+namespace three {
+
+namespace {
+
+// 7 pending siblings per level of MaxDepth levels, and 8 children
+const int MaxDepth = 32;
+const int StackSize = 7 * MaxDepth + 8;
+
+const int AllPlanes = ( 1 << 6 ) - 1;
+
+// Whether the ray enters box before maxDistance. NaN ( 0 * infinity for
+// rays in a slab plane ) is dropped by the min / max order, the slab counts
+// as hit.
+inline bool entersBox( const Box3& box, const Vector3& origin, const Vector3& inverseDirection, const double& maxDistance )
+{
+    double entry = 0, exit = maxDistance;
+
+    double t1 = ( box.min.x - origin.x ) * inverseDirection.x, t2 = ( box.max.x - origin.x ) * inverseDirection.x;
+    entry = std::max( entry, std::min( t1, t2 ) );
+    exit = std::min( exit, std::max( t1, t2 ) );
+
+    t1 = ( box.min.y - origin.y ) * inverseDirection.y, t2 = ( box.max.y - origin.y ) * inverseDirection.y;
+    entry = std::max( entry, std::min( t1, t2 ) );
+    exit = std::min( exit, std::max( t1, t2 ) );
+
+    t1 = ( box.min.z - origin.z ) * inverseDirection.z, t2 = ( box.max.z - origin.z ) * inverseDirection.z;
+    entry = std::max( entry, std::min( t1, t2 ) );
+    exit = std::min( exit, std::max( t1, t2 ) );
+
+    return entry <= exit;
+}
+
+} // namespace
+
+const int LooseOctree::NoNode;
+
+LooseOctree::LooseOctree(const Vector3 &center, const double &halfSize, const int &maxDepth):
+    freeItems( NoNode ),
+    itemCount( 0 ),
+    maxDepth( maxDepth )
+{
+    Q_ASSERT( halfSize > 0 && maxDepth >= 0 && maxDepth <= MaxDepth );
+
+    Node root;
+    root.center = center;
+    root.halfSize = halfSize;
+    root.looseBounds.setFromCenterAndSize( center, Vector3( 4 * halfSize, 4 * halfSize, 4 * halfSize ) );
+    root.parent = NoNode;
+    root.firstChild = NoNode;
+    root.firstItem = NoNode;
+    root.itemCount = 0;
+    root.depth = 0;
+    this->nodes.append( root );
+}
+
+LooseOctree::ItemId LooseOctree::insert(const Box3 &box, const int &data, const bool &frustumCulled)
+{
+    Q_ASSERT( !box.isEmpty() );
+
+    ItemId id;
+    if ( this->freeItems != NoNode ) {
+        id = this->freeItems;
+        this->freeItems = this->items[ id ].next;
+    } else {
+        id = this->items.size();
+        this->items.append( Item() );
+    }
+
+    Item& item = this->items[ id ];
+    item.bounds = box;
+    item.data = data;
+    item.frustumCulled = frustumCulled;
+
+    if ( !frustumCulled ) {
+        this->unculled.append( id );
+    }
+
+    this->link( id, this->nodeFor( box ) );
+    this->itemCount ++;
+    return id;
+}
+
+void LooseOctree::remove(const ItemId &item)
+{
+    Q_ASSERT( item >= 0 && item < this->items.size() && this->items[ item ].node != NoNode );
+
+    this->unlink( item );
+    this->setFrustumCulled( item, true );
+
+    this->items[ item ].next = this->freeItems;
+    this->freeItems = item;
+    this->itemCount --;
+}
+
+void LooseOctree::move(const ItemId &item, const Box3 &box)
+{
+    Q_ASSERT( item >= 0 && item < this->items.size() && this->items[ item ].node != NoNode );
+    Q_ASSERT( !box.isEmpty() );
+
+    this->items[ item ].bounds = box;
+
+    int node = this->nodeFor( box );
+    if ( node != this->items[ item ].node ) {
+        this->unlink( item );
+        this->link( item, node );
+    }
+}
+
+void LooseOctree::setFrustumCulled(const ItemId &item, const bool &frustumCulled)
+{
+    Item& changed = this->items[ item ];
+    if ( changed.frustumCulled == frustumCulled )
+        return;
+
+    changed.frustumCulled = frustumCulled;
+    if ( frustumCulled ) {
+        this->unculled.remove( this->unculled.indexOf( item ) );
+    } else {
+        this->unculled.append( item );
+    }
+}
+
+void LooseOctree::clear()
+{
+    this->nodes.resize( 1 );
+    Node& root = this->nodes[ 0 ];
+    root.firstChild = NoNode;
+    root.firstItem = NoNode;
+    root.itemCount = 0;
+
+    this->freeBlocks.clear();
+    this->items.clear();
+    this->freeItems = NoNode;
+    this->itemCount = 0;
+    this->unculled.clear();
+}
+
+void LooseOctree::rebalance()
+{
+    this->prune( 0 );
+}
+
+LooseOctree::MemoryStats LooseOctree::memoryStats() const
+{
+    MemoryStats stats;
+    stats.freeNodeCount = 8 * this->freeBlocks.size();
+    stats.nodeCount = this->nodes.size() - stats.freeNodeCount;
+    stats.itemCount = this->itemCount;
+
+    stats.maxDepth = 0;
+    for ( int i = 0; i < this->nodes.size(); i ++ ) {
+        stats.maxDepth = std::max( stats.maxDepth, this->nodes[ i ].depth );
+    }
+
+    stats.bytes = qint64( this->nodes.capacity() ) * sizeof( Node )
+                + qint64( this->items.capacity() ) * sizeof( Item )
+                + qint64( this->freeBlocks.capacity() + this->unculled.capacity() ) * sizeof( int );
+    return stats;
+}
+
+void LooseOctree::query(const Box3 &box, QVector<ItemId> &result) const
+{
+    int stack[ StackSize ];
+    int top = 0;
+    stack[ top ++ ] = 0;
+
+    while ( top > 0 ) {
+        const Node& node = this->nodes[ stack[ -- top ] ];
+
+        // the root also holds the items outside of it
+        if ( node.itemCount == 0 || ( node.depth > 0 && !node.looseBounds.intersectsBox( box ) ) )
+            continue;
+
+        for ( int i = node.firstItem; i != NoNode; i = this->items[ i ].next ) {
+            if ( this->items[ i ].bounds.intersectsBox( box ) ) {
+                result.append( i );
+            }
+        }
+
+        if ( node.firstChild != NoNode ) {
+            Q_ASSERT( top + 8 <= StackSize );
+            for ( int k = 0; k < 8; k ++ ) {
+                stack[ top ++ ] = node.firstChild + k;
+            }
+        }
+    }
+}
+
+void LooseOctree::query(const Frustum &frustum, QVector<ItemId> &result) const
+{
+    result += this->unculled;
+
+    // the planes left to test below a node, none for subtrees fully inside
+    struct Entry { int index; int planes; };
+    Entry stack[ StackSize ];
+    int top = 0;
+    stack[ top ++ ] = { 0, AllPlanes };
+
+    int firstPlane = 0;
+
+    while ( top > 0 ) {
+        Entry entry = stack[ -- top ];
+        const Node& node = this->nodes[ entry.index ];
+
+        if ( node.itemCount == 0 )
+            continue;
+
+        if ( node.depth > 0 && entry.planes != 0 && !frustum.intersectsBox( node.looseBounds, entry.planes, firstPlane ) )
+            continue;
+
+        for ( int i = node.firstItem; i != NoNode; i = this->items[ i ].next ) {
+            const Item& item = this->items[ i ];
+            int planes = entry.planes;
+            if ( item.frustumCulled && ( planes == 0 || frustum.intersectsBox( item.bounds, planes, firstPlane ) ) ) {
+                result.append( i );
+            }
+        }
+
+        if ( node.firstChild != NoNode ) {
+            Q_ASSERT( top + 8 <= StackSize );
+            for ( int k = 0; k < 8; k ++ ) {
+                stack[ top ++ ] = { node.firstChild + k, entry.planes };
+            }
+        }
+    }
+}
+
+bool LooseOctree::intersect(const Ray &ray, Ray::Hit &hit) const
+{
+    Vector3 inverseDirection( 1 / ray.direction.x, 1 / ray.direction.y, 1 / ray.direction.z );
+
+    int stack[ StackSize ];
+    int top = 0;
+    stack[ top ++ ] = 0;
+
+    bool found = false;
+
+    while ( top > 0 ) {
+        const Node& node = this->nodes[ stack[ -- top ] ];
+
+        if ( node.itemCount == 0 || ( node.depth > 0 && !entersBox( node.looseBounds, ray.origin, inverseDirection, hit.distance ) ) )
+            continue;
+
+        for ( int i = node.firstItem; i != NoNode; i = this->items[ i ].next ) {
+            if ( ray.intersectBox( this->items[ i ].bounds, hit ) ) {
+                hit.primitive = i;
+                found = true;
+            }
+        }
+
+        if ( node.firstChild != NoNode ) {
+            Q_ASSERT( top + 8 <= StackSize );
+            for ( int k = 0; k < 8; k ++ ) {
+                stack[ top ++ ] = node.firstChild + k;
+            }
+        }
+    }
+    return found;
+}
+
+int LooseOctree::nodeFor(const Box3 &box)
+{
+    Vector3 center = box.center();
+    double size = std::max( std::max( box.max.x - box.min.x, box.max.y - box.min.y ), box.max.z - box.min.z );
+
+    // A child's loose cube reaches its cell's size past the cell, which is
+    // half of this node's size: any item of up to that size whose center
+    // is in the child's cell fits in it.
+    int index = 0;
+    while ( this->nodes[ index ].depth < this->maxDepth && size <= this->nodes[ index ].halfSize ) {
+        const Node& node = this->nodes[ index ];
+
+        if ( std::abs( center.x - node.center.x ) > node.halfSize ||
+             std::abs( center.y - node.center.y ) > node.halfSize ||
+             std::abs( center.z - node.center.z ) > node.halfSize )
+            break;
+
+        int octant = ( center.x >= node.center.x ? 1 : 0 )
+                   | ( center.y >= node.center.y ? 2 : 0 )
+                   | ( center.z >= node.center.z ? 4 : 0 );
+
+        int firstChild = node.firstChild != NoNode ? node.firstChild : this->allocateChildren( index );
+        index = firstChild + octant;
+    }
+    return index;
+}
+
+void LooseOctree::link(const ItemId &item, const int &node)
+{
+    Item& linked = this->items[ item ];
+    Node& owner = this->nodes[ node ];
+
+    linked.node = node;
+    linked.previous = NoNode;
+    linked.next = owner.firstItem;
+    if ( owner.firstItem != NoNode ) {
+        this->items[ owner.firstItem ].previous = item;
+    }
+    owner.firstItem = item;
+
+    for ( int n = node; n != NoNode; n = this->nodes[ n ].parent ) {
+        this->nodes[ n ].itemCount ++;
+    }
+}
+
+void LooseOctree::unlink(const ItemId &item)
+{
+    Item& unlinked = this->items[ item ];
+
+    if ( unlinked.previous != NoNode ) {
+        this->items[ unlinked.previous ].next = unlinked.next;
+    } else {
+        this->nodes[ unlinked.node ].firstItem = unlinked.next;
+    }
+    if ( unlinked.next != NoNode ) {
+        this->items[ unlinked.next ].previous = unlinked.previous;
+    }
+
+    for ( int n = unlinked.node; n != NoNode; n = this->nodes[ n ].parent ) {
+        this->nodes[ n ].itemCount --;
+    }
+    unlinked.node = NoNode;
+}
+
+int LooseOctree::allocateChildren(const int &node)
+{
+    int first;
+    if ( !this->freeBlocks.isEmpty() ) {
+        first = this->freeBlocks.takeLast();
+    } else {
+        first = this->nodes.size();
+        this->nodes.resize( first + 8 );
+    }
+
+    const Node& parent = this->nodes[ node ];
+    double halfSize = parent.halfSize * 0.5;
+
+    for ( int k = 0; k < 8; k ++ ) {
+        Node& child = this->nodes[ first + k ];
+        child.center.set( parent.center.x + ( k & 1 ? halfSize : - halfSize ),
+                          parent.center.y + ( k & 2 ? halfSize : - halfSize ),
+                          parent.center.z + ( k & 4 ? halfSize : - halfSize ) );
+        child.halfSize = halfSize;
+        child.looseBounds.setFromCenterAndSize( child.center, Vector3( 4 * halfSize, 4 * halfSize, 4 * halfSize ) );
+        child.parent = node;
+        child.firstChild = NoNode;
+        child.firstItem = NoNode;
+        child.itemCount = 0;
+        child.depth = parent.depth + 1;
+    }
+
+    this->nodes[ node ].firstChild = first;
+    return first;
+}
+
+void LooseOctree::prune(const int &node)
+{
+    int first = this->nodes[ node ].firstChild;
+    if ( first == NoNode )
+        return;
+
+    bool empty = true;
+    for ( int k = 0; k < 8; k ++ ) {
+        this->prune( first + k );
+        empty = empty && this->nodes[ first + k ].itemCount == 0;
+    }
+
+    if ( empty ) {
+        // the children have freed their own blocks already
+        for ( int k = 0; k < 8; k ++ ) {
+            this->nodes[ first + k ].depth = -1;
+        }
+        this->freeBlocks.append( first );
+        this->nodes[ node ].firstChild = NoNode;
+    }
+}
+
+} // namespace three
@@ -0,0 +1,139 @@
+#ifndef THREE_LOOSEOCTREE_H
+#define THREE_LOOSEOCTREE_H
+
+#include <QVector>
+
+#include "math_forword_declar.h"
+
+#include "vector3.h"
+#include "box3.h"
+#include "frustum.h"
+#include "ray.h"
+
+namespace three {
+
+class Box3;
+class Frustum;
+class Ray;
+
+// Loose octree over world space boxes, for large, mostly static worlds.
+//
+// Every node's cube is grown to twice its size for the items in it, so an
+// item is stored in the one deepest node whose cell holds its center and
+// whose loose cube holds all of it: an insertion is a single walk down,
+// items never straddle nodes. Items outside the root cube stay in the root.
+//
+// The nodes live in one pool, the 8 children of a node next to each other,
+// the items of a node in a linked list through the item pool. Removing
+// items leaves empty nodes behind, rebalance() returns them to the pool.
+//
+// Objects are added with their Box3::setFromObject() box, the node as data
+// and frustumCulled(): the frustum query reports items with frustumCulled
+// off wherever they are, like the renderer does.
+class LooseOctree
+{
+public:
+    typedef int ItemId;
+
+    static const int NoNode = -1;
+
+    struct Node
+    {
+        Box3    looseBounds;    // the cell grown by half its size on every side
+        Vector3 center;
+        double  halfSize;       // of the cell
+        int     parent;
+        int     firstChild;     // block of 8 children, NoNode for leaves
+        int     firstItem;      // list through Item::next
+        int     itemCount;      // in the subtree
+        int     depth;
+    };
+
+    struct Item
+    {
+        Box3    bounds;
+        int     data;
+        int     node;           // NoNode for unused items
+        int     previous;
+        int     next;           // next free item for unused items
+        bool    frustumCulled;
+    };
+
+    struct MemoryStats
+    {
+        int     nodeCount;      // in use
+        int     freeNodeCount;  // pooled, after rebalance()
+        int     itemCount;
+        int     maxDepth;       // deepest node in use
+        qint64  bytes;          // reserved by the pools
+    };
+
+    // the root cell, items get down to maxDepth ( at most 32 )
+    LooseOctree( const Vector3& center, const double& halfSize, const int& maxDepth = 12 );
+
+    int count() const
+    {
+        return this->itemCount;
+    }
+
+    ItemId insert( const Box3& box, const int& data = -1, const bool& frustumCulled = true );
+
+    void remove( const ItemId& item );
+
+    // Only relinks the item when it belongs to another node now.
+    void move( const ItemId& item, const Box3& box );
+
+    void setFrustumCulled( const ItemId& item, const bool& frustumCulled );
+
+    const Box3& bounds( const ItemId& item ) const
+    {
+        return this->items[ item ].bounds;
+    }
+
+    int data( const ItemId& item ) const
+    {
+        return this->items[ item ].data;
+    }
+
+    void clear();
+
+    // Frees the blocks of children below nodes without items in them.
+    // Removals leave them in place so a remove / insert pair in the same
+    // region does not free and rebuild the same nodes.
+    void rebalance();
+
+    MemoryStats memoryStats() const;
+
+    // append the items whose box overlaps box / frustum to result
+    void query( const Box3& box, QVector<ItemId>& result ) const;
+
+    void query( const Frustum& frustum, QVector<ItemId>& result ) const;
+
+    // nearest item box along the ray ( see Ray::intersectBox ), hit.primitive
+    // gets the item id
+    bool intersect( const Ray& ray, Ray::Hit& hit ) const;
+
+    // private:
+    QVector<Node>   nodes;
+    QVector<int>    freeBlocks;     // first nodes of unused blocks of 8
+    QVector<Item>   items;
+    int             freeItems;
+    int             itemCount;
+    QVector<ItemId> unculled;       // items with frustumCulled off
+    int             maxDepth;
+
+private:
+    int nodeFor( const Box3& box );
+
+    void link( const ItemId& item, const int& node );
+
+    void unlink( const ItemId& item );
+
+    int allocateChildren( const int& node );
+
+    void prune( const int& node );
+};
+
+} // namespace three
+
+#endif // THREE_LOOSEOCTREE_H
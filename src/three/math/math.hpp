@@ -6,6 +6,8 @@
 #include <QtMath>
 #include <QUuid>
 
+#include "random.h"
+
 namespace three {
 namespace Math {
 
@@ -61,15 +63,23 @@ inline T smootherstep (T x, T min, T max )
 }
 
 
-// TODO
-inline int random() {
-    qsrand(10);
-    return qrand();
+// [ 0, 1 ) from the calling thread's generator, see Random::local(). Not
+// reproducible across runs once several threads draw from it.
+inline double random() {
+    return Random::local().nextDouble();
 }
 
 
-inline int random16() {
-    return random();
+// [ 0, 1 ) with 16 bits of randomness
+inline double random16() {
+    return ( 65280 * Math::random() + 255 * Math::random() ) / 65535;
+}
+
+
+// Random integer from <low, high> interval
+inline int randInt( int low, int high )
+{
+    return Random::local().nextInt( low, high );
 }
 
 
@@ -77,14 +87,15 @@ inline int random16() {
 template<typename T>
 inline T randFloat(T low, T high )
 {
-    return low + Math::random() * ( high - low );
+    return low + T( Math::random() ) * ( high - low );
 }
 
 
+// Random float from <-range/2, range/2> interval
 template<typename T>
 inline T randFloatSpread(T range )
 {
-    return range * ( 0.5 - Math::random());
+    return range * T( 0.5 - Math::random() );
 }
 
 
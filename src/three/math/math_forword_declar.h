@@ -4,6 +4,8 @@
 #include <QVector>
 #include <QtDebug>
 
+#include <array>
+
 namespace three {
 
 class Euler;
@@ -13,6 +15,8 @@ class Vector3;
 class Vector4;
 class Matrix3;
 class Matrix4;
+class Vector3f;
+class Matrix4f;
 
 class Line3;
 class Triangle;
@@ -23,11 +27,21 @@ class Box3;
 class Frustum;
 class Sphere;
 
+class BufferAttribute;
+
 typedef QVector<double> Float32Array;
 typedef QVector<Vector2> Vector2Array;
 typedef QVector<Vector3> Vector3Array;
 typedef QVector<Plane> PlaneArray;
 
+// column-major 4x4 coefficients, stored inline so Matrix4 never allocates
+typedef std::array<double, 16> Matrix4Elements;
+
+// single precision data for the bulk kernels, see Vector3f / Matrix4f
+typedef QVector<float> FloatArray;
+typedef QVector<Vector3f> Vector3fArray;
+typedef std::array<float, 16> Matrix4fElements;
+
 
 
 
@@ -1,7 +1,29 @@
 #include "matrix3.h"
 
+#include "../core/bufferattribute.h"
+
 namespace three {
 
+BufferAttribute &Matrix3::applyToBuffer(BufferAttribute &buffer, int offset, int length) const
+{
+    Q_ASSERT( buffer.isNull() || buffer.itemSize >= 3 );
 
-} // namespace three
+    if ( length == 0 )
+        length = buffer.count() - offset;
+
+    // nothing to do, e.g. a null attribute
+    if ( length <= 0 )
+        return buffer;
 
+    Vector3 v1;
+    for ( int i = 0, j = offset; i < length; i ++, j ++ ) {
+        v1.fromAttribute( buffer, j );
+        v1.applyMatrix3( *this );
+        buffer.setXYZ( j, v1.x, v1.y, v1.z );
+    }
+
+    buffer.markDirty( offset, length );
+    return buffer;
+}
+
+} // namespace three
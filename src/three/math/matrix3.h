@@ -76,25 +76,9 @@ public:
 //            return array;
 //        }
 
-    // TODO
-    //    applyToBuffer( buffer, int offset = 0, int length = 0) {
-
-    //        Vector3 v1;
-    //        if ( length == 0 )
-    //            length = buffer.length / buffer.itemSize;
-
-    //        for ( var i = 0, j = offset; i < length; i ++, j ++ ) {
-
-    //            v1.x = buffer.getX( j );
-    //            v1.y = buffer.getY( j );
-    //            v1.z = buffer.getZ( j );
-
-    //            v1.applyMatrix3( this );
-
-    //            buffer.setXYZ( v1.x, v1.y, v1.z );
-    //        }
-    //        return buffer;
-    //    }
+    // transforms items [ offset, offset + length ) of a 3 component attribute
+    // in place and marks them dirty, length 0 means up to the end
+    BufferAttribute& applyToBuffer( BufferAttribute& buffer, int offset = 0, int length = 0 ) const;
 
     Matrix3& multiplyScalar(const double& s )
     {
@@ -1,7 +1,183 @@
 #include "matrix4.h"
+#include "matrix4f.h"
+
+#include "simd.hpp"
+#include "parallel.hpp"
+
+#include "../core/bufferattribute.h"
 
 namespace three {
 
+namespace {
 
-} // namespace three
+const int PointsPerTask = 1 << 16;
+const int PointsPerTile = 64;
+
+// x' = ( ( e0 * x + e4 * y ) + e8 * z ) + e12, ... the evaluation order of
+// Vector3::applyMatrix4 / applyProjection, so results match them exactly
+template<bool Projective>
+void transformPoints( const Matrix4Elements& e,
+                      const double* xs, const double* ys, const double* zs,
+                      double* xd, double* yd, double* zd, int begin, int end )
+{
+    using namespace Simd;
+
+    VDouble e0 = set1( e[ 0 ] ), e4 = set1( e[ 4 ] ), e8 = set1( e[ 8 ] ), e12 = set1( e[ 12 ] );
+    VDouble e1 = set1( e[ 1 ] ), e5 = set1( e[ 5 ] ), e9 = set1( e[ 9 ] ), e13 = set1( e[ 13 ] );
+    VDouble e2 = set1( e[ 2 ] ), e6 = set1( e[ 6 ] ), e10 = set1( e[ 10 ] ), e14 = set1( e[ 14 ] );
+    VDouble e3 = set1( e[ 3 ] ), e7 = set1( e[ 7 ] ), e11 = set1( e[ 11 ] ), e15 = set1( e[ 15 ] );
+    VDouble one = set1( 1 );
+
+    int i = begin;
+    for ( ; i + DoubleLanes <= end; i += DoubleLanes ) {
+        VDouble x = load( xs + i ), y = load( ys + i ), z = load( zs + i );
+
+        VDouble rx = add( add( add( mul( e0, x ), mul( e4, y ) ), mul( e8, z ) ), e12 );
+        VDouble ry = add( add( add( mul( e1, x ), mul( e5, y ) ), mul( e9, z ) ), e13 );
+        VDouble rz = add( add( add( mul( e2, x ), mul( e6, y ) ), mul( e10, z ) ), e14 );
+
+        if ( Projective ) {
+            VDouble d = div( one, add( add( add( mul( e3, x ), mul( e7, y ) ), mul( e11, z ) ), e15 ) );
+            rx = mul( rx, d );
+            ry = mul( ry, d );
+            rz = mul( rz, d );
+        }
+
+        store( xd + i, rx );
+        store( yd + i, ry );
+        store( zd + i, rz );
+    }
+
+    for ( ; i < end; i ++ ) {
+        double x = xs[ i ], y = ys[ i ], z = zs[ i ];
+
+        double rx = e[ 0 ] * x + e[ 4 ] * y + e[ 8 ]  * z + e[ 12 ];
+        double ry = e[ 1 ] * x + e[ 5 ] * y + e[ 9 ]  * z + e[ 13 ];
+        double rz = e[ 2 ] * x + e[ 6 ] * y + e[ 10 ] * z + e[ 14 ];
+
+        if ( Projective ) {
+            double d = 1 / ( e[ 3 ] * x + e[ 7 ] * y + e[ 11 ] * z + e[ 15 ] );
+            rx *= d;
+            ry *= d;
+            rz *= d;
+        }
+
+        xd[ i ] = rx;
+        yd[ i ] = ry;
+        zd[ i ] = rz;
+    }
+}
+
+// interleaved points are gathered into small SoA tiles on the stack,
+// transformed with the vector kernel and scattered back
+template<bool Projective>
+void transformInterleavedPoints( const Matrix4Elements& e, const double* src, double* dst,
+                                 int stride, int begin, int end )
+{
+    double x[ PointsPerTile ], y[ PointsPerTile ], z[ PointsPerTile ];
+
+    for ( int first = begin; first < end; first += PointsPerTile ) {
+        int n = std::min( PointsPerTile, end - first );
 
+        const double* s = src + qptrdiff( first ) * stride;
+        for ( int i = 0; i < n; i ++, s += stride ) {
+            x[ i ] = s[ 0 ];
+            y[ i ] = s[ 1 ];
+            z[ i ] = s[ 2 ];
+        }
+
+        transformPoints<Projective>( e, x, y, z, x, y, z, 0, n );
+
+        double* d = dst + qptrdiff( first ) * stride;
+        for ( int i = 0; i < n; i ++, d += stride ) {
+            d[ 0 ] = x[ i ];
+            d[ 1 ] = y[ i ];
+            d[ 2 ] = z[ i ];
+        }
+    }
+}
+
+template<typename Body>
+void run( int count, bool parallel, Body body )
+{
+    if ( parallel ) {
+        Parallel::forRange( count, PointsPerTask, body );
+    } else {
+        body( 0, count );
+    }
+}
+
+} // namespace
+
+void Matrix4::applyToPoints(const double *src, double *dst, int count, int stride, bool parallel) const
+{
+    Q_ASSERT( stride >= 3 );
+    const auto& e = this->elements;
+    run( count, parallel, [&]( int begin, int end ) {
+        transformInterleavedPoints<false>( e, src, dst, stride, begin, end );
+    } );
+}
+
+void Matrix4::applyProjectionToPoints(const double *src, double *dst, int count, int stride, bool parallel) const
+{
+    Q_ASSERT( stride >= 3 );
+    const auto& e = this->elements;
+    run( count, parallel, [&]( int begin, int end ) {
+        transformInterleavedPoints<true>( e, src, dst, stride, begin, end );
+    } );
+}
+
+void Matrix4::applyToPointsSoA(const double *xs, const double *ys, const double *zs,
+                               double *xd, double *yd, double *zd, int count, bool parallel) const
+{
+    const auto& e = this->elements;
+    run( count, parallel, [&]( int begin, int end ) {
+        transformPoints<false>( e, xs, ys, zs, xd, yd, zd, begin, end );
+    } );
+}
+
+void Matrix4::applyProjectionToPointsSoA(const double *xs, const double *ys, const double *zs,
+                                         double *xd, double *yd, double *zd, int count, bool parallel) const
+{
+    const auto& e = this->elements;
+    run( count, parallel, [&]( int begin, int end ) {
+        transformPoints<true>( e, xs, ys, zs, xd, yd, zd, begin, end );
+    } );
+}
+
+BufferAttribute &Matrix4::applyToBuffer(BufferAttribute &buffer, int offset, int length) const
+{
+    Q_ASSERT( buffer.isNull() || buffer.itemSize >= 3 );
+
+    if ( length == 0 )
+        length = buffer.count() - offset;
+
+    // nothing to do, e.g. a null attribute
+    if ( length <= 0 )
+        return buffer;
+
+    // the fast paths read the components in place, anything unaligned
+    // goes through the generic per item path
+    if ( buffer.type == BufferAttribute::Float64 && buffer.isAlignedFor<double>() ) {
+        // doubles are transformed in place, no conversion
+        double* data = reinterpret_cast<double*>( buffer.itemData( offset ) );
+        this->applyToPoints( data, data, length, buffer.stride() / int( sizeof( double ) ) );
+    } else if ( buffer.type == BufferAttribute::Float32 && buffer.isAlignedFor<float>() ) {
+        // floats stay floats: the matrix is rounded once and the points are
+        // transformed in single precision, FloatLanes at a time
+        float* data = reinterpret_cast<float*>( buffer.itemData( offset ) );
+        Matrix4f( *this ).applyToPoints( data, data, length, buffer.stride() / int( sizeof( float ) ) );
+    } else {
+        Vector3 v1;
+        for ( int i = 0, j = offset; i < length; i ++, j ++ ) {
+            v1.fromAttribute( buffer, j );
+            v1.applyMatrix4( *this );
+            buffer.setXYZ( j, v1.x, v1.y, v1.z );
+        }
+    }
+
+    buffer.markDirty( offset, length );
+    return buffer;
+}
+
+} // namespace three
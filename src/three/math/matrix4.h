@@ -3,10 +3,12 @@
 
 #include "math_forword_declar.h"
 #include "math.hpp"
+#include "simd.hpp"
 
 #include "vector3.h"
 #include "quaternion.h"
 #include "euler.h"
+#include "rotation.h"
 
 namespace three {
 
@@ -14,11 +16,11 @@ class Matrix4
 {
 public:
     Matrix4():
-        elements ( {
+        elements ( {{
                    1, 0, 0, 0,
                    0, 1, 0, 0,
                    0, 0, 1, 0,
-                   0, 0, 0, 1 })
+                   0, 0, 0, 1 }} )
     {
     }
 
@@ -47,11 +49,9 @@ public:
                            0, 0, 0, 1 );
     }
 
-    Matrix4 clone()
+    Matrix4 clone() const
     {
-
-        return  Matrix4().fromArray( this->elements );
-
+        return Matrix4( *this );
     }
 
     Matrix4& copy(const Matrix4& m )
@@ -119,161 +119,30 @@ public:
         return *this;
     }
 
+    // see Rotation::eulersToMatrices() for arrays
     Matrix4& makeRotationFromEuler(const Euler& euler )
     {
-
         auto& te = this->elements;
-
         double x = euler.x, y = euler.y, z = euler.z;
-        double a = std::cos( x ), b = std::sin( x );
-        double c = std::cos( y ), d = std::sin( y );
-        double e = std::cos( z ), f = std::sin( z );
-
-        if ( euler.order == Euler::XYZ ) {
-
-            double ae = a * e, af = a * f, be = b * e, bf = b * f;
-
-            te[ 0 ] = c * e;
-            te[ 4 ] = - c * f;
-            te[ 8 ] = d;
-
-            te[ 1 ] = af + be * d;
-            te[ 5 ] = ae - bf * d;
-            te[ 9 ] = - b * c;
-
-            te[ 2 ] = bf - ae * d;
-            te[ 6 ] = be + af * d;
-            te[ 10 ] = a * c;
-
-        } else if ( euler.order == Euler::YXZ ) {
-
-            double ce = c * e, cf = c * f, de = d * e, df = d * f;
-
-            te[ 0 ] = ce + df * b;
-            te[ 4 ] = de * b - cf;
-            te[ 8 ] = a * d;
-
-            te[ 1 ] = a * f;
-            te[ 5 ] = a * e;
-            te[ 9 ] = - b;
-
-            te[ 2 ] = cf * b - de;
-            te[ 6 ] = df + ce * b;
-            te[ 10 ] = a * c;
-
-        } else if ( euler.order == Euler::ZXY ) {
-
-            double ce = c * e, cf = c * f, de = d * e, df = d * f;
-
-            te[ 0 ] = ce - df * b;
-            te[ 4 ] = - a * f;
-            te[ 8 ] = de + cf * b;
-
-            te[ 1 ] = cf + de * b;
-            te[ 5 ] = a * e;
-            te[ 9 ] = df - ce * b;
-
-            te[ 2 ] = - a * d;
-            te[ 6 ] = b;
-            te[ 10 ] = a * c;
-
-        } else if ( euler.order == Euler::ZYX ) {
-
-            double ae = a * e, af = a * f, be = b * e, bf = b * f;
-
-            te[ 0 ] = c * e;
-            te[ 4 ] = be * d - af;
-            te[ 8 ] = ae * d + bf;
-
-            te[ 1 ] = c * f;
-            te[ 5 ] = bf * d + ae;
-            te[ 9 ] = af * d - be;
-
-            te[ 2 ] = - d;
-            te[ 6 ] = b * c;
-            te[ 10 ] = a * c;
-
-        } else if ( euler.order == Euler::YZX ) {
-
-            double ac = a * c, ad = a * d, bc = b * c, bd = b * d;
-
-            te[ 0 ] = c * e;
-            te[ 4 ] = bd - ac * f;
-            te[ 8 ] = bc * f + ad;
-
-            te[ 1 ] = f;
-            te[ 5 ] = a * e;
-            te[ 9 ] = - b * e;
-
-            te[ 2 ] = - d * e;
-            te[ 6 ] = ad * f + bc;
-            te[ 10 ] = ac - bd * f;
-
-        } else if ( euler.order == Euler::XZY ) {
-
-            double ac = a * c, ad = a * d, bc = b * c, bd = b * d;
-
-            te[ 0 ] = c * e;
-            te[ 4 ] = - f;
-            te[ 8 ] = d * e;
-
-            te[ 1 ] = ac * f + bd;
-            te[ 5 ] = a * e;
-            te[ 9 ] = ad * f - bc;
-
-            te[ 2 ] = bc * f - ad;
-            te[ 6 ] = b * e;
-            te[ 10 ] = bd * f + ac;
 
+        switch ( euler.order ) {
+        case Euler::XYZ: Rotation::eulerToMatrix<Euler::XYZ>( x, y, z, te ); break;
+        case Euler::YZX: Rotation::eulerToMatrix<Euler::YZX>( x, y, z, te ); break;
+        case Euler::ZXY: Rotation::eulerToMatrix<Euler::ZXY>( x, y, z, te ); break;
+        case Euler::XZY: Rotation::eulerToMatrix<Euler::XZY>( x, y, z, te ); break;
+        case Euler::YXZ: Rotation::eulerToMatrix<Euler::YXZ>( x, y, z, te ); break;
+        case Euler::ZYX: Rotation::eulerToMatrix<Euler::ZYX>( x, y, z, te ); break;
         }
 
-        // last column
-        te[ 3 ] = 0;
-        te[ 7 ] = 0;
-        te[ 11 ] = 0;
-
-        // bottom row
-        te[ 12 ] = 0;
-        te[ 13 ] = 0;
-        te[ 14 ] = 0;
-        te[ 15 ] = 1;
-
         return *this;
     }
 
+    // see Rotation::quaternionsToMatrices() for arrays
     Matrix4& makeRotationFromQuaternion( const Quaternion& q )
     {
-        auto& te = this->elements;
-
-        double x = q.x, y = q.y, z = q.z, w = q.w;
-        double x2 = x + x, y2 = y + y, z2 = z + z;
-        double xx = x * x2, xy = x * y2, xz = x * z2;
-        double yy = y * y2, yz = y * z2, zz = z * z2;
-        double wx = w * x2, wy = w * y2, wz = w * z2;
-
-        te[ 0 ] = 1 - ( yy + zz );
-        te[ 4 ] = xy - wz;
-        te[ 8 ] = xz + wy;
-
-        te[ 1 ] = xy + wz;
-        te[ 5 ] = 1 - ( xx + zz );
-        te[ 9 ] = yz - wx;
-
-        te[ 2 ] = xz - wy;
-        te[ 6 ] = yz + wx;
-        te[ 10 ] = 1 - ( xx + yy );
-
-        // last column
-        te[ 3 ] = 0;
-        te[ 7 ] = 0;
-        te[ 11 ] = 0;
-
-        // bottom row
-        te[ 12 ] = 0;
-        te[ 13 ] = 0;
-        te[ 14 ] = 0;
-        te[ 15 ] = 1;
-
+        double m[ 9 ];
+        Rotation::matrixFromQuaternion( q.x, q.y, q.z, q.w, m );
+        Rotation::setRotation( m, this->elements );
         return *this;
     }
 
@@ -315,11 +184,89 @@ public:
         return this->multiplyMatrices( m, n );
     }
 
+    // Vectorized with SSE2 / AVX / NEON when available. All paths compute
+    // every coefficient as
+    //      ( ( a(i,1) * b(1,j) + a(i,2) * b(2,j) ) + a(i,3) * b(3,j) ) + a(i,4) * b(4,j)
+    // with separate multiplies and adds ( no fused multiply-add ), so the
+    // vector kernels give bit-identical results to the scalar fallback.
+    //
+    // `a` is read completely before anything is written and each column of
+    // `b` is read before the same column of `this` is written, so `this` may
+    // alias either operand ( multiply() relies on that ).
     Matrix4&  multiplyMatrices( const Matrix4& a, const Matrix4& b )
     {
-        const auto& ae = a.elements;
-        const auto& be = b.elements;
-        auto& te = this->elements;
+        const double* ae = a.elements.data();
+        const double* be = b.elements.data();
+        double* te = this->elements.data();
+
+#if defined(THREE_SIMD_AVX)
+
+        __m256d a0 = _mm256_loadu_pd( ae );
+        __m256d a1 = _mm256_loadu_pd( ae + 4 );
+        __m256d a2 = _mm256_loadu_pd( ae + 8 );
+        __m256d a3 = _mm256_loadu_pd( ae + 12 );
+
+        for ( int j = 0; j < 16; j += 4 ) {
+            __m256d r = _mm256_mul_pd( a0, _mm256_broadcast_sd( be + j ) );
+            r = _mm256_add_pd( r, _mm256_mul_pd( a1, _mm256_broadcast_sd( be + j + 1 ) ) );
+            r = _mm256_add_pd( r, _mm256_mul_pd( a2, _mm256_broadcast_sd( be + j + 2 ) ) );
+            r = _mm256_add_pd( r, _mm256_mul_pd( a3, _mm256_broadcast_sd( be + j + 3 ) ) );
+            _mm256_storeu_pd( te + j, r );
+        }
+
+#elif defined(THREE_SIMD_SSE2)
+
+        __m128d a0l = _mm_loadu_pd( ae ),      a0h = _mm_loadu_pd( ae + 2 );
+        __m128d a1l = _mm_loadu_pd( ae + 4 ),  a1h = _mm_loadu_pd( ae + 6 );
+        __m128d a2l = _mm_loadu_pd( ae + 8 ),  a2h = _mm_loadu_pd( ae + 10 );
+        __m128d a3l = _mm_loadu_pd( ae + 12 ), a3h = _mm_loadu_pd( ae + 14 );
+
+        for ( int j = 0; j < 16; j += 4 ) {
+            __m128d b0 = _mm_set1_pd( be[ j ] );
+            __m128d b1 = _mm_set1_pd( be[ j + 1 ] );
+            __m128d b2 = _mm_set1_pd( be[ j + 2 ] );
+            __m128d b3 = _mm_set1_pd( be[ j + 3 ] );
+
+            __m128d rl = _mm_mul_pd( a0l, b0 );
+            __m128d rh = _mm_mul_pd( a0h, b0 );
+            rl = _mm_add_pd( rl, _mm_mul_pd( a1l, b1 ) );
+            rh = _mm_add_pd( rh, _mm_mul_pd( a1h, b1 ) );
+            rl = _mm_add_pd( rl, _mm_mul_pd( a2l, b2 ) );
+            rh = _mm_add_pd( rh, _mm_mul_pd( a2h, b2 ) );
+            rl = _mm_add_pd( rl, _mm_mul_pd( a3l, b3 ) );
+            rh = _mm_add_pd( rh, _mm_mul_pd( a3h, b3 ) );
+
+            _mm_storeu_pd( te + j, rl );
+            _mm_storeu_pd( te + j + 2, rh );
+        }
+
+#elif defined(THREE_SIMD_NEON)
+
+        float64x2_t a0l = vld1q_f64( ae ),      a0h = vld1q_f64( ae + 2 );
+        float64x2_t a1l = vld1q_f64( ae + 4 ),  a1h = vld1q_f64( ae + 6 );
+        float64x2_t a2l = vld1q_f64( ae + 8 ),  a2h = vld1q_f64( ae + 10 );
+        float64x2_t a3l = vld1q_f64( ae + 12 ), a3h = vld1q_f64( ae + 14 );
+
+        for ( int j = 0; j < 16; j += 4 ) {
+            float64x2_t b0 = vdupq_n_f64( be[ j ] );
+            float64x2_t b1 = vdupq_n_f64( be[ j + 1 ] );
+            float64x2_t b2 = vdupq_n_f64( be[ j + 2 ] );
+            float64x2_t b3 = vdupq_n_f64( be[ j + 3 ] );
+
+            float64x2_t rl = vmulq_f64( a0l, b0 );
+            float64x2_t rh = vmulq_f64( a0h, b0 );
+            rl = vaddq_f64( rl, vmulq_f64( a1l, b1 ) );
+            rh = vaddq_f64( rh, vmulq_f64( a1h, b1 ) );
+            rl = vaddq_f64( rl, vmulq_f64( a2l, b2 ) );
+            rh = vaddq_f64( rh, vmulq_f64( a2h, b2 ) );
+            rl = vaddq_f64( rl, vmulq_f64( a3l, b3 ) );
+            rh = vaddq_f64( rh, vmulq_f64( a3h, b3 ) );
+
+            vst1q_f64( te + j, rl );
+            vst1q_f64( te + j + 2, rh );
+        }
+
+#else
 
         double a11 = ae[ 0 ], a12 = ae[ 4 ], a13 = ae[ 8 ], a14 = ae[ 12 ];
         double a21 = ae[ 1 ], a22 = ae[ 5 ], a23 = ae[ 9 ], a24 = ae[ 13 ];
@@ -351,6 +298,8 @@ public:
         te[ 11 ] = a41 * b13 + a42 * b23 + a43 * b33 + a44 * b43;
         te[ 15 ] = a41 * b14 + a42 * b24 + a43 * b34 + a44 * b44;
 
+#endif
+
         return *this;
     }
 
@@ -360,10 +309,8 @@ public:
 
         this->multiplyMatrices( a, b );
 
-        r[ 0 ] = te[ 0 ]; r[ 1 ] = te[ 1 ]; r[ 2 ] = te[ 2 ]; r[ 3 ] = te[ 3 ];
-        r[ 4 ] = te[ 4 ]; r[ 5 ] = te[ 5 ]; r[ 6 ] = te[ 6 ]; r[ 7 ] = te[ 7 ];
-        r[ 8 ]  = te[ 8 ]; r[ 9 ]  = te[ 9 ]; r[ 10 ] = te[ 10 ]; r[ 11 ] = te[ 11 ];
-        r[ 12 ] = te[ 12 ]; r[ 13 ] = te[ 13 ]; r[ 14 ] = te[ 14 ]; r[ 15 ] = te[ 15 ];
+        Q_ASSERT( r.size() >= 16 );
+        std::copy( te.begin(), te.end(), r.data() );
 
         return *this;
     }
@@ -380,47 +327,51 @@ public:
         return *this;
     }
 
-    // TODO Vector3Array or Float32Array
+    // `length` counts doubles, 0 means up to the end of the array
     Float32Array& applyToVector3Array( Float32Array & array, int offset = 0, int length = 0)
     {
-        Vector3 v1;
         if ( length == 0 )
-            length = array.size();
-        for ( int i = 0, j = offset; i < length; i += 3, j += 3 ) {
-            v1.fromArray( array, j );
-            v1.applyMatrix4( *this );
-            v1.toArray( array, j );
-        }
-
+            length = array.size() - offset;
+        Q_ASSERT( offset + length <= array.size() );
+        double* data = array.data() + offset;
+        this->applyToPoints( data, data, length / 3 );
         return array;
     }
 
-    // TODO
-    //    applyToBuffer( buffer, int offset = 0, int length = 0 ) {
-
-    //        Vector3 v1;
-    //        if ( offset == undefined ) offset = 0;
-    //        if ( length == undefined ) length = buffer.length / buffer.itemSize;
+    Vector3Array& applyToVector3Array( Vector3Array& array ) const
+    {
+        static_assert( sizeof( Vector3 ) == 3 * sizeof( double ), "Vector3 must be three packed doubles" );
+        double* data = &array.data()->x;
+        this->applyToPoints( data, data, array.size() );
+        return array;
+    }
 
-    //        for ( var i = 0, j = offset; i < length; i ++, j ++ ) {
+    // Batch versions of Vector3::applyMatrix4 / Vector3::applyProjection over
+    // raw buffers, bit-identical to the per-vector functions. The kernels are
+    // vectorized across points, `parallel` also splits large batches across
+    // the global thread pool. `dst` may alias the source.
 
-    //            v1.x = buffer.getX( j );
-    //            v1.y = buffer.getY( j );
-    //            v1.z = buffer.getZ( j );
+    // interleaved: point i is src[ i * stride ], src[ i * stride + 1 ], src[ i * stride + 2 ]
+    void applyToPoints( const double* src, double* dst, int count, int stride = 3, bool parallel = false ) const;
 
-    //            v1.applyMatrix4( this );
+    void applyProjectionToPoints( const double* src, double* dst, int count, int stride = 3, bool parallel = false ) const;
 
-    //            buffer.setXYZ( v1.x, v1.y, v1.z );
+    // one array per component
+    void applyToPointsSoA( const double* xs, const double* ys, const double* zs,
+                           double* xd, double* yd, double* zd, int count, bool parallel = false ) const;
 
-    //        }
+    void applyProjectionToPointsSoA( const double* xs, const double* ys, const double* zs,
+                                     double* xd, double* yd, double* zd, int count, bool parallel = false ) const;
 
-    //        return buffer;
-    //    }
+    // transforms items [ offset, offset + length ) of a 3 component attribute
+    // in place and marks them dirty, length 0 means up to the end. Float32
+    // attributes go through Matrix4f, in single precision.
+    BufferAttribute& applyToBuffer( BufferAttribute& buffer, int offset = 0, int length = 0 ) const;
 
     double determinant()
     {
 
-        Float32Array& te = this->elements;
+        auto& te = this->elements;
 
         double n11 = te[ 0 ], n12 = te[ 4 ], n13 = te[ 8 ], n14 = te[ 12 ];
         double n21 = te[ 1 ], n22 = te[ 5 ], n23 = te[ 9 ], n24 = te[ 13 ];
@@ -794,19 +745,31 @@ public:
         return true;
     }
 
-    Matrix4& fromArray(const Float32Array& array )
+    Matrix4& fromArray(const Float32Array& array, int offset = 0 )
     {
-        Q_ASSERT(array.size() >= 16);
-        this->elements = array ;
+        Q_ASSERT(array.size() >= offset + 16);
+        auto& te = this->elements;
+        for ( int i = 0; i < 16; i ++ ) {
+            te[ i ] = array[ offset + i ];
+        }
         return *this;
     }
 
-    Float32Array toArray() {
-        return this->elements;
+    Float32Array toArray() const
+    {
+        Float32Array array( 16 );
+        const auto& te = this->elements;
+        for ( int i = 0; i < 16; i ++ ) {
+            array[ i ] = te[ i ];
+        }
+        return array;
     }
 
     // private:
-    Float32Array elements;
+    // inline and trivially copyable: constructing, copying or cloning a
+    // Matrix4 never touches the allocator. Use fromArray() / toArray() /
+    // flattenToArrayOffset() to convert from / to Float32Array.
+    alignas(16) Matrix4Elements elements;
 };
 
 } // namespace three
@@ -0,0 +1,154 @@
+#include "matrix4f.h"
+
+#include <algorithm>
+
+#include "vector3f.h"
+#include "simd.hpp"
+#include "parallel.hpp"
+
+namespace three {
+
+namespace {
+
+const int PointsPerTask = 1 << 16;
+const int PointsPerTile = 64;
+
+// the float twins of the kernels in matrix4.cpp, same evaluation order
+template<bool Projective>
+void transformPoints( const Matrix4fElements& e,
+                      const float* xs, const float* ys, const float* zs,
+                      float* xd, float* yd, float* zd, int begin, int end )
+{
+    using namespace Simd;
+
+    VFloat e0 = set1f( e[ 0 ] ), e4 = set1f( e[ 4 ] ), e8 = set1f( e[ 8 ] ), e12 = set1f( e[ 12 ] );
+    VFloat e1 = set1f( e[ 1 ] ), e5 = set1f( e[ 5 ] ), e9 = set1f( e[ 9 ] ), e13 = set1f( e[ 13 ] );
+    VFloat e2 = set1f( e[ 2 ] ), e6 = set1f( e[ 6 ] ), e10 = set1f( e[ 10 ] ), e14 = set1f( e[ 14 ] );
+    VFloat e3 = set1f( e[ 3 ] ), e7 = set1f( e[ 7 ] ), e11 = set1f( e[ 11 ] ), e15 = set1f( e[ 15 ] );
+    VFloat one = set1f( 1 );
+
+    int i = begin;
+    for ( ; i + FloatLanes <= end; i += FloatLanes ) {
+        VFloat x = load( xs + i ), y = load( ys + i ), z = load( zs + i );
+
+        VFloat rx = add( add( add( mul( e0, x ), mul( e4, y ) ), mul( e8, z ) ), e12 );
+        VFloat ry = add( add( add( mul( e1, x ), mul( e5, y ) ), mul( e9, z ) ), e13 );
+        VFloat rz = add( add( add( mul( e2, x ), mul( e6, y ) ), mul( e10, z ) ), e14 );
+
+        if ( Projective ) {
+            VFloat d = div( one, add( add( add( mul( e3, x ), mul( e7, y ) ), mul( e11, z ) ), e15 ) );
+            rx = mul( rx, d );
+            ry = mul( ry, d );
+            rz = mul( rz, d );
+        }
+
+        store( xd + i, rx );
+        store( yd + i, ry );
+        store( zd + i, rz );
+    }
+
+    for ( ; i < end; i ++ ) {
+        float x = xs[ i ], y = ys[ i ], z = zs[ i ];
+
+        float rx = e[ 0 ] * x + e[ 4 ] * y + e[ 8 ]  * z + e[ 12 ];
+        float ry = e[ 1 ] * x + e[ 5 ] * y + e[ 9 ]  * z + e[ 13 ];
+        float rz = e[ 2 ] * x + e[ 6 ] * y + e[ 10 ] * z + e[ 14 ];
+
+        if ( Projective ) {
+            float d = 1 / ( e[ 3 ] * x + e[ 7 ] * y + e[ 11 ] * z + e[ 15 ] );
+            rx *= d;
+            ry *= d;
+            rz *= d;
+        }
+
+        xd[ i ] = rx;
+        yd[ i ] = ry;
+        zd[ i ] = rz;
+    }
+}
+
+template<bool Projective>
+void transformInterleavedPoints( const Matrix4fElements& e, const float* src, float* dst,
+                                 int stride, int begin, int end )
+{
+    float x[ PointsPerTile ], y[ PointsPerTile ], z[ PointsPerTile ];
+
+    for ( int first = begin; first < end; first += PointsPerTile ) {
+        int n = std::min( PointsPerTile, end - first );
+
+        const float* s = src + qptrdiff( first ) * stride;
+        for ( int i = 0; i < n; i ++, s += stride ) {
+            x[ i ] = s[ 0 ];
+            y[ i ] = s[ 1 ];
+            z[ i ] = s[ 2 ];
+        }
+
+        transformPoints<Projective>( e, x, y, z, x, y, z, 0, n );
+
+        float* d = dst + qptrdiff( first ) * stride;
+        for ( int i = 0; i < n; i ++, d += stride ) {
+            d[ 0 ] = x[ i ];
+            d[ 1 ] = y[ i ];
+            d[ 2 ] = z[ i ];
+        }
+    }
+}
+
+template<typename Body>
+void run( int count, bool parallel, Body body )
+{
+    if ( parallel ) {
+        Parallel::forRange( count, PointsPerTask, body );
+    } else {
+        body( 0, count );
+    }
+}
+
+} // namespace
+
+void Matrix4f::applyToPoints(const float *src, float *dst, int count, int stride, bool parallel) const
+{
+    Q_ASSERT( stride >= 3 );
+    const auto& e = this->elements;
+    run( count, parallel, [&]( int begin, int end ) {
+        transformInterleavedPoints<false>( e, src, dst, stride, begin, end );
+    } );
+}
+
+void Matrix4f::applyProjectionToPoints(const float *src, float *dst, int count, int stride, bool parallel) const
+{
+    Q_ASSERT( stride >= 3 );
+    const auto& e = this->elements;
+    run( count, parallel, [&]( int begin, int end ) {
+        transformInterleavedPoints<true>( e, src, dst, stride, begin, end );
+    } );
+}
+
+void Matrix4f::applyToPointsSoA(const float *xs, const float *ys, const float *zs,
+                                float *xd, float *yd, float *zd, int count, bool parallel) const
+{
+    const auto& e = this->elements;
+    run( count, parallel, [&]( int begin, int end ) {
+        transformPoints<false>( e, xs, ys, zs, xd, yd, zd, begin, end );
+    } );
+}
+
+void Matrix4f::applyProjectionToPointsSoA(const float *xs, const float *ys, const float *zs,
+                                          float *xd, float *yd, float *zd, int count, bool parallel) const
+{
+    const auto& e = this->elements;
+    run( count, parallel, [&]( int begin, int end ) {
+        transformPoints<true>( e, xs, ys, zs, xd, yd, zd, begin, end );
+    } );
+}
+
+Vector3fArray &Matrix4f::applyToVector3Array(Vector3fArray &array, bool parallel) const
+{
+    if ( !array.isEmpty() ) {
+        float* data = &array.data()->x;
+        this->applyToPoints( data, data, array.size(), 3, parallel );
+    }
+    return array;
+}
+
+} // namespace three
@@ -0,0 +1,75 @@
+#ifndef THREE_MATRIX4F_H
+#define THREE_MATRIX4F_H
+
+#include "math_forword_declar.h"
+
+#include "matrix4.h"
+
+namespace three {
+
+class Matrix4;
+
+// Single precision copy of a Matrix4 for the bulk point kernels. Build and
+// compose transforms in double with Matrix4, convert once per batch and run
+// the batch here: the registers hold Simd::FloatLanes points, twice the
+// doubles, and the data takes half the memory traffic.
+class Matrix4f
+{
+public:
+    Matrix4f():
+        elements ( {{
+                   1, 0, 0, 0,
+                   0, 1, 0, 0,
+                   0, 0, 1, 0,
+                   0, 0, 0, 1 }} )
+    {
+    }
+
+    explicit Matrix4f( const Matrix4& m )
+    {
+        for ( int i = 0; i < 16; i ++ ) {
+            this->elements[ i ] = float( m.elements[ i ] );
+        }
+    }
+
+    Matrix4 toMatrix4() const
+    {
+        Matrix4 m;
+        for ( int i = 0; i < 16; i ++ ) {
+            m.elements[ i ] = this->elements[ i ];
+        }
+        return m;
+    }
+
+    Matrix4f& copy( const Matrix4& m )
+    {
+        *this = Matrix4f( m );
+        return *this;
+    }
+
+    // Float versions of Matrix4::applyToPoints and friends, the same
+    // evaluation order in float arithmetic, so they match
+    // Vector3f::applyMatrix4 bit for bit ( not the double results ).
+    // `dst` may alias the source.
+
+    // interleaved: point i is src[ i * stride ], src[ i * stride + 1 ], src[ i * stride + 2 ]
+    void applyToPoints( const float* src, float* dst, int count, int stride = 3, bool parallel = false ) const;
+
+    void applyProjectionToPoints( const float* src, float* dst, int count, int stride = 3, bool parallel = false ) const;
+
+    // one array per component
+    void applyToPointsSoA( const float* xs, const float* ys, const float* zs,
+                           float* xd, float* yd, float* zd, int count, bool parallel = false ) const;
+
+    void applyProjectionToPointsSoA( const float* xs, const float* ys, const float* zs,
+                                     float* xd, float* yd, float* zd, int count, bool parallel = false ) const;
+
+    Vector3fArray& applyToVector3Array( Vector3fArray& array, bool parallel = false ) const;
+
+    // private:
+    alignas(16) Matrix4fElements elements;
+};
+
+} // namespace three
+
+#endif // THREE_MATRIX4F_H
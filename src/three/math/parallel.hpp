@@ -0,0 +1,49 @@
+#ifndef THREE_PARALLEL_HPP
+#define THREE_PARALLEL_HPP
+
+#include <QPair>
+#include <QThread>
+#include <QVector>
+#include <QtConcurrent>
+
+namespace three {
+namespace Parallel {
+
+typedef QPair<int, int> Range;   // [ first, second )
+
+// Splits [ 0, count ) into ranges of at least `grain` items and calls
+// body( begin, end ) for each of them on QThreadPool::globalInstance().
+// Small inputs run inline on the calling thread. The ranges are disjoint,
+// so body may write to per-item output without synchronisation.
+template<typename Body>
+inline void forRange( int count, int grain, Body body )
+{
+    if ( count <= 0 )
+        return;
+
+    grain = std::max( grain, 1 );
+
+    // a few chunks per thread, so a slow chunk does not stall the others
+    int threads = std::max( QThread::idealThreadCount(), 1 );
+    int chunks = std::min( ( count + grain - 1 ) / grain, threads * 4 );
+
+    if ( chunks <= 1 ) {
+        body( 0, count );
+        return;
+    }
+
+    QVector<Range> ranges;
+    ranges.reserve( chunks );
+    for ( int i = 0; i < chunks; i ++ ) {
+        ranges.append( Range( int( qint64( count ) * i / chunks ), int( qint64( count ) * ( i + 1 ) / chunks ) ) );
+    }
+
+    QtConcurrent::blockingMap( ranges, [&body]( const Range& range ) {
+        body( range.first, range.second );
+    } );
+}
+
+} // namespace Parallel
+} // namespace three
+
+#endif // THREE_PARALLEL_HPP
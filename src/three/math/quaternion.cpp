@@ -3,55 +3,208 @@
 #include "euler.h"
 #include "vector3.h"
 #include "matrix4.h"
+#include "rotation.h"
+#include "simd.hpp"
+#include "parallel.hpp"
 
 namespace three {
 
-Quaternion &Quaternion::setFromEuler(const Euler &euler, bool update)
+namespace {
+
+const int QuaternionsPerTask = 1 << 13;
+const int QuaternionsPerTile = 64;
+
+enum Blend {
+    Slerp,
+    FastSlerp,
+    Nlerp
+};
+
+// three.js slerpFlat, q0 = x0, y0, z0, w0 is replaced by the result
+inline void slerpInPlace( double& x0, double& y0, double& z0, double& w0,
+                          const double& x1, const double& y1, const double& z1, const double& w1, double t )
+{
+    if ( w0 != w1 || x0 != x1 || y0 != y1 || z0 != z1 ) {
+
+        double s = 1 - t,
+                cos = x0 * x1 + y0 * y1 + z0 * z1 + w0 * w1,
+                dir = ( cos >= 0 ? 1 : - 1 ),
+                sqrSin = 1 - cos * cos;
+
+        // Skip the Slerp for tiny steps to avoid numeric problems:
+        if ( sqrSin > std::numeric_limits<double>::epsilon() ) {
+            double sin = std::sqrt( sqrSin ),
+                    len = std::atan2( sin, cos * dir );
+
+            s = std::sin( s * len ) / sin;
+            t = std::sin( t * len ) / sin;
+        }
+
+        double tDir = t * dir;
+
+        x0 = x0 * s + x1 * tDir;
+        y0 = y0 * s + y1 * tDir;
+        z0 = z0 * s + z1 * tDir;
+        w0 = w0 * s + w1 * tDir;
+
+        // Normalize in case we just did a lerp:
+        if ( s == 1 - t ) {
+            double f = 1 / std::sqrt( x0 * x0 + y0 * y0 + z0 * z0 + w0 * w0 );
+
+            x0 *= f;
+            y0 *= f;
+            z0 *= f;
+            w0 *= f;
+        }
+    }
+}
+
+// Normalized lerp on the shorter arc, for FastSlerp with t moved along the
+// arc by the fitted correction of
+// https://zeux.io/2015/07/23/approximating-slerp/
+template<Blend B>
+void lerpTile( double ( *a )[ QuaternionsPerTile ], double ( *b )[ QuaternionsPerTile ], const double* ts, int n )
+{
+    using namespace Simd;
+
+    const VDouble zero = set1( 0.0 ), one = set1( 1.0 ), minusOne = set1( -1.0 ), half = set1( 0.5 );
+
+    int i = 0;
+    for ( ; i + DoubleLanes <= n; i += DoubleLanes ) {
+        VDouble x0 = load( a[ 0 ] + i ), y0 = load( a[ 1 ] + i ), z0 = load( a[ 2 ] + i ), w0 = load( a[ 3 ] + i );
+        VDouble x1 = load( b[ 0 ] + i ), y1 = load( b[ 1 ] + i ), z1 = load( b[ 2 ] + i ), w1 = load( b[ 3 ] + i );
+        VDouble t = load( ts + i );
+
+        VDouble cos = add( add( add( mul( x0, x1 ), mul( y0, y1 ) ), mul( z0, z1 ) ), mul( w0, w1 ) );
+        VDouble dir = select( cmplt( cos, zero ), one, minusOne );
+
+        if ( B == FastSlerp ) {
+            VDouble d = mul( cos, dir );
+            VDouble ka = add( set1( 1.0904 ), mul( d, add( set1( -3.2452 ), mul( d, sub( set1( 3.55645 ), mul( d, set1( 1.43519 ) ) ) ) ) ) );
+            VDouble kb = add( set1( 0.848013 ), mul( d, add( set1( -1.06021 ), mul( d, set1( 0.215638 ) ) ) ) );
+            VDouble c = sub( t, half );
+            VDouble k = add( mul( mul( ka, c ), c ), kb );
+            t = add( t, mul( mul( mul( t, c ), sub( t, one ) ), k ) );
+        }
+
+        VDouble s = sub( one, t ), tDir = mul( t, dir );
+
+        VDouble x = add( mul( x0, s ), mul( x1, tDir ) );
+        VDouble y = add( mul( y0, s ), mul( y1, tDir ) );
+        VDouble z = add( mul( z0, s ), mul( z1, tDir ) );
+        VDouble w = add( mul( w0, s ), mul( w1, tDir ) );
+
+        VDouble f = div( one, sqrt( add( add( add( mul( x, x ), mul( y, y ) ), mul( z, z ) ), mul( w, w ) ) ) );
+
+        store( a[ 0 ] + i, mul( x, f ) );
+        store( a[ 1 ] + i, mul( y, f ) );
+        store( a[ 2 ] + i, mul( z, f ) );
+        store( a[ 3 ] + i, mul( w, f ) );
+    }
+
+    for ( ; i < n; i ++ ) {
+        double x0 = a[ 0 ][ i ], y0 = a[ 1 ][ i ], z0 = a[ 2 ][ i ], w0 = a[ 3 ][ i ];
+        double x1 = b[ 0 ][ i ], y1 = b[ 1 ][ i ], z1 = b[ 2 ][ i ], w1 = b[ 3 ][ i ];
+        double t = ts[ i ];
+
+        double cos = x0 * x1 + y0 * y1 + z0 * z1 + w0 * w1;
+        double dir = cos < 0 ? -1 : 1;
+
+        if ( B == FastSlerp ) {
+            double d = cos * dir;
+            double ka = 1.0904 + d * ( -3.2452 + d * ( 3.55645 - d * 1.43519 ) );
+            double kb = 0.848013 + d * ( -1.06021 + d * 0.215638 );
+            double c = t - 0.5;
+            double k = ka * c * c + kb;
+            t = t + t * c * ( t - 1 ) * k;
+        }
+
+        double s = 1 - t, tDir = t * dir;
+
+        double x = x0 * s + x1 * tDir;
+        double y = y0 * s + y1 * tDir;
+        double z = z0 * s + z1 * tDir;
+        double w = w0 * s + w1 * tDir;
+
+        double f = 1 / std::sqrt( x * x + y * y + z * z + w * w );
+
+        a[ 0 ][ i ] = x * f;
+        a[ 1 ][ i ] = y * f;
+        a[ 2 ][ i ] = z * f;
+        a[ 3 ][ i ] = w * f;
+    }
+}
+
+// t of quaternion i at t[ i * tStride ], tStride 0 for one t for all
+template<Blend B>
+void blend( double* dst, const double* src0, const double* src1, int count, const double* t, int tStride,
+            bool parallel )
 {
-    // http://www.mathworks.com/matlabcentral/fileexchange/
-    // 	20696-function-to-convert-between-dcm-euler-angles-quaternions-and-euler-vectors/
-    //	content/SpinCalc.m
+    auto body = [=]( int begin, int end ) {
+        if ( B == Slerp ) {
+            for ( int i = begin; i < end; i ++ ) {
+                const double* q0 = src0 + qptrdiff( i ) * 4;
+                const double* q1 = src1 + qptrdiff( i ) * 4;
+                double x = q0[ 0 ], y = q0[ 1 ], z = q0[ 2 ], w = q0[ 3 ];
+                slerpInPlace( x, y, z, w, q1[ 0 ], q1[ 1 ], q1[ 2 ], q1[ 3 ], t[ qptrdiff( i ) * tStride ] );
+                double* q = dst + qptrdiff( i ) * 4;
+                q[ 0 ] = x;
+                q[ 1 ] = y;
+                q[ 2 ] = z;
+                q[ 3 ] = w;
+            }
+            return;
+        }
+
+        // gathered into x / y / z / w tiles for the vector kernel
+        double a[ 4 ][ QuaternionsPerTile ], b[ 4 ][ QuaternionsPerTile ], ts[ QuaternionsPerTile ];
+
+        for ( int first = begin; first < end; first += QuaternionsPerTile ) {
+            int n = std::min( QuaternionsPerTile, end - first );
 
+            const double* q0 = src0 + qptrdiff( first ) * 4;
+            const double* q1 = src1 + qptrdiff( first ) * 4;
+            for ( int i = 0; i < n; i ++, q0 += 4, q1 += 4 ) {
+                for ( int c = 0; c < 4; c ++ ) {
+                    a[ c ][ i ] = q0[ c ];
+                    b[ c ][ i ] = q1[ c ];
+                }
+                ts[ i ] = t[ qptrdiff( first + i ) * tStride ];
+            }
+
+            lerpTile<B>( a, b, ts, n );
+
+            double* q = dst + qptrdiff( first ) * 4;
+            for ( int i = 0; i < n; i ++, q += 4 ) {
+                for ( int c = 0; c < 4; c ++ ) {
+                    q[ c ] = a[ c ][ i ];
+                }
+            }
+        }
+    };
+
+    if ( parallel ) {
+        Parallel::forRange( count, QuaternionsPerTask, body );
+    } else {
+        body( 0, count );
+    }
+}
+
+} // namespace
+
+Quaternion &Quaternion::setFromEuler(const Euler &euler, bool update)
+{
     Q_UNUSED(update);
 
-    double c1 = std::cos( euler.x / 2 );
-    double c2 = std::cos( euler.y / 2 );
-    double c3 = std::cos( euler.z / 2 );
-    double s1 = std::sin( euler.x / 2 );
-    double s2 = std::sin( euler.y / 2 );
-    double s3 = std::sin( euler.z / 2 );
-    Euler::RotationOrders order = euler.order;
-
-    if ( order == Euler::XYZ ) {
-        this->x = s1 * c2 * c3 + c1 * s2 * s3;
-        this->y = c1 * s2 * c3 - s1 * c2 * s3;
-        this->z = c1 * c2 * s3 + s1 * s2 * c3;
-        this->w = c1 * c2 * c3 - s1 * s2 * s3;
-    } else if ( order == Euler::YXZ ) {
-        this->x = s1 * c2 * c3 + c1 * s2 * s3;
-        this->y = c1 * s2 * c3 - s1 * c2 * s3;
-        this->z = c1 * c2 * s3 - s1 * s2 * c3;
-        this->w = c1 * c2 * c3 + s1 * s2 * s3;
-    } else if ( order == Euler::ZXY ) {
-        this->x = s1 * c2 * c3 - c1 * s2 * s3;
-        this->y = c1 * s2 * c3 + s1 * c2 * s3;
-        this->z = c1 * c2 * s3 + s1 * s2 * c3;
-        this->w = c1 * c2 * c3 - s1 * s2 * s3;
-    } else if ( order == Euler::ZYX ) {
-        this->x = s1 * c2 * c3 - c1 * s2 * s3;
-        this->y = c1 * s2 * c3 + s1 * c2 * s3;
-        this->z = c1 * c2 * s3 - s1 * s2 * c3;
-        this->w = c1 * c2 * c3 + s1 * s2 * s3;
-    } else if ( order == Euler::YZX ) {
-        this->x = s1 * c2 * c3 + c1 * s2 * s3;
-        this->y = c1 * s2 * c3 + s1 * c2 * s3;
-        this->z = c1 * c2 * s3 - s1 * s2 * c3;
-        this->w = c1 * c2 * c3 - s1 * s2 * s3;
-    } else if ( order == Euler::XZY ) {
-        this->x = s1 * c2 * c3 - c1 * s2 * s3;
-        this->y = c1 * s2 * c3 - s1 * c2 * s3;
-        this->z = c1 * c2 * s3 + s1 * s2 * c3;
-        this->w = c1 * c2 * c3 + s1 * s2 * s3;
+    double x = euler.x, y = euler.y, z = euler.z;
+
+    switch ( euler.order ) {
+    case Euler::XYZ: Rotation::eulerToQuaternion<Euler::XYZ>( x, y, z, *this ); break;
+    case Euler::YZX: Rotation::eulerToQuaternion<Euler::YZX>( x, y, z, *this ); break;
+    case Euler::ZXY: Rotation::eulerToQuaternion<Euler::ZXY>( x, y, z, *this ); break;
+    case Euler::XZY: Rotation::eulerToQuaternion<Euler::XZY>( x, y, z, *this ); break;
+    case Euler::YXZ: Rotation::eulerToQuaternion<Euler::YXZ>( x, y, z, *this ); break;
+    case Euler::ZYX: Rotation::eulerToQuaternion<Euler::ZYX>( x, y, z, *this ); break;
     }
     //    if ( update != false )
     return *this;
@@ -135,8 +288,57 @@ Quaternion &Quaternion::setFromUnitVectors(const Vector3 &vFrom, const Vector3 &
     this->normalize();
     return *this;
 }
+void Quaternion::slerpFlat(double *dst, const int &dstOffset, const double *src0, const int &srcOffset0,
+                           const double *src1, const int &srcOffset1, const double &t)
+{
+    const double* q0 = src0 + srcOffset0;
+    const double* q1 = src1 + srcOffset1;
+    double x = q0[ 0 ], y = q0[ 1 ], z = q0[ 2 ], w = q0[ 3 ];
 
+    slerpInPlace( x, y, z, w, q1[ 0 ], q1[ 1 ], q1[ 2 ], q1[ 3 ], t );
 
+    double* q = dst + dstOffset;
+    q[ 0 ] = x;
+    q[ 1 ] = y;
+    q[ 2 ] = z;
+    q[ 3 ] = w;
+}
+
+void Quaternion::slerpFlat(double *dst, const double *src0, const double *src1, const int &count, const double &t,
+                           const bool &parallel)
+{
+    blend<Slerp>( dst, src0, src1, count, &t, 0, parallel );
+}
+
+void Quaternion::slerpFlat(double *dst, const double *src0, const double *src1, const int &count, const double *t,
+                           const bool &parallel)
+{
+    blend<Slerp>( dst, src0, src1, count, t, 1, parallel );
+}
+
+void Quaternion::fastSlerpFlat(double *dst, const double *src0, const double *src1, const int &count,
+                               const double &t, const bool &parallel)
+{
+    blend<FastSlerp>( dst, src0, src1, count, &t, 0, parallel );
+}
+
+void Quaternion::fastSlerpFlat(double *dst, const double *src0, const double *src1, const int &count,
+                               const double *t, const bool &parallel)
+{
+    blend<FastSlerp>( dst, src0, src1, count, t, 1, parallel );
+}
+
+void Quaternion::nlerpFlat(double *dst, const double *src0, const double *src1, const int &count, const double &t,
+                           const bool &parallel)
+{
+    blend<Nlerp>( dst, src0, src1, count, &t, 0, parallel );
+}
+
+void Quaternion::nlerpFlat(double *dst, const double *src0, const double *src1, const int &count, const double *t,
+                           const bool &parallel)
+{
+    blend<Nlerp>( dst, src0, src1, count, t, 1, parallel );
+}
 
 } // namespace three
 
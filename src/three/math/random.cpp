@@ -0,0 +1,151 @@
+#include "random.h"
+
+#include <atomic>
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+#include "vector3.h"
+#include "parallel.hpp"
+
+namespace three {
+
+namespace {
+
+// Calls body( generator, begin, end ) for every block of [ 0, count ) with
+// the generator of that block, see Random.
+template<typename Body>
+void forBlocks( Random& random, int count, bool parallel, Body body )
+{
+    if ( count <= 0 )
+        return;
+
+    const quint64 key = random.next();
+    const int blocks = ( count + Random::BlockSize - 1 ) / Random::BlockSize;
+
+    auto run = [&]( int first, int last ) {
+        for ( int block = first; block < last; block ++ ) {
+            Random generator( key, quint64( block ) );
+            int begin = block * Random::BlockSize;
+            body( generator, begin, std::min( begin + Random::BlockSize, count ) );
+        }
+    };
+
+    if ( parallel ) {
+        Parallel::forRange( blocks, 1, run );
+    } else {
+        run( 0, blocks );
+    }
+}
+
+std::atomic<quint64> localStreams( 0 );
+
+} // namespace
+
+Vector3 &Random::inSphere(Vector3 &target, const double &radius)
+{
+    double x, y, z;
+    do {
+        x = this->nextDouble() * 2 - 1;
+        y = this->nextDouble() * 2 - 1;
+        z = this->nextDouble() * 2 - 1;
+    } while ( x * x + y * y + z * z > 1 );
+
+    return target.set( x * radius, y * radius, z * radius );
+}
+
+Vector3 &Random::onSphere(Vector3 &target, const double &radius)
+{
+    double z = this->nextDouble() * 2 - 1;
+    double phi = this->nextDouble() * ( 2 * M_PI );
+    double r = std::sqrt( std::max( 0.0, 1 - z * z ) ) * radius;
+
+    return target.set( r * std::cos( phi ), r * std::sin( phi ), z * radius );
+}
+
+void Random::fill(double *values, const int &count, const double &low, const double &high, const bool &parallel)
+{
+    // low + u * range can round up to high, the last value below it instead
+    const double range = high - low;
+    const double last = low < high ? std::nextafter( high, low ) : low;
+    forBlocks( *this, count, parallel, [=]( Random& generator, int begin, int end ) {
+        for ( int i = begin; i < end; i ++ ) {
+            values[ i ] = std::min( low + Random::toDouble( generator.next() ) * range, last );
+        }
+    } );
+}
+
+void Random::fill(float *values, const int &count, const float &low, const float &high, const bool &parallel)
+{
+    // computed in double and rounded once, which may still round to high
+    const double range = double( high ) - low;
+    const float last = low < high ? std::nextafter( high, low ) : low;
+    forBlocks( *this, count, parallel, [=]( Random& generator, int begin, int end ) {
+        for ( int i = begin; i < end; i ++ ) {
+            values[ i ] = std::min( float( low + Random::toDouble( generator.next() ) * range ), last );
+        }
+    } );
+}
+
+void Random::fillInSphere(double *points, const int &count, const double &radius, const int &stride,
+                          const bool &parallel)
+{
+    Q_ASSERT( stride >= 3 );
+    forBlocks( *this, count, parallel, [=]( Random& generator, int begin, int end ) {
+        Vector3 v;
+        for ( int i = begin; i < end; i ++ ) {
+            generator.inSphere( v, radius );
+            double* p = points + qptrdiff( i ) * stride;
+            p[ 0 ] = v.x;
+            p[ 1 ] = v.y;
+            p[ 2 ] = v.z;
+        }
+    } );
+}
+
+void Random::fillOnSphere(double *points, const int &count, const double &radius, const int &stride,
+                          const bool &parallel)
+{
+    Q_ASSERT( stride >= 3 );
+    forBlocks( *this, count, parallel, [=]( Random& generator, int begin, int end ) {
+        Vector3 v;
+        for ( int i = begin; i < end; i ++ ) {
+            generator.onSphere( v, radius );
+            double* p = points + qptrdiff( i ) * stride;
+            p[ 0 ] = v.x;
+            p[ 1 ] = v.y;
+            p[ 2 ] = v.z;
+        }
+    } );
+}
+
+void Random::stratified(double *values, const int &count, const bool &parallel)
+{
+    const double step = 1.0 / count;
+    forBlocks( *this, count, parallel, [=]( Random& generator, int begin, int end ) {
+        for ( int i = begin; i < end; i ++ ) {
+            values[ i ] = std::min( ( i + Random::toDouble( generator.next() ) ) * step, 1 - DBL_EPSILON / 2 );
+        }
+    } );
+}
+
+void Random::stratified(double *points, const int &nx, const int &ny, const bool &parallel)
+{
+    const double stepX = 1.0 / nx, stepY = 1.0 / ny;
+    forBlocks( *this, nx * ny, parallel, [=]( Random& generator, int begin, int end ) {
+        for ( int i = begin; i < end; i ++ ) {
+            int x = i % nx, y = i / nx;
+            double* p = points + qptrdiff( i ) * 2;
+            p[ 0 ] = std::min( ( x + Random::toDouble( generator.next() ) ) * stepX, 1 - DBL_EPSILON / 2 );
+            p[ 1 ] = std::min( ( y + Random::toDouble( generator.next() ) ) * stepY, 1 - DBL_EPSILON / 2 );
+        }
+    } );
+}
+
+Random &Random::local()
+{
+    static thread_local Random random( 0, localStreams ++ );
+    return random;
+}
+
+} // namespace three
@@ -0,0 +1,168 @@
+#ifndef THREE_RANDOM_H
+#define THREE_RANDOM_H
+
+#include <QtGlobal>
+
+namespace three {
+
+class Vector3;
+
+// xoshiro256** ( Blackman / Vigna, http://prng.di.unimi.it ): 256 bits of
+// state, a handful of shifts and adds per 64 random bits, no locks.
+//
+// A generator is seeded with a seed and a stream number, different streams
+// of one seed are independent sequences. Use one generator per thread:
+// Random::local() is the calling thread's own, Math::random() draws from it.
+//
+// The bulk functions split their output into fixed blocks of BlockSize
+// values, block k drawn from stream k of a key taken from this generator.
+// The result depends only on the generator's state, not on `parallel` or
+// on how the blocks end up spread over the threads, and the generator
+// advances by one draw per call.
+class Random
+{
+public:
+    static const int BlockSize = 4096;
+
+    explicit Random( const quint64& seed = 0, const quint64& stream = 0 )
+    {
+        this->seed( seed, stream );
+    }
+
+    Random& seed( const quint64& seed, const quint64& stream = 0 )
+    {
+        // splitmix64 from a mix of both, as recommended for seeding xoshiro
+        quint64 state = seed ^ Random::mix( stream + Q_UINT64_C( 0x632be59bd9b4e019 ) );
+        for ( int i = 0; i < 4; i ++ ) {
+            this->state[ i ] = Random::splitmix( state );
+        }
+        return *this;
+    }
+
+    // 64 random bits
+    quint64 next()
+    {
+        quint64* s = this->state;
+        const quint64 result = Random::rotl( s[ 1 ] * 5, 7 ) * 9;
+        const quint64 t = s[ 1 ] << 17;
+
+        s[ 2 ] ^= s[ 0 ];
+        s[ 3 ] ^= s[ 1 ];
+        s[ 1 ] ^= s[ 2 ];
+        s[ 0 ] ^= s[ 3 ];
+        s[ 2 ] ^= t;
+        s[ 3 ] = Random::rotl( s[ 3 ], 45 );
+
+        return result;
+    }
+
+    // [ 0, 1 ), 53 random bits
+    double nextDouble()
+    {
+        return Random::toDouble( this->next() );
+    }
+
+    // [ low, high )
+    double nextDouble( const double& low, const double& high )
+    {
+        return low + this->nextDouble() * ( high - low );
+    }
+
+    // [ 0, 1 ), 24 random bits
+    float nextFloat()
+    {
+        return Random::toFloat( this->next() );
+    }
+
+    // [ 0, bound ), unbiased ( Lemire's multiply and reject )
+    quint32 nextUInt( const quint32& bound )
+    {
+        Q_ASSERT( bound > 0 );
+        quint64 m = ( this->next() >> 32 ) * bound;
+        if ( quint32( m ) < bound ) {
+            const quint32 threshold = quint32( - bound ) % bound;
+            while ( quint32( m ) < threshold ) {
+                m = ( this->next() >> 32 ) * bound;
+            }
+        }
+        return quint32( m >> 32 );
+    }
+
+    // [ low, high ], both included
+    int nextInt( const int& low, const int& high )
+    {
+        Q_ASSERT( low <= high );
+        return int( qint64( low ) + this->nextUInt( quint32( qint64( high ) - low + 1 ) ) );
+    }
+
+    // uniform in / on the sphere of radius around the origin
+    Vector3& inSphere( Vector3& target, const double& radius = 1 );
+
+    Vector3& onSphere( Vector3& target, const double& radius = 1 );
+
+    // Bulk versions, see above. count values / points of 3 doubles; the
+    // points are stride doubles apart ( a Vector3Array is stride 3 ).
+    void fill( double* values, const int& count, const double& low = 0, const double& high = 1,
+               const bool& parallel = false );
+
+    void fill( float* values, const int& count, const float& low = 0, const float& high = 1,
+               const bool& parallel = false );
+
+    void fillInSphere( double* points, const int& count, const double& radius = 1, const int& stride = 3,
+                       const bool& parallel = false );
+
+    void fillOnSphere( double* points, const int& count, const double& radius = 1, const int& stride = 3,
+                       const bool& parallel = false );
+
+    // Stratified samples of [ 0, 1 ): one jittered value per 1 / count
+    // interval, in order.
+    void stratified( double* values, const int& count, const bool& parallel = false );
+
+    // Jittered grid over [ 0, 1 )^2: nx * ny points of x, y, row by row.
+    void stratified( double* points, const int& nx, const int& ny, const bool& parallel = false );
+
+    // The calling thread's generator. The n-th thread to ask gets stream n
+    // of seed 0, or reseed it with local().seed( ... ).
+    //
+    // Which thread is the n-th depends on scheduling, so the values a pool
+    // thread draws from local() differ from run to run. Where results must
+    // be reproducible, use the bulk functions above, or a Random( seed,
+    // task ) per task keyed by the task's own index, not the thread's.
+    static Random& local();
+
+    static double toDouble( const quint64& bits )
+    {
+        return double( bits >> 11 ) * ( 1.0 / 9007199254740992.0 );
+    }
+
+    static float toFloat( const quint64& bits )
+    {
+        return float( bits >> 40 ) * ( 1.0f / 16777216.0f );
+    }
+
+    // private:
+
+    quint64 state[ 4 ];
+
+private:
+    static quint64 rotl( const quint64& x, const int& k )
+    {
+        return ( x << k ) | ( x >> ( 64 - k ) );
+    }
+
+    static quint64 mix( quint64 z )
+    {
+        z = ( z ^ ( z >> 30 ) ) * Q_UINT64_C( 0xbf58476d1ce4e5b9 );
+        z = ( z ^ ( z >> 27 ) ) * Q_UINT64_C( 0x94d049bb133111eb );
+        return z ^ ( z >> 31 );
+    }
+
+    static quint64 splitmix( quint64& state )
+    {
+        return Random::mix( state += Q_UINT64_C( 0x9e3779b97f4a7c15 ) );
+    }
+};
+
+} // namespace three
+
+#endif // THREE_RANDOM_H
@@ -8,7 +8,7 @@
 #include "plane.h"
 #include "box3.h"
 
-#include <tuple>
+#include <limits>
 
 namespace three {
 
@@ -108,231 +108,214 @@ public:
 
     double distanceSqToPoint(const Vector3& point ) const
     {
-        Vector3 v1 ;
-
-        double directionDistance = v1.subVectors( point, this->origin ).dot( this->direction );
+        double dx = point.x - this->origin.x, dy = point.y - this->origin.y, dz = point.z - this->origin.z;
+        double directionDistance = dx * this->direction.x + dy * this->direction.y + dz * this->direction.z;
 
         // point behind the ray
-
         if ( directionDistance < 0 ) {
+            return dx * dx + dy * dy + dz * dz;
+        }
 
-            return this->origin.distanceTo(point);
+        dx -= this->direction.x * directionDistance;
+        dy -= this->direction.y * directionDistance;
+        dz -= this->direction.z * directionDistance;
+        return dx * dx + dy * dy + dz * dz;
+    }
 
-        }
+    double distanceSqToSegment(const Vector3& v0, const Vector3& v1 ) const
+    {
+        double s0, s1;
+        return this->distanceSqToSegment( v0, v1, s0, s1 );
+    }
 
-        v1.copy( this->direction ).multiplyScalar( directionDistance ).add( this->origin );
+    double distanceSqToSegment(const Vector3& v0, const Vector3& v1, Vector3& optionalPointOnRay, Vector3& optionalPointOnSegment ) const
+    {
+        double s0, s1;
+        double sqrDist = this->distanceSqToSegment( v0, v1, s0, s1 );
+
+        optionalPointOnRay.copy( this->direction ).multiplyScalar( s0 ).add( this->origin );
 
-        return v1.distanceTo( point );
+        // s1 runs from -1 at v0 to 1 at v1
+        optionalPointOnSegment.lerpVectors( v0, v1, ( s1 + 1 ) * 0.5 );
 
+        return sqrDist;
     }
 
-    double distanceSqToSegment(const Vector3& v0, const Vector3& v1, Vector3& optionalPointOnRay, Vector3& optionalPointOnSegment )
+    // Closest points of the ray and the segment v0 v1: this->at( s0 ) and
+    // ( s1 + 1 ) / 2 of the way from v0 to v1.
+    double distanceSqToSegment(const Vector3& v0, const Vector3& v1, double& s0, double& s1 ) const
     {
-
         // from http://www.geometrictools.com/LibMathematics/Distance/Wm5DistRay3Segment3.cpp
-        // It returns the min distance between the ray and the segment
-        // defined by v0 and v1
-        // It can also set two optional targets :
-        // - The closest point on the ray
-        // - The closest point on the segment
-
-        //		return function ( v0, v1, optionalPointOnRay, optionalPointOnSegment ) {
-
-        Vector3 segCenter = v0.clone().add( v1 ).multiplyScalar( 0.5 );
-        Vector3 segDir = v1.clone().sub( v0 ).normalize();
-        double segExtent = v0.distanceTo( v1 ) * 0.5;
-        Vector3 diff = this->origin.clone().sub( segCenter );
-        double a01 = - this->direction.dot( segDir );
-        double b0 = diff.dot( this->direction );
-        double b1 = - diff.dot( segDir );
-        double c = diff.lengthSq();
-        double det = std::abs( 1 - a01 * a01 );
-        double s0, s1, sqrDist, extDet;
-
-        if ( det >= 0 ) {
+        // with the segment direction kept unnormalized, as half the segment,
+        // so s1 is in [ -1, 1 ] and the extent is 1.
+        double centerX = ( v0.x + v1.x ) * 0.5, centerY = ( v0.y + v1.y ) * 0.5, centerZ = ( v0.z + v1.z ) * 0.5;
+        double halfX = ( v1.x - v0.x ) * 0.5, halfY = ( v1.y - v0.y ) * 0.5, halfZ = ( v1.z - v0.z ) * 0.5;
+        double diffX = this->origin.x - centerX, diffY = this->origin.y - centerY, diffZ = this->origin.z - centerZ;
+
+        double a01 = - ( this->direction.x * halfX + this->direction.y * halfY + this->direction.z * halfZ );
+        double a11 = halfX * halfX + halfY * halfY + halfZ * halfZ;
+        double b0 = diffX * this->direction.x + diffY * this->direction.y + diffZ * this->direction.z;
+        double b1 = - ( diffX * halfX + diffY * halfY + diffZ * halfZ );
+        double det = std::abs( a11 - a01 * a01 );
+
+        if ( det > 0 ) {
 
             // The ray and segment are not parallel.
 
-            s0 = a01 * b1 - b0;
+            s0 = a01 * b1 - a11 * b0;
             s1 = a01 * b0 - b1;
-            extDet = segExtent * det;
 
             if ( s0 >= 0 ) {
-
-                if ( s1 >= - extDet ) {
-
-                    if ( s1 <= extDet ) {
-
+                if ( s1 >= - det ) {
+                    if ( s1 <= det ) {
                         // region 0
                         // Minimum at interior points of ray and segment.
-
-                        auto invDet = 1 / det;
-                        s0 *= invDet;
-                        s1 *= invDet;
-                        sqrDist = s0 * ( s0 + a01 * s1 + 2 * b0 ) + s1 * ( a01 * s0 + s1 + 2 * b1 ) + c;
-
+                        s0 /= det;
+                        s1 /= det;
                     } else {
-
                         // region 1
-
-                        s1 = segExtent;
-                        s0 = std::max( 0.0, - ( a01 * s1 + b0 ) );
-                        sqrDist = - s0 * s0 + s1 * ( s1 + 2 * b1 ) + c;
-
+                        s1 = 1;
+                        s0 = std::max( 0.0, - ( a01 + b0 ) );
                     }
-
                 } else {
-
                     // region 5
-
-                    s1 = - segExtent;
-                    s0 = std::max( 0.0, - ( a01 * s1 + b0 ) );
-                    sqrDist = - s0 * s0 + s1 * ( s1 + 2 * b1 ) + c;
-
+                    s1 = - 1;
+                    s0 = std::max( 0.0, a01 - b0 );
                 }
-
+            } else if ( s1 <= - det ) {
+                // region 4
+                s0 = std::max( 0.0, a01 - b0 );
+                s1 = s0 > 0 ? - 1 : a11 > 0 ? std::min( std::max( - 1.0, - b1 / a11 ), 1.0 ) : 0;
+            } else if ( s1 <= det ) {
+                // region 3
+                s0 = 0;
+                s1 = a11 > 0 ? std::min( std::max( - 1.0, - b1 / a11 ), 1.0 ) : 0;
             } else {
-
-                if ( s1 <= - extDet ) {
-
-                    // region 4
-
-                    s0 = std::max( 0.0, - ( - a01 * segExtent + b0 ) );
-                    s1 = ( s0 > 0 ) ? - segExtent : std::min( std::max( - segExtent, - b1 ), segExtent );
-                    sqrDist = - s0 * s0 + s1 * ( s1 + 2 * b1 ) + c;
-
-                } else if ( s1 <= extDet ) {
-
-                    // region 3
-
-                    s0 = 0;
-                    s1 = std::min( std::max( - segExtent, - b1 ), segExtent );
-                    sqrDist = s1 * ( s1 + 2 * b1 ) + c;
-
-                } else {
-
-                    // region 2
-
-                    s0 = std::max( 0.0, - ( a01 * segExtent + b0 ) );
-                    s1 = ( s0 > 0 ) ? segExtent : std::min( std::max( - segExtent, - b1 ), segExtent );
-                    sqrDist = - s0 * s0 + s1 * ( s1 + 2 * b1 ) + c;
-
-                }
-
+                // region 2
+                s0 = std::max( 0.0, - ( a01 + b0 ) );
+                s1 = s0 > 0 ? 1 : a11 > 0 ? std::min( std::max( - 1.0, - b1 / a11 ), 1.0 ) : 0;
             }
 
         } else {
 
             // Ray and segment are parallel.
 
-            s1 = ( a01 > 0 ) ? - segExtent : segExtent;
+            s1 = ( a01 > 0 ) ? - 1 : 1;
             s0 = std::max( 0.0, - ( a01 * s1 + b0 ) );
-            sqrDist = - s0 * s0 + s1 * ( s1 + 2 * b1 ) + c;
 
         }
 
-        // 这个是参数可以略去
-        optionalPointOnRay.copy( this->direction.clone().multiplyScalar( s0 ).add( this->origin ) );
-
-        // 这个是参数可以略去
-        optionalPointOnSegment.copy( segDir.clone().multiplyScalar( s1 ).add( segCenter ) );
-
-        return sqrDist;
+        // squared length of diff + s0 * direction - s1 * half
+        double dx = diffX + this->direction.x * s0 - halfX * s1;
+        double dy = diffY + this->direction.y * s0 - halfY * s1;
+        double dz = diffZ + this->direction.z * s0 - halfZ * s1;
+        return dx * dx + dy * dy + dz * dz;
     }
 
     bool isIntersectionSphere( const Sphere& sphere ) const
     {
-        return this->distanceToPoint( sphere.center ) <= sphere.radius;
+        return this->intersectsSphere( sphere );
     }
 
-
-    std::tuple<bool, Vector3> intersectSphere(const Sphere& sphere, Vector3& optionalTarget )
+    // The intersect* functions below report a hit only when it is nearer
+    // than hit.distance, and then update hit. A default Hit takes any hit
+    // in front of the ray, reusing one Hit over many tests keeps the
+    // nearest. hit.primitive is left to the caller.
+    struct Hit
     {
-        Vector3 v1;
-
-        v1.subVectors( sphere.center, this->origin );
-        double tca = v1.dot( this->direction );
-        double d2 = v1.dot( v1 ) - tca * tca;
+        Hit():
+            distance( std::numeric_limits<double>::infinity() ),
+            primitive( -1 ),
+            u( 0 ),
+            v( 0 )
+        { }
+
+        double  distance;   // hit point is ray.at( distance )
+        int     primitive;  // index of the triangle / box, -1 for no hit
+        double  u, v;       // barycentric weights of b and c for triangles
+    };
+
+    // the entry point, or the exit point for rays starting inside
+    bool intersectSphere( const Sphere& sphere, Hit& hit ) const
+    {
+        double cx = sphere.center.x - this->origin.x, cy = sphere.center.y - this->origin.y, cz = sphere.center.z - this->origin.z;
+        double tca = cx * this->direction.x + cy * this->direction.y + cz * this->direction.z;
+        double d2 = cx * cx + cy * cy + cz * cz - tca * tca;
         double radius2 = sphere.radius * sphere.radius;
 
-        // if ( d2 > radius2 ) return null;
-        if ( d2 > radius2 ) return std::tuple<bool, Vector3>(false, Vector3());
+        if ( d2 > radius2 )
+            return false;
 
         double thc = std::sqrt( radius2 - d2 );
 
         // t0 = first intersect point - entrance on front of sphere
-        double t0 = tca - thc;
-
         // t1 = second intersect point - exit point on back of sphere
-        double t1 = tca + thc;
+        double t0 = tca - thc, t1 = tca + thc;
+        double t = t0 >= 0 ? t0 : t1;
 
-        // test to see if both t0 and t1 are behind the ray - if so, return null
-        if ( t0 < 0 && t1 < 0 ) return std::tuple<bool, Vector3>(false, Vector3());
+        if ( !( t >= 0 && t < hit.distance ) )
+            return false;
 
-        // test to see if t0 is behind the ray:
-        // if it is, the ray is inside the sphere, so return the second exit point scaled by t1,
-        // in order to always return an intersect point that is in front of the ray.
-        // if ( t0 < 0 ) return this->at( t1, optionalTarget );
-        if ( t0 < 0 ) return std::tuple<bool, Vector3>(false,  this->at( t1, optionalTarget ));
+        hit.distance = t;
+        hit.u = hit.v = 0;
+        return true;
+    }
 
-        // else t0 is in front of the ray, so return the first collision point scaled by t0
-        //        return this->at( t0, optionalTarget );
-        if ( t0 < 0 ) return std::tuple<bool, Vector3>(false,  this->at( t0, optionalTarget ));
+    bool intersectSphere( const Sphere& sphere, Vector3& optionalTarget ) const
+    {
+        Hit hit;
+        if ( !this->intersectSphere( sphere, hit ) )
+            return false;
+
+        this->at( hit.distance, optionalTarget );
+        return true;
     }
 
     bool intersectsSphere(const Sphere& sphere ) const
     {
-        return this->distanceToPoint( sphere.center ) <= sphere.radius;
+        return this->distanceSqToPoint( sphere.center ) <= sphere.radius * sphere.radius;
     }
 
-    // (false, double) -> null
-    std::tuple<bool, double> distanceToPlane(const Plane& plane ) const
+    // Distance along the ray to the plane, 0 for a ray in the plane. False
+    // when the ray points away from the plane or runs parallel to it.
+    bool distanceToPlane( const Plane& plane, double& distance ) const
     {
         double denominator = plane.normal.dot( this->direction );
+        double distToPoint = plane.distanceToPoint( this->origin );
 
         if ( denominator == 0 ) {
             // line is coplanar, return origin
-            if ( plane.distanceToPoint( this->origin ) == 0 ) {
-                // return 0;
-                return  std::tuple<bool, double>(true, 0);
-            } else {
-                // TODO
-                // Null is preferable to undefined since undefined means.... it is undefined
-                qDebug() << "Null is preferable to undefined since undefined means.... it is undefined";
-                // return null;
-                return  std::tuple<bool, double>(false, -1);
-            }
+            distance = 0;
+            return distToPoint == 0;
         }
 
-        double t = - ( this->origin.dot( plane.normal ) + plane.constant ) / denominator;
+        distance = - distToPoint / denominator;
 
         // Return if the ray never intersects the plane
+        return distance >= 0;
+    }
 
-        // return t >= 0 ? t :  null;
-        if(t >= 0) {
-            return std::tuple<bool, double>(true, t);
-        } else {
-            return std::tuple<bool, double>(false, t);
-        }
+    bool intersectPlane( const Plane& plane, Hit& hit ) const
+    {
+        double t;
+        if ( !this->distanceToPlane( plane, t ) || !( t < hit.distance ) )
+            return false;
 
+        hit.distance = t;
+        hit.u = hit.v = 0;
+        return true;
     }
 
-    std::tuple<bool, Vector3> intersectPlane( const Plane& plane, Vector3& optionalTarget ) const
+    bool intersectPlane( const Plane& plane, Vector3& optionalTarget ) const
     {
+        double t;
+        if ( !this->distanceToPlane( plane, t ) )
+            return false;
 
-        std::tuple<bool, double> t = this->distanceToPlane( plane );
-        //        if ( t ==null ) {	//如果射线与平面永不相交或其他未知定义返回null
-        //            return null;	//返回null
-        //        }
-
-        if (std::get<0>(t) == false) {
-            return std::tuple<bool, Vector3>(false, Vector3());
-        }
-        //        return this->at( t, optionalTarget );
-        return std::tuple<bool, Vector3>(true, this->at( std::get<1>(t), optionalTarget ));
+        this->at( t, optionalTarget );
+        return true;
     }
 
-
     bool intersectsPlane( const Plane& plane ) const
     {
         // check if the ray lies on the plane first
@@ -353,164 +336,128 @@ public:
         return false;
     }
 
-
-    std::tuple<bool, Vector3> intersectBox( const Box3& box, Vector3& optionalTarget ) const
+    // the entry point, or the exit point for rays starting inside
+    bool intersectBox( const Box3& box, Hit& hit ) const
     {
-        double tmin, tmax;
+        double invdirx = 1 / this->direction.x,
+               invdiry = 1 / this->direction.y,
+               invdirz = 1 / this->direction.z;
 
-        double tymin, tymax, tzmin, tzmax;
+        // the near slab is min for positive directions, max for negative ones
+        double tmin = ( ( invdirx >= 0 ? box.min.x : box.max.x ) - this->origin.x ) * invdirx;
+        double tmax = ( ( invdirx >= 0 ? box.max.x : box.min.x ) - this->origin.x ) * invdirx;
+        double tymin = ( ( invdiry >= 0 ? box.min.y : box.max.y ) - this->origin.y ) * invdiry;
+        double tymax = ( ( invdiry >= 0 ? box.max.y : box.min.y ) - this->origin.y ) * invdiry;
 
-        double  invdirx = 1 / this->direction.x,
-                invdiry = 1 / this->direction.y,
-                invdirz = 1 / this->direction.z;
-
-        auto origin = this->origin;
-
-        if ( invdirx >= 0 ) {
-
-            tmin = ( box.min.x - origin.x ) * invdirx;
-            tmax = ( box.max.x - origin.x ) * invdirx;
-
-        } else {
-
-            tmin = ( box.max.x - origin.x ) * invdirx;
-            tmax = ( box.min.x - origin.x ) * invdirx;
-
-        }
-
-        if ( invdiry >= 0 ) {
-
-            tymin = ( box.min.y - origin.y ) * invdiry;
-            tymax = ( box.max.y - origin.y ) * invdiry;
-
-        } else {
-
-            tymin = ( box.max.y - origin.y ) * invdiry;
-            tymax = ( box.min.y - origin.y ) * invdiry;
-
-        }
-
-        // if ( ( tmin > tymax ) || ( tymin > tmax ) ) return null;
-        if ( ( tmin > tymax ) || ( tymin > tmax ) ) return std::tuple<bool, Vector3>(false, Vector3());
+        if ( ( tmin > tymax ) || ( tymin > tmax ) )
+            return false;
 
         // These lines also handle the case where tmin or tmax is NaN
         // (result of 0 * Infinity). x != x returns true if x is NaN
-
         if ( tymin > tmin || tmin != tmin ) tmin = tymin;
-
         if ( tymax < tmax || tmax != tmax ) tmax = tymax;
 
-        if ( invdirz >= 0 ) {
-
-            tzmin = ( box.min.z - origin.z ) * invdirz;
-            tzmax = ( box.max.z - origin.z ) * invdirz;
+        double tzmin = ( ( invdirz >= 0 ? box.min.z : box.max.z ) - this->origin.z ) * invdirz;
+        double tzmax = ( ( invdirz >= 0 ? box.max.z : box.min.z ) - this->origin.z ) * invdirz;
 
-        } else {
-
-            tzmin = ( box.max.z - origin.z ) * invdirz;
-            tzmax = ( box.min.z - origin.z ) * invdirz;
-
-        }
-
-        // if ( ( tmin > tzmax ) || ( tzmin > tmax ) ) return null;
-        if ( ( tmin > tzmax ) || ( tzmin > tmax ) ) return std::tuple<bool, Vector3>(false, Vector3());
+        if ( ( tmin > tzmax ) || ( tzmin > tmax ) )
+            return false;
 
         if ( tzmin > tmin || tmin != tmin ) tmin = tzmin;
-
         if ( tzmax < tmax || tmax != tmax ) tmax = tzmax;
 
         //return point closest to the ray (positive side)
+        double t = tmin >= 0 ? tmin : tmax;
 
-        // if ( tmax < 0 ) return null;
-        if ( tmax < 0 ) return std::tuple<bool, Vector3>(false, Vector3());
+        if ( !( t >= 0 && t < hit.distance ) )
+            return false;
 
-        // return this->at( tmin >= 0 ? tmin : tmax, optionalTarget );
-        return std::tuple<bool, Vector3>(false,  this->at( tmin >= 0 ? tmin : tmax, optionalTarget ));
+        hit.distance = t;
+        hit.u = hit.v = 0;
+        return true;
     }
 
-    bool intersectsBox( const Box3& box )
+    bool intersectBox( const Box3& box, Vector3& optionalTarget ) const
     {
-        Vector3 v ;
-        // TODO
-        return std::get<0>(this->intersectBox( box, v )) != false;
+        Hit hit;
+        if ( !this->intersectBox( box, hit ) )
+            return false;
+
+        this->at( hit.distance, optionalTarget );
+        return true;
     }
 
-    std::tuple<bool, Vector3> intersectTriangle(const Vector3& a,const Vector3& b,const Vector3& c, bool backfaceCulling, Vector3& optionalTarget ) const
+    bool intersectsBox( const Box3& box ) const
     {
+        Hit hit;
+        return this->intersectBox( box, hit );
+    }
 
+    // hit.u / hit.v get the barycentric weights of b and c
+    bool intersectTriangle( const Vector3& a, const Vector3& b, const Vector3& c, const bool& backfaceCulling, Hit& hit ) const
+    {
         // from http://www.geometrictools.com/LibMathematics/Intersection/Wm5IntrRay3Triangle3.cpp
         // Compute the offset origin, edges, and normal.
-        Vector3 diff ;
-        Vector3 edge1;
-        Vector3 edge2;
-        Vector3 normal;
-
-        edge1.subVectors( b, a );
-        edge2.subVectors( c, a );
-        normal.crossVectors( edge1, edge2 );
+        double e1x = b.x - a.x, e1y = b.y - a.y, e1z = b.z - a.z;
+        double e2x = c.x - a.x, e2y = c.y - a.y, e2z = c.z - a.z;
+        double nx = e1y * e2z - e1z * e2y, ny = e1z * e2x - e1x * e2z, nz = e1x * e2y - e1y * e2x;
 
         // Solve Q + t*D = b1*E1 + b2*E2 (Q = kDiff, D = ray direction,
         // E1 = kEdge1, E2 = kEdge2, N = Cross(E1,E2)) by
         //   |Dot(D,N)|*b1 = sign(Dot(D,N))*Dot(D,Cross(Q,E2))
         //   |Dot(D,N)|*b2 = sign(Dot(D,N))*Dot(D,Cross(E1,Q))
         //   |Dot(D,N)|*t = -sign(Dot(D,N))*Dot(Q,N)
-        double DdN = this->direction.dot( normal );
-        int sign;
-
-        if ( DdN > 0 ) {
-            // if ( backfaceCulling ) return null;
-            if ( backfaceCulling )  return std::tuple<bool, Vector3>(false, Vector3());
-            sign = 1;
-        } else if ( DdN < 0 ) {
-
-            sign = - 1;
-            DdN = - DdN;
-
-        } else {
-            // return null;
-            return std::tuple<bool, Vector3>(false, Vector3());
-        }
+        const Vector3& d = this->direction;
+        double DdN = d.x * nx + d.y * ny + d.z * nz;
 
-        diff.subVectors( this->origin, a );
-        double DdQxE2 = sign * this->direction.dot( edge2.crossVectors( diff, edge2 ) );
+        // DdN > 0 is a back face, DdN == 0 never hits
+        if ( DdN == 0 || ( backfaceCulling && DdN > 0 ) )
+            return false;
 
-        // b1 < 0, no intersection
-        if ( DdQxE2 < 0 ) {
+        double sign = DdN > 0 ? 1 : - 1;
+        DdN *= sign;
 
-            // return null;
-            return std::tuple<bool, Vector3>(false, Vector3());
-        }
+        double qx = this->origin.x - a.x, qy = this->origin.y - a.y, qz = this->origin.z - a.z;
 
-        auto DdE1xQ = sign * this->direction.dot( edge1.cross( diff ) );
+        // Cross(Q,E2) and Cross(E1,Q)
+        double qe2x = qy * e2z - qz * e2y, qe2y = qz * e2x - qx * e2z, qe2z = qx * e2y - qy * e2x;
+        double e1qx = e1y * qz - e1z * qy, e1qy = e1z * qx - e1x * qz, e1qz = e1x * qy - e1y * qx;
 
-        // b2 < 0, no intersection
-        if ( DdE1xQ < 0 ) {
+        double DdQxE2 = sign * ( d.x * qe2x + d.y * qe2y + d.z * qe2z );
+        double DdE1xQ = sign * ( d.x * e1qx + d.y * e1qy + d.z * e1qz );
 
-            // return null;
-            return std::tuple<bool, Vector3>(false, Vector3());
-        }
+        // b1 < 0, b2 < 0 or b1+b2 > 1, no intersection
+        if ( DdQxE2 < 0 || DdE1xQ < 0 || DdQxE2 + DdE1xQ > DdN )
+            return false;
 
-        // b1+b2 > 1, no intersection
-        if ( DdQxE2 + DdE1xQ > DdN ) {
+        // Line intersects triangle, check if ray does.
+        double QdN = - sign * ( qx * nx + qy * ny + qz * nz );
 
-            // return null;
-            return std::tuple<bool, Vector3>(false, Vector3());
+        // t < 0, no intersection
+        if ( QdN < 0 )
+            return false;
 
-        }
+        // Ray intersects triangle.
+        double inverse = 1 / DdN;
+        double t = QdN * inverse;
 
-        // Line intersects triangle, check if ray does.
-        auto QdN = - sign * diff.dot( normal );
+        if ( !( t < hit.distance ) )
+            return false;
 
-        // t < 0, no intersection
-        if ( QdN < 0 ) {
+        hit.distance = t;
+        hit.u = DdQxE2 * inverse;
+        hit.v = DdE1xQ * inverse;
+        return true;
+    }
 
-            // return null;
-            return std::tuple<bool, Vector3>(false, Vector3());
+    bool intersectTriangle( const Vector3& a, const Vector3& b, const Vector3& c, const bool& backfaceCulling, Vector3& optionalTarget ) const
+    {
+        Hit hit;
+        if ( !this->intersectTriangle( a, b, c, backfaceCulling, hit ) )
+            return false;
 
-        }
-        // Ray intersects triangle.
-        // return this->at( QdN / DdN, optionalTarget );
-        return std::tuple<bool, Vector3>(true, this->at( QdN / DdN, optionalTarget ));
+        this->at( hit.distance, optionalTarget );
+        return true;
     }
 
     Ray& applyMatrix4( const Matrix4& matrix4 )
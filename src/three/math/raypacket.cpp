@@ -0,0 +1,193 @@
+#include "raypacket.h"
+
+#include "simd.hpp"
+
+namespace three {
+
+namespace {
+
+static_assert( RayPacket::Size % Simd::DoubleLanes == 0, "RayPacket::Size must be a multiple of the vector width" );
+
+// 1 / d, with a huge finite value standing in for 1 / 0
+inline double inverse( const double& d )
+{
+    if ( d == 0 )
+        return std::copysign( std::numeric_limits<double>::max(), d );
+    return 1 / d;
+}
+
+} // namespace
+
+void RayPacket::Hits::reset(const RayPacket &packet)
+{
+    for ( int i = 0; i < Size; i ++ ) {
+        this->distances[ i ] = packet.maxDistances[ i ];
+        this->us[ i ] = 0;
+        this->vs[ i ] = 0;
+        this->primitives[ i ] = -1;
+    }
+}
+
+RayPacket::RayPacket():
+    count( 0 )
+{
+    // unused rays: their maxDistance is below their minDistance
+    for ( int i = 0; i < Size; i ++ ) {
+        this->originX[ i ] = this->originY[ i ] = this->originZ[ i ] = 0;
+        this->directionX[ i ] = 1;
+        this->directionY[ i ] = this->directionZ[ i ] = 0;
+        this->inverseX[ i ] = 1;
+        this->inverseY[ i ] = this->inverseZ[ i ] = std::numeric_limits<double>::max();
+        this->minDistances[ i ] = 0;
+        this->maxDistances[ i ] = -1;
+    }
+}
+
+RayPacket &RayPacket::set(const Ray *rays, const int &count, const double &minDistance, const double &maxDistance)
+{
+    Q_ASSERT( count >= 0 && count <= Size );
+
+    *this = RayPacket();
+    for ( int i = 0; i < count; i ++ ) {
+        this->setRay( i, rays[ i ], minDistance, maxDistance );
+    }
+    return *this;
+}
+
+RayPacket &RayPacket::setRay(const int &index, const Ray &ray, const double &minDistance, const double &maxDistance)
+{
+    Q_ASSERT( index >= 0 && index < Size );
+
+    this->originX[ index ] = ray.origin.x;
+    this->originY[ index ] = ray.origin.y;
+    this->originZ[ index ] = ray.origin.z;
+    this->directionX[ index ] = ray.direction.x;
+    this->directionY[ index ] = ray.direction.y;
+    this->directionZ[ index ] = ray.direction.z;
+    this->inverseX[ index ] = inverse( ray.direction.x );
+    this->inverseY[ index ] = inverse( ray.direction.y );
+    this->inverseZ[ index ] = inverse( ray.direction.z );
+    this->minDistances[ index ] = minDistance;
+    this->maxDistances[ index ] = maxDistance;
+
+    this->count = std::max( this->count, index + 1 );
+    return *this;
+}
+
+int RayPacket::intersectBox(const Box3 &box, const double *maxDistances, double *entries) const
+{
+    using namespace Simd;
+
+    if ( maxDistances == nullptr ) {
+        maxDistances = this->maxDistances;
+    }
+
+    VDouble minX = set1( box.min.x ), minY = set1( box.min.y ), minZ = set1( box.min.z );
+    VDouble maxX = set1( box.max.x ), maxY = set1( box.max.y ), maxZ = set1( box.max.z );
+
+    int mask = 0;
+    for ( int i = 0; i < Size; i += DoubleLanes ) {
+        VDouble entry = load( this->minDistances + i );
+        VDouble exit = load( maxDistances + i );
+
+        VDouble origin = load( this->originX + i ), inverseDirection = load( this->inverseX + i );
+        VDouble t1 = mul( sub( minX, origin ), inverseDirection ), t2 = mul( sub( maxX, origin ), inverseDirection );
+        entry = max( entry, min( t1, t2 ) );
+        exit = min( exit, max( t1, t2 ) );
+
+        origin = load( this->originY + i ), inverseDirection = load( this->inverseY + i );
+        t1 = mul( sub( minY, origin ), inverseDirection ), t2 = mul( sub( maxY, origin ), inverseDirection );
+        entry = max( entry, min( t1, t2 ) );
+        exit = min( exit, max( t1, t2 ) );
+
+        origin = load( this->originZ + i ), inverseDirection = load( this->inverseZ + i );
+        t1 = mul( sub( minZ, origin ), inverseDirection ), t2 = mul( sub( maxZ, origin ), inverseDirection );
+        entry = max( entry, min( t1, t2 ) );
+        exit = min( exit, max( t1, t2 ) );
+
+        if ( entries != nullptr ) {
+            store( entries + i, entry );
+        }
+        mask |= movemask( cmple( entry, exit ) ) << i;
+    }
+    return mask;
+}
+
+int RayPacket::intersectTriangle(const Vector3 &a, const Vector3 &b, const Vector3 &c, const int &primitive,
+                                 const bool &backfaceCulling, Hits &hits) const
+{
+    using namespace Simd;
+
+    VDouble e1x = set1( b.x - a.x ), e1y = set1( b.y - a.y ), e1z = set1( b.z - a.z );
+    VDouble e2x = set1( c.x - a.x ), e2y = set1( c.y - a.y ), e2z = set1( c.z - a.z );
+    VDouble zero = set1( 0.0 ), one = set1( 1.0 );
+
+    int mask = 0;
+    for ( int i = 0; i < Size; i += DoubleLanes ) {
+        VDouble dx = load( this->directionX + i ), dy = load( this->directionY + i ), dz = load( this->directionZ + i );
+
+        VDouble px = sub( mul( dy, e2z ), mul( dz, e2y ) );
+        VDouble py = sub( mul( dz, e2x ), mul( dx, e2z ) );
+        VDouble pz = sub( mul( dx, e2y ), mul( dy, e2x ) );
+
+        VDouble det = add( add( mul( e1x, px ), mul( e1y, py ) ), mul( e1z, pz ) );
+        VDouble valid = backfaceCulling ? cmplt( zero, det ) : or_( cmplt( det, zero ), cmplt( zero, det ) );
+        VDouble inverseDet = div( one, det );
+
+        VDouble sx = sub( load( this->originX + i ), set1( a.x ) );
+        VDouble sy = sub( load( this->originY + i ), set1( a.y ) );
+        VDouble sz = sub( load( this->originZ + i ), set1( a.z ) );
+
+        VDouble u = mul( add( add( mul( sx, px ), mul( sy, py ) ), mul( sz, pz ) ), inverseDet );
+        valid = and_( valid, and_( cmple( zero, u ), cmple( u, one ) ) );
+
+        VDouble qx = sub( mul( sy, e1z ), mul( sz, e1y ) );
+        VDouble qy = sub( mul( sz, e1x ), mul( sx, e1z ) );
+        VDouble qz = sub( mul( sx, e1y ), mul( sy, e1x ) );
+
+        VDouble v = mul( add( add( mul( dx, qx ), mul( dy, qy ) ), mul( dz, qz ) ), inverseDet );
+        valid = and_( valid, and_( cmple( zero, v ), cmple( add( u, v ), one ) ) );
+
+        VDouble t = mul( add( add( mul( e2x, qx ), mul( e2y, qy ) ), mul( e2z, qz ) ), inverseDet );
+        VDouble best = load( hits.distances + i );
+        valid = and_( valid, and_( cmple( load( this->minDistances + i ), t ), cmple( t, best ) ) );
+
+        int bits = movemask( valid );
+        if ( bits == 0 )
+            continue;
+
+        store( hits.distances + i, select( valid, best, t ) );
+        store( hits.us + i, select( valid, load( hits.us + i ), u ) );
+        store( hits.vs + i, select( valid, load( hits.vs + i ), v ) );
+        for ( int lane = 0; lane < DoubleLanes; lane ++ ) {
+            if ( bits & ( 1 << lane ) ) {
+                hits.primitives[ i + lane ] = primitive;
+            }
+        }
+        mask |= bits << i;
+    }
+    return mask;
+}
+
+int RayPacket::intersectBoxes(const Box3 *boxes, const int &count, Hits &hits) const
+{
+    alignas( 32 ) double entries[ Size ];
+
+    int mask = 0;
+    for ( int k = 0; k < count; k ++ ) {
+        int bits = this->intersectBox( boxes[ k ], hits.distances, entries );
+
+        // the first of equally near boxes wins
+        for ( int i = 0; bits != 0; i ++, bits >>= 1 ) {
+            if ( ( bits & 1 ) && ( hits.primitives[ i ] < 0 || entries[ i ] < hits.distances[ i ] ) ) {
+                hits.distances[ i ] = entries[ i ];
+                hits.us[ i ] = hits.vs[ i ] = 0;
+                hits.primitives[ i ] = k;
+                mask |= 1 << i;
+            }
+        }
+    }
+    return mask;
+}
+
+} // namespace three
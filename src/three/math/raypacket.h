@@ -0,0 +1,86 @@
+#ifndef THREE_RAYPACKET_H
+#define THREE_RAYPACKET_H
+
+#include <limits>
+
+#include "math_forword_declar.h"
+
+#include "vector3.h"
+#include "box3.h"
+#include "ray.h"
+
+namespace three {
+
+class Ray;
+class Box3;
+
+// Up to Size rays in SoA layout, tested together against boxes and
+// triangles Simd::DoubleLanes rays per instruction. The inverse directions
+// are computed once in setRay(). A zero direction component gets a huge
+// finite inverse instead of infinity, so the slab tests never see
+// 0 * infinity, a ray lying in a slab plane counts as inside that slab.
+//
+// Results are bit masks, bit i for ray i. Unused rays never hit anything.
+class RayPacket
+{
+public:
+    static const int Size = 8;
+
+    // nearest hit per ray, SoA as well
+    struct Hits
+    {
+        // distances start at the rays' maxDistance, a hit has to beat them
+        void reset( const RayPacket& packet );
+
+        alignas( 32 ) double distances[ Size ];
+        alignas( 32 ) double us[ Size ];
+        alignas( 32 ) double vs[ Size ];
+        int primitives[ Size ];     // -1 for no hit
+    };
+
+    RayPacket();
+
+    RayPacket& set( const Ray* rays, const int& count,
+                    const double& minDistance = 0, const double& maxDistance = std::numeric_limits<double>::infinity() );
+
+    RayPacket& setRay( const int& index, const Ray& ray,
+                       const double& minDistance = 0, const double& maxDistance = std::numeric_limits<double>::infinity() );
+
+    int activeMask() const
+    {
+        return ( 1 << this->count ) - 1;
+    }
+
+    // Rays entering box between their minDistance and maxDistances[ i ]
+    // ( the packet's own maxDistance if null ), entries[ i ] gets the
+    // distance ray i enters the box if given.
+    int intersectBox( const Box3& box, const double* maxDistances = nullptr, double* entries = nullptr ) const;
+
+    // Updates hits for the rays that hit triangle abc nearer than their
+    // current hit, primitive is stored for them. Same conventions as
+    // BVH::intersect: det > 0 is a front face, u / v weigh b and c.
+    int intersectTriangle( const Vector3& a, const Vector3& b, const Vector3& c, const int& primitive,
+                           const bool& backfaceCulling, Hits& hits ) const;
+
+    // Nearest box of boxes[ 0, count ) for every ray, hits.primitives gets
+    // the box index and hits.distances the entry distance.
+    int intersectBoxes( const Box3* boxes, const int& count, Hits& hits ) const;
+
+    // private:
+    alignas( 32 ) double originX[ Size ];
+    alignas( 32 ) double originY[ Size ];
+    alignas( 32 ) double originZ[ Size ];
+    alignas( 32 ) double directionX[ Size ];
+    alignas( 32 ) double directionY[ Size ];
+    alignas( 32 ) double directionZ[ Size ];
+    alignas( 32 ) double inverseX[ Size ];
+    alignas( 32 ) double inverseY[ Size ];
+    alignas( 32 ) double inverseZ[ Size ];
+    alignas( 32 ) double minDistances[ Size ];
+    alignas( 32 ) double maxDistances[ Size ];
+    int count;
+};
+
+} // namespace three
+
+#endif // THREE_RAYPACKET_H
@@ -0,0 +1,136 @@
+#include "rotation.h"
+
+#include <cstddef>
+
+#include "matrix4.h"
+#include "parallel.hpp"
+
+namespace three {
+namespace Rotation {
+
+namespace {
+
+const int RotationsPerTask = 1 << 12;
+
+template<typename Body>
+void run( int count, bool parallel, Body body )
+{
+    if ( parallel ) {
+        Parallel::forRange( count, RotationsPerTask, body );
+    } else {
+        body( 0, count );
+    }
+}
+
+// x, y, z of rotation i at angles[ i * stride ]
+template<Euler::RotationOrders Order>
+void toMatrices( const double* angles, int stride, Matrix4* matrices, int count, bool parallel )
+{
+    run( count, parallel, [=]( int begin, int end ) {
+        const double* p = angles + qptrdiff( begin ) * stride;
+        for ( int i = begin; i < end; i ++, p += stride ) {
+            eulerToMatrix<Order>( p[ 0 ], p[ 1 ], p[ 2 ], matrices[ i ].elements );
+        }
+    } );
+}
+
+} // namespace
+
+template<Euler::RotationOrders Order>
+void eulersToMatrices(const double *angles, Matrix4 *matrices, int count, bool parallel)
+{
+    toMatrices<Order>( angles, 3, matrices, count, parallel );
+}
+
+template<Euler::RotationOrders Order>
+void eulersToQuaternions(const double *angles, Quaternion *quaternions, int count, bool parallel)
+{
+    run( count, parallel, [=]( int begin, int end ) {
+        const double* p = angles + qptrdiff( begin ) * 3;
+        for ( int i = begin; i < end; i ++, p += 3 ) {
+            eulerToQuaternion<Order>( p[ 0 ], p[ 1 ], p[ 2 ], quaternions[ i ] );
+        }
+    } );
+}
+
+void eulersToMatrices(const Euler::RotationOrders &order, const double *angles, Matrix4 *matrices, int count,
+                      bool parallel)
+{
+    switch ( order ) {
+    case Euler::XYZ: eulersToMatrices<Euler::XYZ>( angles, matrices, count, parallel ); break;
+    case Euler::YZX: eulersToMatrices<Euler::YZX>( angles, matrices, count, parallel ); break;
+    case Euler::ZXY: eulersToMatrices<Euler::ZXY>( angles, matrices, count, parallel ); break;
+    case Euler::XZY: eulersToMatrices<Euler::XZY>( angles, matrices, count, parallel ); break;
+    case Euler::YXZ: eulersToMatrices<Euler::YXZ>( angles, matrices, count, parallel ); break;
+    case Euler::ZYX: eulersToMatrices<Euler::ZYX>( angles, matrices, count, parallel ); break;
+    }
+}
+
+void eulersToQuaternions(const Euler::RotationOrders &order, const double *angles, Quaternion *quaternions, int count,
+                         bool parallel)
+{
+    switch ( order ) {
+    case Euler::XYZ: eulersToQuaternions<Euler::XYZ>( angles, quaternions, count, parallel ); break;
+    case Euler::YZX: eulersToQuaternions<Euler::YZX>( angles, quaternions, count, parallel ); break;
+    case Euler::ZXY: eulersToQuaternions<Euler::ZXY>( angles, quaternions, count, parallel ); break;
+    case Euler::XZY: eulersToQuaternions<Euler::XZY>( angles, quaternions, count, parallel ); break;
+    case Euler::YXZ: eulersToQuaternions<Euler::YXZ>( angles, quaternions, count, parallel ); break;
+    case Euler::ZYX: eulersToQuaternions<Euler::ZYX>( angles, quaternions, count, parallel ); break;
+    }
+}
+
+void eulersToMatrices(const Euler *eulers, Matrix4 *matrices, int count, bool parallel)
+{
+    // the angles of an Euler are read in place, Eulers apart
+    static_assert( offsetof( Euler, x ) == 0 && offsetof( Euler, y ) == sizeof( double ) &&
+                   offsetof( Euler, z ) == 2 * sizeof( double ), "Euler must start with x, y, z" );
+    static_assert( sizeof( Euler ) % sizeof( double ) == 0, "Euler must be a whole number of doubles" );
+    const int stride = int( sizeof( Euler ) / sizeof( double ) );
+
+    for ( int begin = 0, end = 0; begin < count; begin = end ) {
+        Euler::RotationOrders order = eulers[ begin ].order;
+        for ( end = begin + 1; end < count && eulers[ end ].order == order; end ++ ) { }
+
+        const double* angles = &eulers[ begin ].x;
+        Matrix4* out = matrices + begin;
+        int n = end - begin;
+
+        switch ( order ) {
+        case Euler::XYZ: toMatrices<Euler::XYZ>( angles, stride, out, n, parallel ); break;
+        case Euler::YZX: toMatrices<Euler::YZX>( angles, stride, out, n, parallel ); break;
+        case Euler::ZXY: toMatrices<Euler::ZXY>( angles, stride, out, n, parallel ); break;
+        case Euler::XZY: toMatrices<Euler::XZY>( angles, stride, out, n, parallel ); break;
+        case Euler::YXZ: toMatrices<Euler::YXZ>( angles, stride, out, n, parallel ); break;
+        case Euler::ZYX: toMatrices<Euler::ZYX>( angles, stride, out, n, parallel ); break;
+        }
+    }
+}
+
+void quaternionsToMatrices(const Quaternion *quaternions, Matrix4 *matrices, int count, bool parallel)
+{
+    run( count, parallel, [=]( int begin, int end ) {
+        for ( int i = begin; i < end; i ++ ) {
+            const Quaternion& q = quaternions[ i ];
+            double m[ 9 ];
+            matrixFromQuaternion( q.x, q.y, q.z, q.w, m );
+            setRotation( m, matrices[ i ].elements );
+        }
+    } );
+}
+
+template void eulersToMatrices<Euler::XYZ>( const double*, Matrix4*, int, bool );
+template void eulersToMatrices<Euler::YZX>( const double*, Matrix4*, int, bool );
+template void eulersToMatrices<Euler::ZXY>( const double*, Matrix4*, int, bool );
+template void eulersToMatrices<Euler::XZY>( const double*, Matrix4*, int, bool );
+template void eulersToMatrices<Euler::YXZ>( const double*, Matrix4*, int, bool );
+template void eulersToMatrices<Euler::ZYX>( const double*, Matrix4*, int, bool );
+
+template void eulersToQuaternions<Euler::XYZ>( const double*, Quaternion*, int, bool );
+template void eulersToQuaternions<Euler::YZX>( const double*, Quaternion*, int, bool );
+template void eulersToQuaternions<Euler::ZXY>( const double*, Quaternion*, int, bool );
+template void eulersToQuaternions<Euler::XZY>( const double*, Quaternion*, int, bool );
+template void eulersToQuaternions<Euler::YXZ>( const double*, Quaternion*, int, bool );
+template void eulersToQuaternions<Euler::ZYX>( const double*, Quaternion*, int, bool );
+
+} // namespace Rotation
+} // namespace three
@@ -0,0 +1,296 @@
+#ifndef THREE_ROTATION_H
+#define THREE_ROTATION_H
+
+#include <cmath>
+
+#include "math_forword_declar.h"
+#include "math.hpp"
+
+#include "euler.h"
+#include "quaternion.h"
+
+namespace three {
+
+class Matrix4;
+
+// Euler / quaternion / matrix conversions with the rotation order as a
+// template argument. Every `Order == ...` test below is a compile time
+// constant, so each instantiation is only the arithmetic of its order.
+// Euler::setFromRotationMatrix, Quaternion::setFromEuler and
+// Matrix4::makeRotationFromEuler switch on the order once and call these,
+// bulk code ( animation tracks, a fixed order per track ) calls them
+// directly or goes through the batches at the end.
+namespace Rotation {
+
+// Upper 3x3 of the rotation matrix, column-major like Matrix3, from
+// a, b = cos / sin x, c, d = cos / sin y and e, f = cos / sin z.
+template<Euler::RotationOrders Order>
+inline void matrixFromSinCos( const double& a, const double& b, const double& c, const double& d, const double& e, const double& f, double* m )
+{
+    if ( Order == Euler::XYZ ) {
+
+        double ae = a * e, af = a * f, be = b * e, bf = b * f;
+
+        m[ 0 ] = c * e;
+        m[ 3 ] = - c * f;
+        m[ 6 ] = d;
+
+        m[ 1 ] = af + be * d;
+        m[ 4 ] = ae - bf * d;
+        m[ 7 ] = - b * c;
+
+        m[ 2 ] = bf - ae * d;
+        m[ 5 ] = be + af * d;
+        m[ 8 ] = a * c;
+
+    } else if ( Order == Euler::YXZ ) {
+
+        double ce = c * e, cf = c * f, de = d * e, df = d * f;
+
+        m[ 0 ] = ce + df * b;
+        m[ 3 ] = de * b - cf;
+        m[ 6 ] = a * d;
+
+        m[ 1 ] = a * f;
+        m[ 4 ] = a * e;
+        m[ 7 ] = - b;
+
+        m[ 2 ] = cf * b - de;
+        m[ 5 ] = df + ce * b;
+        m[ 8 ] = a * c;
+
+    } else if ( Order == Euler::ZXY ) {
+
+        double ce = c * e, cf = c * f, de = d * e, df = d * f;
+
+        m[ 0 ] = ce - df * b;
+        m[ 3 ] = - a * f;
+        m[ 6 ] = de + cf * b;
+
+        m[ 1 ] = cf + de * b;
+        m[ 4 ] = a * e;
+        m[ 7 ] = df - ce * b;
+
+        m[ 2 ] = - a * d;
+        m[ 5 ] = b;
+        m[ 8 ] = a * c;
+
+    } else if ( Order == Euler::ZYX ) {
+
+        double ae = a * e, af = a * f, be = b * e, bf = b * f;
+
+        m[ 0 ] = c * e;
+        m[ 3 ] = be * d - af;
+        m[ 6 ] = ae * d + bf;
+
+        m[ 1 ] = c * f;
+        m[ 4 ] = bf * d + ae;
+        m[ 7 ] = af * d - be;
+
+        m[ 2 ] = - d;
+        m[ 5 ] = b * c;
+        m[ 8 ] = a * c;
+
+    } else if ( Order == Euler::YZX ) {
+
+        double ac = a * c, ad = a * d, bc = b * c, bd = b * d;
+
+        m[ 0 ] = c * e;
+        m[ 3 ] = bd - ac * f;
+        m[ 6 ] = bc * f + ad;
+
+        m[ 1 ] = f;
+        m[ 4 ] = a * e;
+        m[ 7 ] = - b * e;
+
+        m[ 2 ] = - d * e;
+        m[ 5 ] = ad * f + bc;
+        m[ 8 ] = ac - bd * f;
+
+    } else if ( Order == Euler::XZY ) {
+
+        double ac = a * c, ad = a * d, bc = b * c, bd = b * d;
+
+        m[ 0 ] = c * e;
+        m[ 3 ] = - f;
+        m[ 6 ] = d * e;
+
+        m[ 1 ] = ac * f + bd;
+        m[ 4 ] = a * e;
+        m[ 7 ] = ad * f - bc;
+
+        m[ 2 ] = bc * f - ad;
+        m[ 5 ] = b * e;
+        m[ 8 ] = bd * f + ac;
+
+    }
+}
+
+// Quaternion x, y, z, w from the cosines / sines of the half angles, see
+// http://www.mathworks.com/matlabcentral/fileexchange/
+// 	20696-function-to-convert-between-dcm-euler-angles-quaternions-and-euler-vectors/
+//	content/SpinCalc.m
+template<Euler::RotationOrders Order>
+inline void quaternionFromSinCos( const double& c1, const double& c2, const double& c3, const double& s1, const double& s2, const double& s3, double* q )
+{
+    // every order sums the same pairs of products, only the signs differ
+    double x0 = s1 * c2 * c3, x1 = c1 * s2 * s3;
+    double y0 = c1 * s2 * c3, y1 = s1 * c2 * s3;
+    double z0 = c1 * c2 * s3, z1 = s1 * s2 * c3;
+    double w0 = c1 * c2 * c3, w1 = s1 * s2 * s3;
+
+    const bool addX = Order == Euler::XYZ || Order == Euler::YXZ || Order == Euler::YZX;
+    const bool addY = Order == Euler::ZXY || Order == Euler::ZYX || Order == Euler::YZX;
+    const bool addZ = Order == Euler::XYZ || Order == Euler::ZXY || Order == Euler::XZY;
+    const bool addW = Order == Euler::YXZ || Order == Euler::ZYX || Order == Euler::XZY;
+
+    q[ 0 ] = addX ? x0 + x1 : x0 - x1;
+    q[ 1 ] = addY ? y0 + y1 : y0 - y1;
+    q[ 2 ] = addZ ? z0 + z1 : z0 - z1;
+    q[ 3 ] = addW ? w0 + w1 : w0 - w1;
+}
+
+// upper 3x3, column-major, of the rotation by the unit quaternion x, y, z, w
+inline void matrixFromQuaternion( const double& x, const double& y, const double& z, const double& w, double* m )
+{
+    double x2 = x + x, y2 = y + y, z2 = z + z;
+    double xx = x * x2, xy = x * y2, xz = x * z2;
+    double yy = y * y2, yz = y * z2, zz = z * z2;
+    double wx = w * x2, wy = w * y2, wz = w * z2;
+
+    m[ 0 ] = 1 - ( yy + zz );
+    m[ 3 ] = xy - wz;
+    m[ 6 ] = xz + wy;
+
+    m[ 1 ] = xy + wz;
+    m[ 4 ] = 1 - ( xx + zz );
+    m[ 7 ] = yz - wx;
+
+    m[ 2 ] = xz - wy;
+    m[ 5 ] = yz + wx;
+    m[ 8 ] = 1 - ( xx + yy );
+}
+
+// the 3x3 into the rotation part of te, the rest of te set to identity
+inline void setRotation( const double* m, Matrix4Elements& te )
+{
+    te[ 0 ] = m[ 0 ]; te[ 4 ] = m[ 3 ]; te[ 8 ] = m[ 6 ];  te[ 12 ] = 0;
+    te[ 1 ] = m[ 1 ]; te[ 5 ] = m[ 4 ]; te[ 9 ] = m[ 7 ];  te[ 13 ] = 0;
+    te[ 2 ] = m[ 2 ]; te[ 6 ] = m[ 5 ]; te[ 10 ] = m[ 8 ]; te[ 14 ] = 0;
+    te[ 3 ] = 0;      te[ 7 ] = 0;      te[ 11 ] = 0;      te[ 15 ] = 1;
+}
+
+template<Euler::RotationOrders Order>
+inline void eulerToMatrix( const double& x, const double& y, const double& z, Matrix4Elements& te )
+{
+    double m[ 9 ];
+    matrixFromSinCos<Order>( std::cos( x ), std::sin( x ), std::cos( y ), std::sin( y ),
+                             std::cos( z ), std::sin( z ), m );
+    setRotation( m, te );
+}
+
+template<Euler::RotationOrders Order>
+inline void eulerToQuaternion( const double& x, const double& y, const double& z, Quaternion& quaternion )
+{
+    double q[ 4 ];
+    quaternionFromSinCos<Order>( std::cos( x / 2 ), std::cos( y / 2 ), std::cos( z / 2 ),
+                                 std::sin( x / 2 ), std::sin( y / 2 ), std::sin( z / 2 ), q );
+    quaternion.set( q[ 0 ], q[ 1 ], q[ 2 ], q[ 3 ] );
+}
+
+// assumes the upper 3x3 of te is a pure rotation matrix (i.e, unscaled)
+template<Euler::RotationOrders Order>
+inline void matrixToEuler( const Matrix4Elements& te, double& x, double& y, double& z )
+{
+    auto clamp = Math::clamp<double>;
+
+    double m11 = te[ 0 ], m12 = te[ 4 ], m13 = te[ 8 ];
+    double m21 = te[ 1 ], m22 = te[ 5 ], m23 = te[ 9 ];
+    double m31 = te[ 2 ], m32 = te[ 6 ], m33 = te[ 10 ];
+
+    if ( Order == Euler::XYZ ) {
+        y = std::asin( clamp( m13, - 1, 1 ) );
+        if ( std::abs( m13 ) < 0.99999 ) {
+            x = std::atan2( - m23, m33 );
+            z = std::atan2( - m12, m11 );
+        } else {
+            x = std::atan2( m32, m22 );
+            z = 0;
+        }
+    } else if ( Order == Euler::YXZ ) {
+        x = std::asin( - clamp( m23, - 1, 1 ) );
+        if ( std::abs( m23 ) < 0.99999 ) {
+            y = std::atan2( m13, m33 );
+            z = std::atan2( m21, m22 );
+        } else {
+            y = std::atan2( - m31, m11 );
+            z = 0;
+        }
+    } else if ( Order == Euler::ZXY ) {
+        x = std::asin( clamp( m32, - 1, 1 ) );
+        if ( std::abs( m32 ) < 0.99999 ) {
+            y = std::atan2( - m31, m33 );
+            z = std::atan2( - m12, m22 );
+        } else {
+            y = 0;
+            z = std::atan2( m21, m11 );
+        }
+    } else if ( Order == Euler::ZYX ) {
+        y = std::asin( - clamp( m31, - 1, 1 ) );
+        if ( std::abs( m31 ) < 0.99999 ) {
+            x = std::atan2( m32, m33 );
+            z = std::atan2( m21, m11 );
+        } else {
+            x = 0;
+            z = std::atan2( - m12, m22 );
+        }
+    } else if ( Order == Euler::YZX ) {
+        z = std::asin( clamp( m21, - 1, 1 ) );
+        if ( std::abs( m21 ) < 0.99999 ) {
+            x = std::atan2( - m23, m22 );
+            y = std::atan2( - m31, m11 );
+        } else {
+            x = 0;
+            y = std::atan2( m13, m33 );
+        }
+    } else if ( Order == Euler::XZY ) {
+        z = std::asin( - clamp( m12, - 1, 1 ) );
+        if ( std::abs( m12 ) < 0.99999 ) {
+            x = std::atan2( m32, m22 );
+            y = std::atan2( m13, m11 );
+        } else {
+            x = std::atan2( - m23, m33 );
+            y = 0;
+        }
+    }
+}
+
+// Batches over count rotations, the order resolved once per batch and the
+// loop body straight line code. `angles` holds x, y, z per rotation ( the
+// layout of a Vector3Array or of Euler keyframe values ), `parallel` splits
+// large batches across the global thread pool. The results are the same as
+// converting one by one.
+
+template<Euler::RotationOrders Order>
+void eulersToMatrices( const double* angles, Matrix4* matrices, int count, bool parallel = false );
+
+template<Euler::RotationOrders Order>
+void eulersToQuaternions( const double* angles, Quaternion* quaternions, int count, bool parallel = false );
+
+// the order known only at run time, one switch per batch
+void eulersToMatrices( const Euler::RotationOrders& order, const double* angles, Matrix4* matrices, int count,
+                       bool parallel = false );
+
+void eulersToQuaternions( const Euler::RotationOrders& order, const double* angles, Quaternion* quaternions, int count,
+                          bool parallel = false );
+
+// each run of Eulers with the same order goes through its kernel
+void eulersToMatrices( const Euler* eulers, Matrix4* matrices, int count, bool parallel = false );
+
+void quaternionsToMatrices( const Quaternion* quaternions, Matrix4* matrices, int count, bool parallel = false );
+
+} // namespace Rotation
+
+} // namespace three
+
+#endif // THREE_ROTATION_H
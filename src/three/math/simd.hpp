@@ -0,0 +1,229 @@
+#ifndef THREE_SIMD_HPP
+#define THREE_SIMD_HPP
+
+// Compile time selection of the vector instruction set used by the batch
+// kernels ( Matrix4::multiplyMatrices, ... ). Every kernel keeps a scalar
+// fallback, define THREE_NO_SIMD to force it.
+//
+// The kernels multiply and add separately, in the order of their scalar
+// twins, and give the same results bit for bit only as long as the compiler
+// does not fuse a * b + c of the scalar code into an FMA. src.pri turns
+// floating point contraction off for that.
+
+#include <cmath>
+
+#if !defined(THREE_NO_SIMD)
+
+#  if defined(__AVX__)
+#    define THREE_SIMD_AVX
+#    include <immintrin.h>
+#  endif
+
+#  if defined(__SSE2__) || defined(_M_X64) || ( defined(_M_IX86_FP) && _M_IX86_FP >= 2 )
+#    define THREE_SIMD_SSE2
+#    include <emmintrin.h>
+#  endif
+
+#  if defined(__ARM_NEON) && defined(__aarch64__)
+#    define THREE_SIMD_NEON
+#    include <arm_neon.h>
+#  endif
+
+#endif
+
+namespace three {
+namespace Simd {
+
+// A register of `DoubleLanes` doubles, the widest one the target supports.
+// Kernels written against these wrappers run unchanged on every target,
+// a comparison yields a lane mask ( all bits set where true ), and_ / or_ /
+// select / movemask expect such masks.
+//
+// VFloat holds `FloatLanes` floats in a register of the same width and has
+// the same operations as overloads, only the broadcast is named set1f so
+// set1( 1 ) stays unambiguous.
+
+#if defined(THREE_SIMD_AVX)
+
+typedef __m256d VDouble;
+static const int DoubleLanes = 4;
+
+inline VDouble load( const double* p ) { return _mm256_loadu_pd( p ); }
+inline void store( double* p, VDouble a ) { _mm256_storeu_pd( p, a ); }
+inline VDouble set1( double v ) { return _mm256_set1_pd( v ); }
+inline VDouble add( VDouble a, VDouble b ) { return _mm256_add_pd( a, b ); }
+inline VDouble sub( VDouble a, VDouble b ) { return _mm256_sub_pd( a, b ); }
+inline VDouble mul( VDouble a, VDouble b ) { return _mm256_mul_pd( a, b ); }
+inline VDouble div( VDouble a, VDouble b ) { return _mm256_div_pd( a, b ); }
+inline VDouble min( VDouble a, VDouble b ) { return _mm256_min_pd( a, b ); }
+inline VDouble max( VDouble a, VDouble b ) { return _mm256_max_pd( a, b ); }
+inline VDouble sqrt( VDouble a ) { return _mm256_sqrt_pd( a ); }
+inline VDouble cmplt( VDouble a, VDouble b ) { return _mm256_cmp_pd( a, b, _CMP_LT_OQ ); }
+inline VDouble cmple( VDouble a, VDouble b ) { return _mm256_cmp_pd( a, b, _CMP_LE_OQ ); }
+inline VDouble and_( VDouble a, VDouble b ) { return _mm256_and_pd( a, b ); }
+inline VDouble or_( VDouble a, VDouble b ) { return _mm256_or_pd( a, b ); }
+// mask ? b : a
+inline VDouble select( VDouble mask, VDouble a, VDouble b ) { return _mm256_blendv_pd( a, b, mask ); }
+inline int movemask( VDouble mask ) { return _mm256_movemask_pd( mask ); }
+
+typedef __m256 VFloat;
+static const int FloatLanes = 8;
+
+inline VFloat load( const float* p ) { return _mm256_loadu_ps( p ); }
+inline void store( float* p, VFloat a ) { _mm256_storeu_ps( p, a ); }
+inline VFloat set1f( float v ) { return _mm256_set1_ps( v ); }
+inline VFloat add( VFloat a, VFloat b ) { return _mm256_add_ps( a, b ); }
+inline VFloat sub( VFloat a, VFloat b ) { return _mm256_sub_ps( a, b ); }
+inline VFloat mul( VFloat a, VFloat b ) { return _mm256_mul_ps( a, b ); }
+inline VFloat div( VFloat a, VFloat b ) { return _mm256_div_ps( a, b ); }
+inline VFloat min( VFloat a, VFloat b ) { return _mm256_min_ps( a, b ); }
+inline VFloat max( VFloat a, VFloat b ) { return _mm256_max_ps( a, b ); }
+inline VFloat sqrt( VFloat a ) { return _mm256_sqrt_ps( a ); }
+inline VFloat cmplt( VFloat a, VFloat b ) { return _mm256_cmp_ps( a, b, _CMP_LT_OQ ); }
+inline VFloat cmple( VFloat a, VFloat b ) { return _mm256_cmp_ps( a, b, _CMP_LE_OQ ); }
+inline VFloat and_( VFloat a, VFloat b ) { return _mm256_and_ps( a, b ); }
+inline VFloat or_( VFloat a, VFloat b ) { return _mm256_or_ps( a, b ); }
+inline VFloat select( VFloat mask, VFloat a, VFloat b ) { return _mm256_blendv_ps( a, b, mask ); }
+inline int movemask( VFloat mask ) { return _mm256_movemask_ps( mask ); }
+
+#elif defined(THREE_SIMD_SSE2)
+
+typedef __m128d VDouble;
+static const int DoubleLanes = 2;
+
+inline VDouble load( const double* p ) { return _mm_loadu_pd( p ); }
+inline void store( double* p, VDouble a ) { _mm_storeu_pd( p, a ); }
+inline VDouble set1( double v ) { return _mm_set1_pd( v ); }
+inline VDouble add( VDouble a, VDouble b ) { return _mm_add_pd( a, b ); }
+inline VDouble sub( VDouble a, VDouble b ) { return _mm_sub_pd( a, b ); }
+inline VDouble mul( VDouble a, VDouble b ) { return _mm_mul_pd( a, b ); }
+inline VDouble div( VDouble a, VDouble b ) { return _mm_div_pd( a, b ); }
+inline VDouble min( VDouble a, VDouble b ) { return _mm_min_pd( a, b ); }
+inline VDouble max( VDouble a, VDouble b ) { return _mm_max_pd( a, b ); }
+inline VDouble sqrt( VDouble a ) { return _mm_sqrt_pd( a ); }
+inline VDouble cmplt( VDouble a, VDouble b ) { return _mm_cmplt_pd( a, b ); }
+inline VDouble cmple( VDouble a, VDouble b ) { return _mm_cmple_pd( a, b ); }
+inline VDouble and_( VDouble a, VDouble b ) { return _mm_and_pd( a, b ); }
+inline VDouble or_( VDouble a, VDouble b ) { return _mm_or_pd( a, b ); }
+inline VDouble select( VDouble mask, VDouble a, VDouble b ) { return _mm_or_pd( _mm_andnot_pd( mask, a ), _mm_and_pd( mask, b ) ); }
+inline int movemask( VDouble mask ) { return _mm_movemask_pd( mask ); }
+
+typedef __m128 VFloat;
+static const int FloatLanes = 4;
+
+inline VFloat load( const float* p ) { return _mm_loadu_ps( p ); }
+inline void store( float* p, VFloat a ) { _mm_storeu_ps( p, a ); }
+inline VFloat set1f( float v ) { return _mm_set1_ps( v ); }
+inline VFloat add( VFloat a, VFloat b ) { return _mm_add_ps( a, b ); }
+inline VFloat sub( VFloat a, VFloat b ) { return _mm_sub_ps( a, b ); }
+inline VFloat mul( VFloat a, VFloat b ) { return _mm_mul_ps( a, b ); }
+inline VFloat div( VFloat a, VFloat b ) { return _mm_div_ps( a, b ); }
+inline VFloat min( VFloat a, VFloat b ) { return _mm_min_ps( a, b ); }
+inline VFloat max( VFloat a, VFloat b ) { return _mm_max_ps( a, b ); }
+inline VFloat sqrt( VFloat a ) { return _mm_sqrt_ps( a ); }
+inline VFloat cmplt( VFloat a, VFloat b ) { return _mm_cmplt_ps( a, b ); }
+inline VFloat cmple( VFloat a, VFloat b ) { return _mm_cmple_ps( a, b ); }
+inline VFloat and_( VFloat a, VFloat b ) { return _mm_and_ps( a, b ); }
+inline VFloat or_( VFloat a, VFloat b ) { return _mm_or_ps( a, b ); }
+inline VFloat select( VFloat mask, VFloat a, VFloat b ) { return _mm_or_ps( _mm_andnot_ps( mask, a ), _mm_and_ps( mask, b ) ); }
+inline int movemask( VFloat mask ) { return _mm_movemask_ps( mask ); }
+
+#elif defined(THREE_SIMD_NEON)
+
+typedef float64x2_t VDouble;
+static const int DoubleLanes = 2;
+
+inline VDouble load( const double* p ) { return vld1q_f64( p ); }
+inline void store( double* p, VDouble a ) { vst1q_f64( p, a ); }
+inline VDouble set1( double v ) { return vdupq_n_f64( v ); }
+inline VDouble add( VDouble a, VDouble b ) { return vaddq_f64( a, b ); }
+inline VDouble sub( VDouble a, VDouble b ) { return vsubq_f64( a, b ); }
+inline VDouble mul( VDouble a, VDouble b ) { return vmulq_f64( a, b ); }
+inline VDouble div( VDouble a, VDouble b ) { return vdivq_f64( a, b ); }
+inline VDouble min( VDouble a, VDouble b ) { return vminq_f64( a, b ); }
+inline VDouble max( VDouble a, VDouble b ) { return vmaxq_f64( a, b ); }
+inline VDouble sqrt( VDouble a ) { return vsqrtq_f64( a ); }
+inline VDouble cmplt( VDouble a, VDouble b ) { return vreinterpretq_f64_u64( vcltq_f64( a, b ) ); }
+inline VDouble cmple( VDouble a, VDouble b ) { return vreinterpretq_f64_u64( vcleq_f64( a, b ) ); }
+inline VDouble and_( VDouble a, VDouble b ) { return vreinterpretq_f64_u64( vandq_u64( vreinterpretq_u64_f64( a ), vreinterpretq_u64_f64( b ) ) ); }
+inline VDouble or_( VDouble a, VDouble b ) { return vreinterpretq_f64_u64( vorrq_u64( vreinterpretq_u64_f64( a ), vreinterpretq_u64_f64( b ) ) ); }
+inline VDouble select( VDouble mask, VDouble a, VDouble b ) { return vbslq_f64( vreinterpretq_u64_f64( mask ), b, a ); }
+inline int movemask( VDouble mask )
+{
+    uint64x2_t m = vreinterpretq_u64_f64( mask );
+    return int( vgetq_lane_u64( m, 0 ) >> 63 ) | ( int( vgetq_lane_u64( m, 1 ) >> 63 ) << 1 );
+}
+
+typedef float32x4_t VFloat;
+static const int FloatLanes = 4;
+
+inline VFloat load( const float* p ) { return vld1q_f32( p ); }
+inline void store( float* p, VFloat a ) { vst1q_f32( p, a ); }
+inline VFloat set1f( float v ) { return vdupq_n_f32( v ); }
+inline VFloat add( VFloat a, VFloat b ) { return vaddq_f32( a, b ); }
+inline VFloat sub( VFloat a, VFloat b ) { return vsubq_f32( a, b ); }
+inline VFloat mul( VFloat a, VFloat b ) { return vmulq_f32( a, b ); }
+inline VFloat div( VFloat a, VFloat b ) { return vdivq_f32( a, b ); }
+inline VFloat min( VFloat a, VFloat b ) { return vminq_f32( a, b ); }
+inline VFloat max( VFloat a, VFloat b ) { return vmaxq_f32( a, b ); }
+inline VFloat sqrt( VFloat a ) { return vsqrtq_f32( a ); }
+inline VFloat cmplt( VFloat a, VFloat b ) { return vreinterpretq_f32_u32( vcltq_f32( a, b ) ); }
+inline VFloat cmple( VFloat a, VFloat b ) { return vreinterpretq_f32_u32( vcleq_f32( a, b ) ); }
+inline VFloat and_( VFloat a, VFloat b ) { return vreinterpretq_f32_u32( vandq_u32( vreinterpretq_u32_f32( a ), vreinterpretq_u32_f32( b ) ) ); }
+inline VFloat or_( VFloat a, VFloat b ) { return vreinterpretq_f32_u32( vorrq_u32( vreinterpretq_u32_f32( a ), vreinterpretq_u32_f32( b ) ) ); }
+inline VFloat select( VFloat mask, VFloat a, VFloat b ) { return vbslq_f32( vreinterpretq_u32_f32( mask ), b, a ); }
+inline int movemask( VFloat mask )
+{
+    uint32x4_t m = vshrq_n_u32( vreinterpretq_u32_f32( mask ), 31 );
+    return int( vgetq_lane_u32( m, 0 ) ) | ( int( vgetq_lane_u32( m, 1 ) ) << 1 ) |
+           ( int( vgetq_lane_u32( m, 2 ) ) << 2 ) | ( int( vgetq_lane_u32( m, 3 ) ) << 3 );
+}
+
+#else
+
+struct VDouble { double v; };
+static const int DoubleLanes = 1;
+
+inline VDouble load( const double* p ) { VDouble r = { *p }; return r; }
+inline void store( double* p, VDouble a ) { *p = a.v; }
+inline VDouble set1( double v ) { VDouble r = { v }; return r; }
+inline VDouble add( VDouble a, VDouble b ) { VDouble r = { a.v + b.v }; return r; }
+inline VDouble sub( VDouble a, VDouble b ) { VDouble r = { a.v - b.v }; return r; }
+inline VDouble mul( VDouble a, VDouble b ) { VDouble r = { a.v * b.v }; return r; }
+inline VDouble div( VDouble a, VDouble b ) { VDouble r = { a.v / b.v }; return r; }
+inline VDouble min( VDouble a, VDouble b ) { VDouble r = { b.v < a.v ? b.v : a.v }; return r; }
+inline VDouble max( VDouble a, VDouble b ) { VDouble r = { a.v < b.v ? b.v : a.v }; return r; }
+inline VDouble sqrt( VDouble a ) { VDouble r = { std::sqrt( a.v ) }; return r; }
+inline VDouble cmplt( VDouble a, VDouble b ) { VDouble r = { a.v < b.v ? -1.0 : 0.0 }; return r; }
+inline VDouble cmple( VDouble a, VDouble b ) { VDouble r = { a.v <= b.v ? -1.0 : 0.0 }; return r; }
+inline VDouble and_( VDouble a, VDouble b ) { VDouble r = { ( a.v != 0 && b.v != 0 ) ? -1.0 : 0.0 }; return r; }
+inline VDouble or_( VDouble a, VDouble b ) { VDouble r = { ( a.v != 0 || b.v != 0 ) ? -1.0 : 0.0 }; return r; }
+inline VDouble select( VDouble mask, VDouble a, VDouble b ) { return mask.v != 0 ? b : a; }
+inline int movemask( VDouble mask ) { return mask.v != 0 ? 1 : 0; }
+
+struct VFloat { float v; };
+static const int FloatLanes = 1;
+
+inline VFloat load( const float* p ) { VFloat r = { *p }; return r; }
+inline void store( float* p, VFloat a ) { *p = a.v; }
+inline VFloat set1f( float v ) { VFloat r = { v }; return r; }
+inline VFloat add( VFloat a, VFloat b ) { VFloat r = { a.v + b.v }; return r; }
+inline VFloat sub( VFloat a, VFloat b ) { VFloat r = { a.v - b.v }; return r; }
+inline VFloat mul( VFloat a, VFloat b ) { VFloat r = { a.v * b.v }; return r; }
+inline VFloat div( VFloat a, VFloat b ) { VFloat r = { a.v / b.v }; return r; }
+inline VFloat min( VFloat a, VFloat b ) { VFloat r = { b.v < a.v ? b.v : a.v }; return r; }
+inline VFloat max( VFloat a, VFloat b ) { VFloat r = { a.v < b.v ? b.v : a.v }; return r; }
+inline VFloat sqrt( VFloat a ) { VFloat r = { std::sqrt( a.v ) }; return r; }
+inline VFloat cmplt( VFloat a, VFloat b ) { VFloat r = { a.v < b.v ? -1.0f : 0.0f }; return r; }
+inline VFloat cmple( VFloat a, VFloat b ) { VFloat r = { a.v <= b.v ? -1.0f : 0.0f }; return r; }
+inline VFloat and_( VFloat a, VFloat b ) { VFloat r = { ( a.v != 0 && b.v != 0 ) ? -1.0f : 0.0f }; return r; }
+inline VFloat or_( VFloat a, VFloat b ) { VFloat r = { ( a.v != 0 || b.v != 0 ) ? -1.0f : 0.0f }; return r; }
+inline VFloat select( VFloat mask, VFloat a, VFloat b ) { return mask.v != 0 ? b : a; }
+inline int movemask( VFloat mask ) { return mask.v != 0 ? 1 : 0; }
+
+#endif
+
+} // namespace Simd
+} // namespace three
+
+#endif // THREE_SIMD_HPP
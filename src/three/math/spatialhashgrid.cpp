@@ -0,0 +1,325 @@
+#include "spatialhashgrid.h"
+
+#include <algorithm>
+
+#include "parallel.hpp"
+
+namespace three {
+
+namespace {
+
+// cell coordinates are clamped to 21 bits each, packed into one key
+const int CellBits = 21;
+const int CellLimit = 1 << ( CellBits - 1 );
+
+const int CellsPerTask = 1 << 10;
+
+inline int cellOf( const double& value, const double& inverseSize )
+{
+    double cell = std::floor( value * inverseSize );
+    return int( std::min( std::max( cell, double( - CellLimit ) ), double( CellLimit - 1 ) ) );
+}
+
+inline quint64 keyOf( const int& x, const int& y, const int& z )
+{
+    const quint64 mask = ( quint64( 1 ) << CellBits ) - 1;
+    return ( quint64( x + CellLimit ) & mask ) << ( 2 * CellBits )
+         | ( quint64( y + CellLimit ) & mask ) << CellBits
+         | ( quint64( z + CellLimit ) & mask );
+}
+
+inline bool overlaps( const SpatialHashGrid::Proxy& a, const SpatialHashGrid::Proxy& b )
+{
+    if ( !a.bounds.intersectsBox( b.bounds ) )
+        return false;
+
+    if ( a.sphere.radius >= 0 ) {
+        return b.sphere.radius >= 0 ? a.sphere.intersectsSphere( b.sphere ) : b.bounds.intersectsSphere( a.sphere );
+    }
+    return b.sphere.radius >= 0 ? a.bounds.intersectsSphere( b.sphere ) : true;
+}
+
+// whether cell is the first cell a and b have in common
+inline bool owns( const int coordinates[ 3 ], const int aMin[ 3 ], const int bMin[ 3 ] )
+{
+    return coordinates[ 0 ] == std::max( aMin[ 0 ], bMin[ 0 ] )
+        && coordinates[ 1 ] == std::max( aMin[ 1 ], bMin[ 1 ] )
+        && coordinates[ 2 ] == std::max( aMin[ 2 ], bMin[ 2 ] );
+}
+
+} // namespace
+
+SpatialHashGrid::SpatialHashGrid(const double &cellSize):
+    size( cellSize ),
+    inverseSize( 1 / cellSize )
+{
+    Q_ASSERT( cellSize > 0 );
+}
+
+SpatialHashGrid::ProxyId SpatialHashGrid::insert(const Box3 &box)
+{
+    return this->insert( box, Sphere( Vector3(), -1 ) );
+}
+
+SpatialHashGrid::ProxyId SpatialHashGrid::insert(const Sphere &sphere)
+{
+    Box3 box;
+    sphere.getBoundingBox( box );
+    return this->insert( box, sphere );
+}
+
+void SpatialHashGrid::move(const ProxyId &proxy, const Box3 &box)
+{
+    this->move( proxy, box, Sphere( Vector3(), -1 ) );
+}
+
+void SpatialHashGrid::move(const ProxyId &proxy, const Sphere &sphere)
+{
+    Box3 box;
+    sphere.getBoundingBox( box );
+    this->move( proxy, box, sphere );
+}
+
+void SpatialHashGrid::remove(const ProxyId &proxy)
+{
+    Q_ASSERT( proxy >= 0 && proxy < this->proxies.size() );
+    Q_ASSERT( this->proxies[ proxy ].min[ 0 ] <= this->proxies[ proxy ].max[ 0 ] );
+
+    this->removeFromCells( proxy );
+
+    Proxy& removed = this->proxies[ proxy ];
+    removed.min[ 0 ] = 1;
+    removed.max[ 0 ] = 0;
+    this->freeProxies.append( proxy );
+}
+
+void SpatialHashGrid::clear()
+{
+    this->proxies.clear();
+    this->freeProxies.clear();
+    this->cells.clear();
+    this->freeCells.clear();
+    this->cellIndex.clear();
+}
+
+void SpatialHashGrid::query(const Box3 &box, QVector<ProxyId> &result) const
+{
+    Proxy volume;
+    this->setVolume( volume, box, Sphere( Vector3(), -1 ) );
+    this->query( volume, result );
+}
+
+void SpatialHashGrid::query(const Sphere &sphere, QVector<ProxyId> &result) const
+{
+    Proxy volume;
+    Box3 box;
+    sphere.getBoundingBox( box );
+    this->setVolume( volume, box, sphere );
+    this->query( volume, result );
+}
+
+void SpatialHashGrid::findPairs(QVector<Pair> &pairs, const bool &parallel)
+{
+    pairs.resize( 0 );
+
+    int tasks = ( this->cells.size() + CellsPerTask - 1 ) / CellsPerTask;
+    if ( !parallel || tasks <= 1 ) {
+        this->findPairs( 0, this->cells.size(), pairs );
+        return;
+    }
+
+    // one output per task, joined in task order
+    if ( this->taskPairs.size() < tasks ) {
+        this->taskPairs.resize( tasks );
+    }
+    QVector<Pair>* outputs = this->taskPairs.data();
+
+    Parallel::forRange( tasks, 1, [&]( int begin, int end ) {
+        for ( int task = begin; task < end; task ++ ) {
+            outputs[ task ].resize( 0 );
+            this->findPairs( task * CellsPerTask, std::min( ( task + 1 ) * CellsPerTask, this->cells.size() ), outputs[ task ] );
+        }
+    } );
+
+    int count = 0;
+    for ( int task = 0; task < tasks; task ++ ) {
+        count += outputs[ task ].size();
+    }
+    pairs.reserve( count );
+    for ( int task = 0; task < tasks; task ++ ) {
+        pairs += outputs[ task ];
+    }
+}
+
+void SpatialHashGrid::setVolume(Proxy &proxy, const Box3 &box, const Sphere &sphere) const
+{
+    Q_ASSERT( !box.isEmpty() );
+
+    proxy.bounds = box;
+    proxy.sphere = sphere;
+
+    proxy.min[ 0 ] = cellOf( box.min.x, this->inverseSize );
+    proxy.min[ 1 ] = cellOf( box.min.y, this->inverseSize );
+    proxy.min[ 2 ] = cellOf( box.min.z, this->inverseSize );
+    proxy.max[ 0 ] = cellOf( box.max.x, this->inverseSize );
+    proxy.max[ 1 ] = cellOf( box.max.y, this->inverseSize );
+    proxy.max[ 2 ] = cellOf( box.max.z, this->inverseSize );
+}
+
+SpatialHashGrid::ProxyId SpatialHashGrid::insert(const Box3 &box, const Sphere &sphere)
+{
+    ProxyId id;
+    if ( !this->freeProxies.isEmpty() ) {
+        id = this->freeProxies.takeLast();
+    } else {
+        id = this->proxies.size();
+        this->proxies.append( Proxy() );
+    }
+
+    this->setVolume( this->proxies[ id ], box, sphere );
+    this->addToCells( id );
+    return id;
+}
+
+void SpatialHashGrid::move(const ProxyId &id, const Box3 &box, const Sphere &sphere)
+{
+    Q_ASSERT( id >= 0 && id < this->proxies.size() );
+    Q_ASSERT( this->proxies[ id ].min[ 0 ] <= this->proxies[ id ].max[ 0 ] );
+
+    Proxy moved;
+    this->setVolume( moved, box, sphere );
+
+    Proxy& proxy = this->proxies[ id ];
+    if ( std::equal( moved.min, moved.min + 3, proxy.min ) && std::equal( moved.max, moved.max + 3, proxy.max ) ) {
+        proxy.bounds = moved.bounds;
+        proxy.sphere = moved.sphere;
+        return;
+    }
+
+    this->removeFromCells( id );
+    this->proxies[ id ] = moved;
+    this->addToCells( id );
+}
+
+void SpatialHashGrid::addToCells(const ProxyId &id)
+{
+    const Proxy& proxy = this->proxies[ id ];
+
+    for ( int x = proxy.min[ 0 ]; x <= proxy.max[ 0 ]; x ++ ) {
+        for ( int y = proxy.min[ 1 ]; y <= proxy.max[ 1 ]; y ++ ) {
+            for ( int z = proxy.min[ 2 ]; z <= proxy.max[ 2 ]; z ++ ) {
+                quint64 key = keyOf( x, y, z );
+
+                int cell = this->cellIndex.value( key, -1 );
+                if ( cell < 0 ) {
+                    if ( !this->freeCells.isEmpty() ) {
+                        cell = this->freeCells.takeLast();
+                    } else {
+                        cell = this->cells.size();
+                        this->cells.append( Cell() );
+                    }
+
+                    Cell& created = this->cells[ cell ];
+                    created.coordinates[ 0 ] = x;
+                    created.coordinates[ 1 ] = y;
+                    created.coordinates[ 2 ] = z;
+                    this->cellIndex.insert( key, cell );
+                }
+
+                this->cells[ cell ].proxies.append( id );
+            }
+        }
+    }
+}
+
+void SpatialHashGrid::removeFromCells(const ProxyId &id)
+{
+    const Proxy& proxy = this->proxies[ id ];
+
+    for ( int x = proxy.min[ 0 ]; x <= proxy.max[ 0 ]; x ++ ) {
+        for ( int y = proxy.min[ 1 ]; y <= proxy.max[ 1 ]; y ++ ) {
+            for ( int z = proxy.min[ 2 ]; z <= proxy.max[ 2 ]; z ++ ) {
+                quint64 key = keyOf( x, y, z );
+
+                int cell = this->cellIndex.value( key, -1 );
+                Q_ASSERT( cell >= 0 );
+
+                // unordered, swap with the last one
+                QVector<ProxyId>& list = this->cells[ cell ].proxies;
+                int at = list.indexOf( id );
+                Q_ASSERT( at >= 0 );
+                list[ at ] = list.last();
+                list.removeLast();
+
+                if ( list.isEmpty() ) {
+                    this->cellIndex.remove( key );
+                    this->freeCells.append( cell );
+                }
+            }
+        }
+    }
+}
+
+void SpatialHashGrid::query(const Proxy &volume, QVector<ProxyId> &result) const
+{
+    qint64 range = qint64( volume.max[ 0 ] - volume.min[ 0 ] + 1 )
+                 * ( volume.max[ 1 ] - volume.min[ 1 ] + 1 )
+                 * ( volume.max[ 2 ] - volume.min[ 2 ] + 1 );
+
+    auto visit = [&]( const Cell& cell ) {
+        for ( int i = 0; i < cell.proxies.size(); i ++ ) {
+            const Proxy& proxy = this->proxies[ cell.proxies[ i ] ];
+            if ( owns( cell.coordinates, volume.min, proxy.min ) && overlaps( volume, proxy ) ) {
+                result.append( cell.proxies[ i ] );
+            }
+        }
+    };
+
+    // a large query walks the occupied cells instead of its range
+    if ( range > this->cells.size() ) {
+        for ( int c = 0; c < this->cells.size(); c ++ ) {
+            const Cell& cell = this->cells[ c ];
+            bool inside = true;
+            for ( int a = 0; a < 3; a ++ ) {
+                inside = inside && cell.coordinates[ a ] >= volume.min[ a ] && cell.coordinates[ a ] <= volume.max[ a ];
+            }
+            if ( inside ) {
+                visit( cell );
+            }
+        }
+        return;
+    }
+
+    for ( int x = volume.min[ 0 ]; x <= volume.max[ 0 ]; x ++ ) {
+        for ( int y = volume.min[ 1 ]; y <= volume.max[ 1 ]; y ++ ) {
+            for ( int z = volume.min[ 2 ]; z <= volume.max[ 2 ]; z ++ ) {
+                QHash<quint64, int>::const_iterator cell = this->cellIndex.constFind( keyOf( x, y, z ) );
+                if ( cell != this->cellIndex.constEnd() ) {
+                    visit( this->cells[ cell.value() ] );
+                }
+            }
+        }
+    }
+}
+
+void SpatialHashGrid::findPairs(const int &firstCell, const int &lastCell, QVector<Pair> &pairs) const
+{
+    for ( int c = firstCell; c < lastCell; c ++ ) {
+        const Cell& cell = this->cells[ c ];
+        const ProxyId* ids = cell.proxies.constData();
+        int count = cell.proxies.size();
+
+        for ( int i = 0; i < count; i ++ ) {
+            const Proxy& a = this->proxies[ ids[ i ] ];
+            for ( int j = i + 1; j < count; j ++ ) {
+                const Proxy& b = this->proxies[ ids[ j ] ];
+                if ( owns( cell.coordinates, a.min, b.min ) && overlaps( a, b ) ) {
+                    Pair pair = { std::min( ids[ i ], ids[ j ] ), std::max( ids[ i ], ids[ j ] ) };
+                    pairs.append( pair );
+                }
+            }
+        }
+    }
+}
+
+} // namespace three
@@ -0,0 +1,120 @@
+#ifndef THREE_SPATIALHASHGRID_H
+#define THREE_SPATIALHASHGRID_H
+
+#include <QHash>
+#include <QVector>
+
+#include "math_forword_declar.h"
+
+#include "box3.h"
+#include "sphere.h"
+
+namespace three {
+
+class Box3;
+class Sphere;
+
+// Broadphase over moving boxes and spheres: a uniform grid of cubic cells
+// of which only the occupied ones are stored, in a hash from the cell
+// coordinates. A volume is listed in every cell its bounding box touches.
+//
+// The cell size should be about the size of a typical volume. A volume much
+// larger than a cell is listed in many cells, slowing everything down.
+//
+// A pair or query result is reported from exactly one of the cells it has
+// in common, the one with the lowest coordinates, so there is no
+// deduplication and no state per query. After a first run has grown the
+// output vectors, findPairs() and query() do not allocate.
+class SpatialHashGrid
+{
+public:
+    typedef int ProxyId;
+
+    struct Pair
+    {
+        ProxyId a;  // a < b
+        ProxyId b;
+    };
+
+    explicit SpatialHashGrid( const double& cellSize = 1 );
+
+    double cellSize() const
+    {
+        return this->size;
+    }
+
+    // number of volumes in the grid
+    int count() const
+    {
+        return this->proxies.size() - this->freeProxies.size();
+    }
+
+    // Ids of removed volumes are reused.
+    ProxyId insert( const Box3& box );
+
+    ProxyId insert( const Sphere& sphere );
+
+    // Only touches the cells when the volume moved to other cells. A volume
+    // may change between a box and a sphere.
+    void move( const ProxyId& proxy, const Box3& box );
+
+    void move( const ProxyId& proxy, const Sphere& sphere );
+
+    void remove( const ProxyId& proxy );
+
+    void clear();
+
+    // Appends the volumes overlapping box / sphere to result. Spheres are
+    // tested as spheres, not by their bounding boxes.
+    void query( const Box3& box, QVector<ProxyId>& result ) const;
+
+    void query( const Sphere& sphere, QVector<ProxyId>& result ) const;
+
+    // Replaces pairs with all overlapping pairs, ordered by cell. The
+    // parallel version splits the cells over the global thread pool and
+    // gives the same pairs in the same order.
+    void findPairs( QVector<Pair>& pairs, const bool& parallel = false );
+
+    // private:
+    struct Proxy
+    {
+        Box3    bounds;
+        Sphere  sphere;     // radius < 0 for boxes
+        int     min[ 3 ];   // cell range, min[ 0 ] > max[ 0 ] for removed proxies
+        int     max[ 3 ];
+    };
+
+    struct Cell
+    {
+        int                 coordinates[ 3 ];
+        QVector<ProxyId>    proxies;    // empty for unused cells
+    };
+
+    double                  size;
+    double                  inverseSize;
+    QVector<Proxy>          proxies;
+    QVector<ProxyId>        freeProxies;
+    QVector<Cell>           cells;
+    QVector<int>            freeCells;
+    QHash<quint64, int>     cellIndex;  // packed coordinates -> cells
+    QVector<QVector<Pair> > taskPairs;  // per task output of findPairs, kept for its capacity
+
+private:
+    void setVolume( Proxy& proxy, const Box3& box, const Sphere& sphere ) const;
+
+    ProxyId insert( const Box3& box, const Sphere& sphere );
+
+    void move( const ProxyId& id, const Box3& box, const Sphere& sphere );
+
+    void addToCells( const ProxyId& id );
+
+    void removeFromCells( const ProxyId& id );
+
+    void query( const Proxy& volume, QVector<ProxyId>& result ) const;
+
+    void findPairs( const int& firstCell, const int& lastCell, QVector<Pair>& pairs ) const;
+};
+
+} // namespace three
+
+#endif // THREE_SPATIALHASHGRID_H
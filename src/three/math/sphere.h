@@ -91,7 +91,7 @@ public:
         return ( point.distanceTo( this->center ) - this->radius );
     }
 
-    double intersectsSphere( const Sphere& sphere ) const
+    bool intersectsSphere( const Sphere& sphere ) const
     {
         double radiusSum = this->radius + sphere.radius;
         return sphere.center.distanceToSquared( this->center ) <= ( radiusSum * radiusSum );
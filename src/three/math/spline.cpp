@@ -1,7 +1,324 @@
 #include "spline.h"
 
+#include <algorithm>
+
+#include "simd.hpp"
+#include "parallel.hpp"
+
 namespace three {
 
+namespace {
 
-} // namespace three
+const int PointsPerTask = 1 << 14;
+const int PointsPerTile = 64;
+
+// Spline::interpolate split into the part that only depends on the segment,
+// v = ( a * t3 + b * t2 + c * t + d ) evaluates in the same order
+struct SegmentCoefficients
+{
+    double a[ 3 ], b[ 3 ], c[ 3 ], d[ 3 ];
+
+    void set( const Vector3& p0, const Vector3& p1, const Vector3& p2, const Vector3& p3 )
+    {
+        const double* q0 = &p0.x;
+        const double* q1 = &p1.x;
+        const double* q2 = &p2.x;
+        const double* q3 = &p3.x;
+        for ( int i = 0; i < 3; i ++ ) {
+            double v0 = ( q2[ i ] - q0[ i ] ) * 0.5,
+                    v1 = ( q3[ i ] - q1[ i ] ) * 0.5;
+            this->a[ i ] = 2 * ( q1[ i ] - q2[ i ] ) + v0 + v1;
+            this->b[ i ] = - 3 * ( q1[ i ] - q2[ i ] ) - 2 * v0 - v1;
+            this->c[ i ] = v0;
+            this->d[ i ] = q1[ i ];
+        }
+    }
+};
+
+// the coefficient tile: a, b, c, d of x, y, z, one lane per sample
+struct PointTile
+{
+    double coefficients[ 12 ][ PointsPerTile ];
+    double weights[ PointsPerTile ];
+};
+
+void evaluateTile( PointTile& tile, Vector3* out, int n )
+{
+    using namespace Simd;
+
+    int i = 0;
+    for ( ; i + DoubleLanes <= n; i += DoubleLanes ) {
+        VDouble t = load( tile.weights + i );
+        VDouble t2 = mul( t, t );
+        VDouble t3 = mul( t, t2 );
+
+        double r[ 3 ][ DoubleLanes ];
+        for ( int c = 0; c < 3; c ++ ) {
+            VDouble v = add( add( add( mul( load( tile.coefficients[ c ] + i ), t3 ),
+                                       mul( load( tile.coefficients[ 3 + c ] + i ), t2 ) ),
+                                  mul( load( tile.coefficients[ 6 + c ] + i ), t ) ),
+                             load( tile.coefficients[ 9 + c ] + i ) );
+            store( r[ c ], v );
+        }
+
+        for ( int l = 0; l < DoubleLanes; l ++ ) {
+            out[ i + l ].set( r[ 0 ][ l ], r[ 1 ][ l ], r[ 2 ][ l ] );
+        }
+    }
+
+    for ( ; i < n; i ++ ) {
+        double t = tile.weights[ i ], t2 = t * t, t3 = t * t2;
+        double r[ 3 ];
+        for ( int c = 0; c < 3; c ++ ) {
+            r[ c ] = tile.coefficients[ c ][ i ] * t3 + tile.coefficients[ 3 + c ][ i ] * t2 +
+                     tile.coefficients[ 6 + c ][ i ] * t + tile.coefficients[ 9 + c ][ i ];
+        }
+        out[ i ].set( r[ 0 ], r[ 1 ], r[ 2 ] );
+    }
+}
+
+} // namespace
+
+Vector3 Spline::getPointOnSegment(const int &segment, const double &weight) const
+{
+    const int last = this->points.size() - 1;
+
+    const Vector3& pa = this->points[ std::max( segment - 1, 0 ) ];
+    const Vector3& pb = this->points[ segment ];
+    const Vector3& pc = this->points[ std::min( segment + 1, last ) ];
+    const Vector3& pd = this->points[ std::min( segment + 2, last ) ];
+
+    double w2 = weight * weight;
+    double w3 = weight * w2;
+
+    return Vector3( Spline::interpolate( pa.x, pb.x, pc.x, pd.x, weight, w2, w3 ),
+                    Spline::interpolate( pa.y, pb.y, pc.y, pd.y, weight, w2, w3 ),
+                    Spline::interpolate( pa.z, pb.z, pc.z, pd.z, weight, w2, w3 ) );
+}
+
+void Spline::getPoints(const double *ks, Vector3 *out, const int &count, const bool &parallel) const
+{
+    const int segments = this->segmentCount();
+    if ( segments == 0 ) {
+        Vector3 point = this->points.isEmpty() ? Vector3() : this->points[ 0 ];
+        std::fill( out, out + count, point );
+        return;
+    }
+
+    const int last = segments;
+
+    // coefficients of every segment up front when there are more parameters
+    // than segments, unsorted parameters then cost a lookup each
+    QVector<SegmentCoefficients> table;
+    if ( count >= segments ) {
+        table.resize( segments );
+        for ( int segment = 0; segment < segments; segment ++ ) {
+            table[ segment ].set( this->points[ std::max( segment - 1, 0 ) ],
+                                  this->points[ segment ],
+                                  this->points[ std::min( segment + 1, last ) ],
+                                  this->points[ std::min( segment + 2, last ) ] );
+        }
+    }
+    const SegmentCoefficients* coefficientTable = table.isEmpty() ? nullptr : table.constData();
+
+    auto body = [=]( int begin, int end ) {
+        PointTile tile;
+        SegmentCoefficients local;
+        int current = -1;
+
+        for ( int first = begin; first < end; first += PointsPerTile ) {
+            int n = std::min( PointsPerTile, end - first );
+
+            for ( int i = 0; i < n; i ++ ) {
+                double k = ks[ first + i ];
+                Q_ASSERT( k >= 0.0 && k <= 1.0 );
+
+                double point = segments * k;
+                int segment = std::min( int( point ), segments - 1 );
+
+                if ( !coefficientTable && segment != current ) {
+                    local.set( this->points[ std::max( segment - 1, 0 ) ],
+                               this->points[ segment ],
+                               this->points[ std::min( segment + 1, last ) ],
+                               this->points[ std::min( segment + 2, last ) ] );
+                    current = segment;
+                }
+                const SegmentCoefficients* coefficients = coefficientTable ? coefficientTable + segment : &local;
+
+                for ( int c = 0; c < 3; c ++ ) {
+                    tile.coefficients[ c ][ i ] = coefficients->a[ c ];
+                    tile.coefficients[ 3 + c ][ i ] = coefficients->b[ c ];
+                    tile.coefficients[ 6 + c ][ i ] = coefficients->c[ c ];
+                    tile.coefficients[ 9 + c ][ i ] = coefficients->d[ c ];
+                }
+                tile.weights[ i ] = point - segment;
+            }
+
+            evaluateTile( tile, out + first, n );
+        }
+    };
+
+    if ( parallel ) {
+        Parallel::forRange( count, PointsPerTask, body );
+    } else {
+        body( 0, count );
+    }
+}
+
+Vector3Array &Spline::getPoints(const Float32Array &ks, Vector3Array &target, const bool &parallel) const
+{
+    target.resize( ks.size() );
+    if ( !ks.isEmpty() ) {
+        this->getPoints( ks.constData(), target.data(), ks.size(), parallel );
+    }
+    return target;
+}
+
+void Spline::updateArcLengths() const
+{
+    const int segments = this->segmentCount();
+    const int divisions = this->arcLengthDivisions;
+
+    bool rebuild = this->arcLengths.size() != segments * divisions || this->dirtySegments.size() != segments;
+    if ( !rebuild && !this->arcLengthsDirty )
+        return;
+
+    if ( rebuild ) {
+        this->arcLengths.resize( segments * divisions );
+        this->dirtySegments.fill( 1, segments );
+    }
 
+    for ( int segment = 0; segment < segments; segment ++ ) {
+        if ( !this->dirtySegments[ segment ] )
+            continue;
+
+        double* lengths = this->arcLengths.data() + segment * divisions;
+        Vector3 oldPosition = this->points[ segment ];
+        double length = 0;
+
+        for ( int i = 1; i <= divisions; i ++ ) {
+            Vector3 position = this->getPointOnSegment( segment, double( i ) / divisions );
+            length += position.distanceTo( oldPosition );
+            lengths[ i - 1 ] = length;
+            oldPosition = position;
+        }
+
+        this->dirtySegments[ segment ] = 0;
+    }
+
+    this->segmentStarts.resize( segments + 1 );
+    double total = 0;
+    for ( int segment = 0; segment < segments; segment ++ ) {
+        this->segmentStarts[ segment ] = total;
+        total += this->arcLengths[ segment * divisions + divisions - 1 ];
+    }
+    this->segmentStarts[ segments ] = total;
+
+    this->arcLengthsDirty = false;
+}
+
+void Spline::pointChanged(const int &index)
+{
+    // segment s is shaped by the points s - 1 to s + 2
+    const int segments = this->segmentCount();
+    if ( this->dirtySegments.size() == segments ) {
+        for ( int s = std::max( index - 2, 0 ); s <= std::min( index + 1, segments - 1 ); s ++ ) {
+            this->dirtySegments[ s ] = 1;
+        }
+    }
+    this->arcLengthsDirty = true;
+}
+
+double Spline::getLength() const
+{
+    this->updateArcLengths();
+    return this->segmentStarts.isEmpty() ? 0 : this->segmentStarts.last();
+}
+
+Float32Array Spline::getChunkLengths() const
+{
+    if ( this->points.isEmpty() )
+        return Float32Array();
+
+    this->updateArcLengths();
+    return this->segmentStarts;
+}
+
+double Spline::getParameterAtLength(const double &distance) const
+{
+    this->updateArcLengths();
+
+    const int segments = this->segmentCount();
+    if ( segments == 0 )
+        return 0;
+
+    const double* starts = this->segmentStarts.constData();
+    const double total = starts[ segments ];
+    if ( !( distance > 0 ) || total <= 0 )
+        return 0;
+    if ( distance >= total )
+        return 1;
+
+    // the segment holding distance, then the sample at or past it
+    int segment = int( std::upper_bound( starts, starts + segments, distance ) - starts ) - 1;
+    segment = std::max( 0, std::min( segment, segments - 1 ) );
+
+    const int divisions = this->arcLengthDivisions;
+    const double* lengths = this->arcLengths.constData() + segment * divisions;
+    const double local = distance - starts[ segment ];
+
+    int i = int( std::lower_bound( lengths, lengths + divisions, local ) - lengths );
+    i = std::min( i, divisions - 1 );
+
+    double before = i > 0 ? lengths[ i - 1 ] : 0;
+    double span = lengths[ i ] - before;
+    double fraction = span > 0 ? ( local - before ) / span : 0;
+
+    double weight = ( i + std::max( 0.0, std::min( fraction, 1.0 ) ) ) / divisions;
+    return ( segment + weight ) / segments;
+}
+
+Vector3 Spline::getPointAtLength(const double &distance) const
+{
+    const int segments = this->segmentCount();
+    if ( segments == 0 )
+        return this->points.isEmpty() ? Vector3() : this->points[ 0 ];
+
+    double point = this->getParameterAtLength( distance ) * segments;
+    int segment = std::min( int( point ), segments - 1 );
+
+    return this->getPointOnSegment( segment, point - segment );
+}
+
+void Spline::reparametrizeByArcLength(const double &samplingCoef)
+{
+    const int segments = this->segmentCount();
+    if ( segments == 0 )
+        return;
+
+    this->updateArcLengths();
+
+    const double total = this->segmentStarts[ segments ];
+    if ( total <= 0 )
+        return;
+
+    Vector3Array newpoints;
+    newpoints.push_back( this->points[ 0 ] );
+
+    for ( int i = 1; i <= segments; i ++ ) {
+
+        double start = this->segmentStarts[ i - 1 ];
+        double realDistance = this->segmentStarts[ i ] - start;
+        int sampling = int( std::ceil( samplingCoef * realDistance / total ) );
+
+        for ( int j = 1; j < sampling - 1; j ++ ) {
+            newpoints.push_back( this->getPointAtLength( start + realDistance * j / sampling ) );
+        }
+
+        newpoints.push_back( this->points[ i ] );
+    }
+
+    this->initFromArray( newpoints );
+}
+
+} // namespace three
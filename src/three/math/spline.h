@@ -13,52 +13,48 @@ namespace three {
 class Spline
 {
 public:
-    Spline()
+    Spline():
+        arcLengthDivisions(32),
+        arcLengthsDirty(true)
     { }
 
     Spline(const Vector3Array& points):
-        points(points)
+        points(points),
+        arcLengthDivisions(32),
+        arcLengthsDirty(true)
     { }
 
     void initFromArray(const Vector3Array& a)
     {
         this->points = a;
+        this->arcLengths.clear();
     }
 
 
+    // k in [ 0, 1 ] runs from the first to the last control point
     Vector3 getPoint(const double& k) const
     {
-        Q_ASSERT( k > 0.0 && k < 1.0 );
+        Q_ASSERT( k >= 0.0 && k <= 1.0 );
 
-        double point = (this->points.size()-1) * k;
-        double intPoint = std::floor(point);
-        double weight = point - intPoint;
+        const int segments = this->segmentCount();
+        if ( segments == 0 )
+            return this->points.isEmpty() ? Vector3() : this->points[ 0 ];
 
-        Float32Array c;
+        double point = segments * k;
+        int segment = std::min( int( point ), segments - 1 );
 
-        c.push_back(intPoint == 0 ? intPoint : intPoint -1);
-        c.push_back(intPoint);
-        c.push_back(intPoint > this->points.size() - 2 ? this->points.size() - 1 : intPoint+1);
-        c.push_back(intPoint > this->points.size() - 3 ? this->points.size() - 1 : intPoint + 2);
-
-        Vector3 pa = this->points[ c[0] ];
-        Vector3 pb = this->points[ c[1] ];
-        Vector3 pc = this->points[ c[2] ];
-        Vector3 pd = this->points[ c[3] ];
-
-        double w2 = weight * weight;
-        double w3 = weight * w2;
-
-
-        Vector3 v3;
-
-        v3.x = Spline::interpolate( pa.x, pb.x, pc.x, pd.x, weight, w2, w3 );
-        v3.y = Spline::interpolate( pa.y, pb.y, pc.y, pd.y, weight, w2, w3 );
-        v3.z = Spline::interpolate( pa.z, pb.z, pc.z, pd.z, weight, w2, w3 );
+        return this->getPointOnSegment( segment, point - segment );
+    }
 
-        return v3;
+    // getPoint() of count parameters, sorted or not, into out. The cubic
+    // of each segment is set up once per call ( once per change of segment
+    // for batches smaller than the number of segments ), nothing is
+    // allocated per point and Simd::DoubleLanes points are evaluated at a
+    // time. `parallel` splits large batches across the global thread pool.
+    // The results equal getPoint() bit for bit.
+    void getPoints( const double* ks, Vector3* out, const int& count, const bool& parallel = false ) const;
 
-    }
+    Vector3Array& getPoints( const Float32Array& ks, Vector3Array& target, const bool& parallel = false ) const;
 
     Vector3Array getControlPointsArray() const
     {
@@ -75,121 +71,61 @@ public:
         return this->points;
     }
 
-    // chunks: chunkLengths
-    // total: chunkLengths[chunkLengths.length-1]
-    QVector<int> getLength(int nSubDivisions = 100) {
-
-        int i, index, nSamples;
-        Vector3 position;
-
-        int point = 0, intPoint = 0, oldIntPoint = 0;
-        Vector3  oldPosition ,  tmpVec ;
-        QVector<int> chunkLengths;
-        int totalLength = 0;
-
-        // first point has 0 length
-
-        chunkLengths[ 0 ] = 0;
-
-        if ( ! nSubDivisions ) nSubDivisions = 100;
-
-        nSamples = this->points.size() * nSubDivisions;
-
-        oldPosition.copy( this->points[ 0 ] );
-
-        for ( i = 1; i < nSamples; i ++ ) {
-
-            index = i / nSamples;
-
-            position = this->getPoint( index );
-            tmpVec.copy( position );
-
-            totalLength += tmpVec.distanceTo( oldPosition );
-
-            oldPosition.copy( position );
-
-            point = ( this->points.size() - 1 ) * index;
-            intPoint = std::floor( point );
-
-            if ( intPoint != oldIntPoint ) {
-
-                chunkLengths[ intPoint ] = totalLength;
-                oldIntPoint = intPoint;
-
-            }
-
-        }
-
-        // last point ends with total length
-
-        // chunkLengths[ chunkLengths.size() ] = totalLength;
-        chunkLengths.push_back(totalLength);
-
-        //return { chunks: chunkLengths, total: totalLength };
-        return chunkLengths;
+    // Arc length table
+    //
+    // Every segment between two control points is sampled at
+    // arcLengthDivisions points and the chord lengths summed, the table is
+    // built on first use. Lookups then binary search first the segment,
+    // then the samples within it, and interpolate linearly between them.
+    // Moving points through setPoint() ( or pointChanged() after writing
+    // points directly ) only re-samples the up to four segments each point
+    // shapes, a change in the number of points rebuilds the whole table.
+    // The table is a cache behind the const functions: call
+    // updateArcLengths() before sharing a spline between threads.
+
+    // total length
+    double getLength() const;
+
+    // length from the first point to each control point, the last one is
+    // getLength()
+    Float32Array getChunkLengths() const;
+
+    // the parameter k of getPoint() at distance along the curve, clamped
+    // to [ 0, getLength() ]
+    double getParameterAtLength( const double& distance ) const;
+
+    // the point at distance along the curve / at fraction u of its length,
+    // for sampling at constant speed
+    Vector3 getPointAtLength( const double& distance ) const;
+
+    Vector3 getPointAt( const double& u ) const
+    {
+        return this->getPointAtLength( u * this->getLength() );
     }
 
+    void setPoint( const int& index, const Vector3& point )
+    {
+        this->points[ index ] = point;
+        this->pointChanged( index );
+    }
 
-    void reparametrizeByArcLength( const double& samplingCoef ) {
-
-        int i, j, index, indexCurrent, indexNext;
-        //        int linearDistance;
-
-        double realDistance,
-                sampling;
-
-
-        Vector3 position;
-
-        Vector3Array newpoints;
-        // Vector3 tmpVec ;
-
-        // chunks: chunkLengths
-        // total: chunkLengths[chunkLengths.length-1]
-
-        QVector<int> sl = this->getLength();
-
-        QVector<int> chunks = sl;
-        chunks.takeLast();
-        int total = sl.at(sl.size()-1);
-
-        // newpoints.push_back( tmpVec.copy( this->points[ 0 ] ).clone() );
-        newpoints.push_back( this->points[ 0 ]);
-
-        for ( i = 1; i < this->points.size(); i ++ ) {
-
-            //tmpVec.copy( this->points[ i - 1 ] );
-            //linearDistance = tmpVec.distanceTo( this->points[ i ] );
-
-            // realDistance = sl.chunks[ i ] - sl.chunks[ i - 1 ];
-
-            // TODO
-            // assert()...
-            realDistance = chunks[ i ] - chunks[ i - 1 ];
-
-            // sampling = std::ceil( samplingCoef * realDistance / sl.total );
-
-            sampling = std::ceil( samplingCoef * realDistance / total );
-
-
-            indexCurrent = ( i - 1 ) / ( this->points.size() - 1 );
-            indexNext = i / ( this->points.size() - 1 );
-
-            for ( j = 1; j < sampling - 1; j ++ ) {
-
-                index = indexCurrent + j * ( 1 / sampling ) * ( indexNext - indexCurrent );
+    // marks the segments shaped by point index for re-sampling
+    void pointChanged( const int& index );
 
-                position = this->getPoint( index );
-                // newpoints.push( tmpVec.copy( position ).clone() );
-                newpoints.push_back( position );
-            }
+    void setArcLengthDivisions( const int& divisions )
+    {
+        Q_ASSERT( divisions > 0 );
+        this->arcLengthDivisions = divisions;
+        this->arcLengths.clear();
+    }
 
-            // newpoints.push_back( tmpVec.copy( this->points[ i ] ).clone() );
-            newpoints.push_back( this->points[ i ] );
-        }
+    // brings the arc length table up to date
+    void updateArcLengths() const;
 
-        this->points = newpoints;
-    }
+    // Replaces the points by points at equal arc length steps, every
+    // segment getting about samplingCoef * its share of the total length.
+    // The control points are kept.
+    void reparametrizeByArcLength( const double& samplingCoef );
 
     // interpolate方法是传说中的样条插值函数,这里是三次样条插值算法,返回计算位于参数值t的曲线点.
     static double interpolate(const double& p0, const double& p1,const double& p2,const double& p3,const double& t,const double& t2,const double& t3 ) {
@@ -204,6 +140,24 @@ public:
     // private:
     Vector3Array points;
 
+    int arcLengthDivisions;
+
+    // arcLengths[ segment * arcLengthDivisions + i ] is the length from the
+    // start of segment to its sample i + 1, segmentStarts the length up to
+    // the start of each segment, the total last
+    mutable Float32Array arcLengths;
+    mutable Float32Array segmentStarts;
+    mutable QVector<quint8> dirtySegments;
+    mutable bool arcLengthsDirty;
+
+private:
+    // point at weight in [ 0, 1 ] of segment, the Catmull-Rom of getPoint()
+    Vector3 getPointOnSegment( const int& segment, const double& weight ) const;
+
+    int segmentCount() const
+    {
+        return std::max( this->points.size() - 1, 0 );
+    }
 };
 
 } // namespace three
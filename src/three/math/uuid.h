@@ -0,0 +1,119 @@
+#ifndef THREE_UUID_H
+#define THREE_UUID_H
+
+#include <QDateTime>
+#include <QHash>
+#include <QString>
+#include <QUuid>
+#include <QtGlobal>
+
+namespace three {
+
+// A 128 bit RFC 4122 version 4 UUID held as two integers. Creating one does
+// not allocate, the string form is only built by toString().
+class Uuid
+{
+public:
+    Uuid():
+        hi(0),
+        lo(0)
+    { }
+
+    Uuid( const quint64& hi, const quint64& lo ):
+        hi(hi),
+        lo(lo)
+    { }
+
+    // a random version 4 UUID, from a per thread splitmix64 sequence seeded
+    // once from QUuid::createUuid()
+    static Uuid create()
+    {
+        static thread_local quint64 state = Uuid::seed();
+
+        quint64 hi = Uuid::splitmix( state );
+        quint64 lo = Uuid::splitmix( state );
+
+        hi = ( hi & Q_UINT64_C( 0xffffffffffff0fff ) ) | Q_UINT64_C( 0x0000000000004000 );
+        lo = ( lo & Q_UINT64_C( 0x3fffffffffffffff ) ) | Q_UINT64_C( 0x8000000000000000 );
+
+        return Uuid( hi, lo );
+    }
+
+    static Uuid fromQUuid( const QUuid& uuid )
+    {
+        quint64 hi = ( quint64( uuid.data1 ) << 32 ) | ( quint64( uuid.data2 ) << 16 ) | uuid.data3;
+        quint64 lo = 0;
+        for ( int i = 0; i < 8; i ++ ) {
+            lo = ( lo << 8 ) | uuid.data4[ i ];
+        }
+        return Uuid( hi, lo );
+    }
+
+    // accepts everything QUuid does, e.g. "{xxxxxxxx-xxxx-xxxx-xxxx-xxxxxxxxxxxx}"
+    static Uuid fromString( const QString& text )
+    {
+        return Uuid::fromQUuid( QUuid( text ) );
+    }
+
+    QUuid toQUuid() const
+    {
+        return QUuid( uint( this->hi >> 32 ), ushort( this->hi >> 16 ), ushort( this->hi ),
+                      uchar( this->lo >> 56 ), uchar( this->lo >> 48 ), uchar( this->lo >> 40 ), uchar( this->lo >> 32 ),
+                      uchar( this->lo >> 24 ), uchar( this->lo >> 16 ), uchar( this->lo >> 8 ), uchar( this->lo ) );
+    }
+
+    // same format as QUuid::toString()
+    QString toString() const
+    {
+        return this->toQUuid().toString();
+    }
+
+    bool isNull() const
+    {
+        return this->hi == 0 && this->lo == 0;
+    }
+
+    bool operator==( const Uuid& other ) const
+    {
+        return this->hi == other.hi && this->lo == other.lo;
+    }
+
+    bool operator!=( const Uuid& other ) const
+    {
+        return !( *this == other );
+    }
+
+    bool operator<( const Uuid& other ) const
+    {
+        return this->hi < other.hi || ( this->hi == other.hi && this->lo < other.lo );
+    }
+
+    // private:
+
+    quint64 hi;
+    quint64 lo;
+
+private:
+    static quint64 seed()
+    {
+        Uuid random = Uuid::fromQUuid( QUuid::createUuid() );
+        return random.hi ^ ( random.lo * Q_UINT64_C( 0x9e3779b97f4a7c15 ) ) ^ quint64( QDateTime::currentMSecsSinceEpoch() );
+    }
+
+    static quint64 splitmix( quint64& state )
+    {
+        quint64 z = ( state += Q_UINT64_C( 0x9e3779b97f4a7c15 ) );
+        z = ( z ^ ( z >> 30 ) ) * Q_UINT64_C( 0xbf58476d1ce4e5b9 );
+        z = ( z ^ ( z >> 27 ) ) * Q_UINT64_C( 0x94d049bb133111eb );
+        return z ^ ( z >> 31 );
+    }
+};
+
+inline uint qHash( const Uuid& uuid, uint seed = 0 )
+{
+    return ::qHash( uuid.hi ^ ( uuid.lo * Q_UINT64_C( 0x9e3779b97f4a7c15 ) ), seed );
+}
+
+} // namespace three
+
+#endif // THREE_UUID_H
@@ -4,6 +4,8 @@
 #include "matrix4.h"
 #include "quaternion.h"
 
+#include "../core/bufferattribute.h"
+
 namespace three {
 
 Vector3 &Vector3::applyAxisAngle(const Vector3 &axis, const double &angle)
@@ -116,6 +118,13 @@ Vector3 &Vector3::applyEuler(const Euler &euler)
 }
 
 
+Vector3 &Vector3::fromAttribute(const BufferAttribute &attribute, const int &index, const int &offset)
+{
+    this->x = attribute.get( index, offset );
+    this->y = attribute.get( index, offset + 1 );
+    this->z = attribute.get( index, offset + 2 );
+    return *this;
+}
 
 } // namespace three
 
@@ -464,15 +464,8 @@ public:
         return array;
     }
 
-    // TODO
-    //    fromAttribute( attribute, index, offset = 0 ) {
-    //        index = index * attribute.itemSize + offset;
-    //        this->x = attribute.array[ index ];
-    //        this->y = attribute.array[ index + 1 ];
-    //        this->z = attribute.array[ index + 2 ];
-    //        return *this;
-    //    }
-
+    // reads components offset .. offset + 2 of item `index`
+    Vector3& fromAttribute( const BufferAttribute& attribute, const int& index, const int& offset = 0 );
 
     // private:
     double x;
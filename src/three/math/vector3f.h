@@ -0,0 +1,157 @@
+#ifndef THREE_VECTOR3F_H
+#define THREE_VECTOR3F_H
+
+#include <cmath>
+
+#include "math_forword_declar.h"
+
+#include "vector3.h"
+#include "matrix4f.h"
+
+namespace three {
+
+class Vector3;
+class Matrix4f;
+
+// Single precision point for bulk data: vertex arrays, float attributes and
+// file formats. The scene math stays in double ( Vector3 ), convert at the
+// edges with the explicit constructor / toVector3() or the array helpers
+// below, and run batches through Matrix4f.
+class Vector3f
+{
+public:
+
+    Vector3f():
+        x(0),
+        y(0),
+        z(0)
+    {}
+
+    Vector3f(const float& x, const float& y, const float& z):
+        x(x),
+        y(y),
+        z(z)
+    {}
+
+    explicit Vector3f(const Vector3& v):
+        x(float(v.x)),
+        y(float(v.y)),
+        z(float(v.z))
+    {}
+
+    Vector3 toVector3() const
+    {
+        return Vector3( this->x, this->y, this->z );
+    }
+
+    Vector3f& set(const float& x, const float& y, const float& z )
+    {
+        this->x = x;
+        this->y = y;
+        this->z = z;
+        return *this;
+    }
+
+    Vector3f& copy( const Vector3f& v )
+    {
+        this->x = v.x;
+        this->y = v.y;
+        this->z = v.z;
+        return *this;
+    }
+
+    Vector3f& add( const Vector3f& v )
+    {
+        this->x += v.x;
+        this->y += v.y;
+        this->z += v.z;
+        return *this;
+    }
+
+    Vector3f& sub( const Vector3f& v )
+    {
+        this->x -= v.x;
+        this->y -= v.y;
+        this->z -= v.z;
+        return *this;
+    }
+
+    Vector3f& multiplyScalar( const float& s )
+    {
+        this->x *= s;
+        this->y *= s;
+        this->z *= s;
+        return *this;
+    }
+
+    float dot( const Vector3f& v ) const
+    {
+        return this->x * v.x + this->y * v.y + this->z * v.z;
+    }
+
+    float lengthSq() const
+    {
+        return this->x * this->x + this->y * this->y + this->z * this->z;
+    }
+
+    float length() const
+    {
+        return std::sqrt( this->lengthSq() );
+    }
+
+    // same evaluation order as Matrix4f::applyToPoints
+    Vector3f& applyMatrix4( const Matrix4f& m )
+    {
+        float x = this->x, y = this->y, z = this->z;
+        const auto& e = m.elements;
+        this->x = e[ 0 ] * x + e[ 4 ] * y + e[ 8 ]  * z + e[ 12 ];
+        this->y = e[ 1 ] * x + e[ 5 ] * y + e[ 9 ]  * z + e[ 13 ];
+        this->z = e[ 2 ] * x + e[ 6 ] * y + e[ 10 ] * z + e[ 14 ];
+        return *this;
+    }
+
+    bool equals( const Vector3f& v ) const
+    {
+        return ( ( v.x == this->x ) && ( v.y == this->y ) && ( v.z == this->z ) );
+    }
+
+    // Whole array conversions, also for the Float32Array / FloatArray
+    // flavour of the same data ( count components ).
+    static Vector3fArray fromArray( const Vector3Array& array )
+    {
+        Vector3fArray result( array.size() );
+        toFloats( &array.constData()->x, &result.data()->x, qint64( array.size() ) * 3 );
+        return result;
+    }
+
+    static Vector3Array toArray( const Vector3fArray& array )
+    {
+        Vector3Array result( array.size() );
+        toDoubles( &array.constData()->x, &result.data()->x, qint64( array.size() ) * 3 );
+        return result;
+    }
+
+    static void toFloats( const double* src, float* dst, const qint64& count )
+    {
+        for ( qint64 i = 0; i < count; i ++ ) {
+            dst[ i ] = float( src[ i ] );
+        }
+    }
+
+    static void toDoubles( const float* src, double* dst, const qint64& count )
+    {
+        for ( qint64 i = 0; i < count; i ++ ) {
+            dst[ i ] = src[ i ];
+        }
+    }
+
+    float x;
+    float y;
+    float z;
+};
+
+static_assert( sizeof( Vector3f ) == 3 * sizeof( float ), "Vector3f must be three packed floats" );
+
+} // namespace three
+
+#endif // THREE_VECTOR3F_H
@@ -0,0 +1,17 @@
+# Checks the approximate batch paths against their exact counterparts,
+# exits non zero when one is off by more than its documented bound.
+# `make check` runs it.
+
+TEMPLATE = app
+TARGET = accuracy
+
+QT += concurrent
+CONFIG += console testcase
+CONFIG -= app_bundle
+
+INCLUDEPATH += $$PWD/../../src
+
+include(../../src/src.pri)
+
+SOURCES += \
+    $$PWD/main.cpp
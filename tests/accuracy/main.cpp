@@ -0,0 +1,115 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+#include <QVector>
+
+#include "three/math/quaternion.h"
+#include "three/math/random.h"
+
+using namespace three;
+
+namespace {
+
+// the documented bounds, see Quaternion::fastSlerpFlat / nlerpFlat
+const double FastSlerpBound = 8e-4;
+const double NlerpBound = 0.143;
+const double NlerpNearBound = 6e-4;     // rotations less than 30 degrees apart
+const double NearAngle = M_PI / 6;
+
+const int PairCount = 1 << 18;
+
+// angle of the rotation taking quaternion a to b
+double angleBetween( const double* a, const double* b )
+{
+    double dot = a[ 0 ] * b[ 0 ] + a[ 1 ] * b[ 1 ] + a[ 2 ] * b[ 2 ] + a[ 3 ] * b[ 3 ];
+    return 2 * std::acos( std::min( std::fabs( dot ), 1.0 ) );
+}
+
+void randomUnit( Random& random, double* q )
+{
+    double lengthSq;
+    do {
+        for ( int c = 0; c < 4; c ++ ) {
+            q[ c ] = random.nextDouble( -1, 1 );
+        }
+        lengthSq = q[ 0 ] * q[ 0 ] + q[ 1 ] * q[ 1 ] + q[ 2 ] * q[ 2 ] + q[ 3 ] * q[ 3 ];
+    } while ( lengthSq > 1 || lengthSq < 1e-6 );
+
+    const double scale = 1 / std::sqrt( lengthSq );
+    for ( int c = 0; c < 4; c ++ ) {
+        q[ c ] *= scale;
+    }
+}
+
+// q rotated by up to maxAngle about a random axis
+void randomNear( Random& random, const double* q, const double& maxAngle, double* target )
+{
+    double axis[ 4 ];
+    randomUnit( random, axis );
+    const double length = std::sqrt( axis[ 0 ] * axis[ 0 ] + axis[ 1 ] * axis[ 1 ] + axis[ 2 ] * axis[ 2 ] );
+    const double half = random.nextDouble() * maxAngle / 2, s = std::sin( half ) / length;
+
+    Quaternion rotation( axis[ 0 ] * s, axis[ 1 ] * s, axis[ 2 ] * s, std::cos( half ) );
+    Quaternion result = Quaternion( q[ 0 ], q[ 1 ], q[ 2 ], q[ 3 ] ).multiply( rotation );
+    target[ 0 ] = result.x;
+    target[ 1 ] = result.y;
+    target[ 2 ] = result.z;
+    target[ 3 ] = result.w;
+}
+
+// largest angle between the results of approximate and slerpFlat
+template<typename Approximate>
+double maxError( const QVector<double>& q0, const QVector<double>& q1, const QVector<double>& t,
+                 Approximate approximate )
+{
+    const int count = t.size();
+    QVector<double> exact( count * 4 ), approximated( count * 4 );
+
+    Quaternion::slerpFlat( exact.data(), q0.constData(), q1.constData(), count, t.constData() );
+    approximate( approximated.data(), q0.constData(), q1.constData(), count, t.constData() );
+
+    double error = 0;
+    for ( int i = 0; i < count; i ++ ) {
+        error = std::max( error, angleBetween( exact.constData() + i * 4, approximated.constData() + i * 4 ) );
+    }
+    return error;
+}
+
+bool check( const char* name, const double& error, const double& bound )
+{
+    const bool passed = error <= bound;
+    std::printf( "%-36s %.3e rad, bound %g %s\n", name, error, bound, passed ? "" : "FAILED" );
+    return passed;
+}
+
+} // namespace
+
+int main()
+{
+    Random random( 7 );
+
+    // any pair, and pairs less than 30 degrees apart, at random t
+    QVector<double> q0( PairCount * 4 ), q1( PairCount * 4 ), near( PairCount * 4 ), t( PairCount );
+    for ( int i = 0; i < PairCount; i ++ ) {
+        randomUnit( random, q0.data() + i * 4 );
+        randomUnit( random, q1.data() + i * 4 );
+        randomNear( random, q0.constData() + i * 4, NearAngle, near.data() + i * 4 );
+        t[ i ] = random.nextDouble();
+    }
+
+    auto fast = []( double* dst, const double* a, const double* b, int count, const double* t ) {
+        Quaternion::fastSlerpFlat( dst, a, b, count, t );
+    };
+    auto nlerp = []( double* dst, const double* a, const double* b, int count, const double* t ) {
+        Quaternion::nlerpFlat( dst, a, b, count, t );
+    };
+
+    bool passed = true;
+    passed &= check( "fastSlerpFlat", maxError( q0, q1, t, fast ), FastSlerpBound );
+    passed &= check( "fastSlerpFlat, < 30 degrees", maxError( q0, near, t, fast ), FastSlerpBound );
+    passed &= check( "nlerpFlat", maxError( q0, q1, t, nlerp ), NlerpBound );
+    passed &= check( "nlerpFlat, < 30 degrees", maxError( q0, near, t, nlerp ), NlerpNearBound );
+
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,38 @@
+#ifndef THREE_BENCH_H
+#define THREE_BENCH_H
+
+#include <QElapsedTimer>
+
+#include <algorithm>
+#include <limits>
+
+namespace bench {
+
+// the best of runs calls of body(), in nanoseconds per item
+template<typename Body>
+double time( const int& items, const int& runs, Body body )
+{
+    double best = std::numeric_limits<double>::max();
+    for ( int r = 0; r < runs; r ++ ) {
+        QElapsedTimer timer;
+        timer.start();
+        body();
+        best = std::min( best, double( timer.nsecsElapsed() ) / items );
+    }
+    return best;
+}
+
+// keeps results alive without the optimizer seeing through them
+void consume( const double& value );
+
+void matrix4();
+
+void sceneGraph();
+
+void frustum();
+
+void ray();
+
+} // namespace bench
+
+#endif // THREE_BENCH_H
@@ -0,0 +1,23 @@
+# Microbenchmarks of the batch / SIMD paths against their scalar
+# counterparts. Build in release mode, run `bench [name ...]`.
+
+TEMPLATE = app
+TARGET = bench
+
+QT += concurrent
+CONFIG += console
+CONFIG -= app_bundle
+
+INCLUDEPATH += $$PWD/../../src
+
+include(../../src/src.pri)
+
+HEADERS += \
+    $$PWD/bench.h
+
+SOURCES += \
+    $$PWD/main.cpp \
+    $$PWD/bench_matrix4.cpp \
+    $$PWD/bench_scenegraph.cpp \
+    $$PWD/bench_frustum.cpp \
+    $$PWD/bench_ray.cpp
@@ -0,0 +1,76 @@
+#include <cstdio>
+
+#include <QVector>
+
+#include "three/math/frustum.h"
+#include "three/math/matrix4.h"
+#include "three/math/random.h"
+
+#include "bench.h"
+
+using namespace three;
+
+void bench::frustum()
+{
+    const int count = 1 << 16, runs = 50;
+
+    Matrix4 projection;
+    projection.makePerspective( 60, 1, 1, 100 );
+    Frustum frustum;
+    frustum.setFromMatrix( projection );
+
+    // volumes scattered around the camera, a few percent of them visible
+    Random random( 9 );
+    QVector<double> xs( count ), ys( count ), zs( count ), radii( count );
+    QVector<double> maxXs( count ), maxYs( count ), maxZs( count );
+    QVector<Sphere> spheres( count );
+    QVector<Box3> boxes( count );
+    for ( int i = 0; i < count; i ++ ) {
+        xs[ i ] = random.nextDouble( -100, 100 );
+        ys[ i ] = random.nextDouble( -100, 100 );
+        zs[ i ] = random.nextDouble( -100, 100 );
+        radii[ i ] = random.nextDouble( 0, 5 );
+        maxXs[ i ] = xs[ i ] + radii[ i ];
+        maxYs[ i ] = ys[ i ] + radii[ i ];
+        maxZs[ i ] = zs[ i ] + radii[ i ];
+        spheres[ i ] = Sphere( Vector3( xs[ i ], ys[ i ], zs[ i ] ), radii[ i ] );
+        boxes[ i ] = Box3( Vector3( xs[ i ], ys[ i ], zs[ i ] ), Vector3( maxXs[ i ], maxYs[ i ], maxZs[ i ] ) );
+    }
+
+    QVector<quint64> batchSpheres( ( count + 63 ) / 64 ), batchBoxes( ( count + 63 ) / 64 );
+    QVector<quint8> scalarSpheres( count ), scalarBoxes( count );
+
+    double scalarSphereTime = bench::time( count, runs, [&]() {
+        for ( int i = 0; i < count; i ++ ) {
+            scalarSpheres[ i ] = frustum.intersectsSphere( spheres[ i ] );
+        }
+    } );
+    double batchSphereTime = bench::time( count, runs, [&]() {
+        frustum.intersectsSpheres( xs.data(), ys.data(), zs.data(), radii.data(), count, batchSpheres.data() );
+    } );
+
+    double scalarBoxTime = bench::time( count, runs, [&]() {
+        for ( int i = 0; i < count; i ++ ) {
+            scalarBoxes[ i ] = frustum.intersectsBox( boxes[ i ] );
+        }
+    } );
+    double batchBoxTime = bench::time( count, runs, [&]() {
+        frustum.intersectsBoxes( xs.data(), ys.data(), zs.data(), maxXs.data(), maxYs.data(), maxZs.data(),
+                                 count, batchBoxes.data() );
+    } );
+
+    int visible = 0, mismatches = 0;
+    for ( int i = 0; i < count; i ++ ) {
+        bool sphere = ( batchSpheres[ i / 64 ] >> ( i % 64 ) ) & 1;
+        bool box = ( batchBoxes[ i / 64 ] >> ( i % 64 ) ) & 1;
+        visible += sphere;
+        mismatches += ( sphere != bool( scalarSpheres[ i ] ) ) + ( box != bool( scalarBoxes[ i ] ) );
+    }
+
+    std::printf( "Frustum culling, %d volumes, %d spheres visible\n", count, visible );
+    std::printf( "  spheres  scalar %6.2f ns  batch %6.2f ns  speedup %.2fx\n",
+                 scalarSphereTime, batchSphereTime, scalarSphereTime / batchSphereTime );
+    std::printf( "  boxes    scalar %6.2f ns  batch %6.2f ns  speedup %.2fx\n",
+                 scalarBoxTime, batchBoxTime, scalarBoxTime / batchBoxTime );
+    std::printf( "  answers differing from scalar: %d\n", mismatches );
+}
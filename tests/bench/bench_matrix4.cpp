@@ -0,0 +1,112 @@
+#include <cstdio>
+#include <cstring>
+
+#include <QVector>
+
+#include "three/math/matrix4.h"
+#include "three/math/random.h"
+
+#include "bench.h"
+
+using namespace three;
+
+namespace {
+
+// Matrix4::multiplyMatrices as it was before the SIMD kernels
+void scalarMultiply( const Matrix4& a, const Matrix4& b, Matrix4& target )
+{
+    const auto& ae = a.elements;
+    const auto& be = b.elements;
+    auto& te = target.elements;
+
+    double a11 = ae[ 0 ], a12 = ae[ 4 ], a13 = ae[ 8 ], a14 = ae[ 12 ];
+    double a21 = ae[ 1 ], a22 = ae[ 5 ], a23 = ae[ 9 ], a24 = ae[ 13 ];
+    double a31 = ae[ 2 ], a32 = ae[ 6 ], a33 = ae[ 10 ], a34 = ae[ 14 ];
+    double a41 = ae[ 3 ], a42 = ae[ 7 ], a43 = ae[ 11 ], a44 = ae[ 15 ];
+
+    double b11 = be[ 0 ], b12 = be[ 4 ], b13 = be[ 8 ], b14 = be[ 12 ];
+    double b21 = be[ 1 ], b22 = be[ 5 ], b23 = be[ 9 ], b24 = be[ 13 ];
+    double b31 = be[ 2 ], b32 = be[ 6 ], b33 = be[ 10 ], b34 = be[ 14 ];
+    double b41 = be[ 3 ], b42 = be[ 7 ], b43 = be[ 11 ], b44 = be[ 15 ];
+
+    te[ 0 ] = a11 * b11 + a12 * b21 + a13 * b31 + a14 * b41;
+    te[ 4 ] = a11 * b12 + a12 * b22 + a13 * b32 + a14 * b42;
+    te[ 8 ] = a11 * b13 + a12 * b23 + a13 * b33 + a14 * b43;
+    te[ 12 ] = a11 * b14 + a12 * b24 + a13 * b34 + a14 * b44;
+
+    te[ 1 ] = a21 * b11 + a22 * b21 + a23 * b31 + a24 * b41;
+    te[ 5 ] = a21 * b12 + a22 * b22 + a23 * b32 + a24 * b42;
+    te[ 9 ] = a21 * b13 + a22 * b23 + a23 * b33 + a24 * b43;
+    te[ 13 ] = a21 * b14 + a22 * b24 + a23 * b34 + a24 * b44;
+
+    te[ 2 ] = a31 * b11 + a32 * b21 + a33 * b31 + a34 * b41;
+    te[ 6 ] = a31 * b12 + a32 * b22 + a33 * b32 + a34 * b42;
+    te[ 10 ] = a31 * b13 + a32 * b23 + a33 * b33 + a34 * b43;
+    te[ 14 ] = a31 * b14 + a32 * b24 + a33 * b34 + a34 * b44;
+
+    te[ 3 ] = a41 * b11 + a42 * b21 + a43 * b31 + a44 * b41;
+    te[ 7 ] = a41 * b12 + a42 * b22 + a43 * b32 + a44 * b42;
+    te[ 11 ] = a41 * b13 + a42 * b23 + a43 * b33 + a44 * b43;
+    te[ 15 ] = a41 * b14 + a42 * b24 + a43 * b34 + a44 * b44;
+}
+
+} // namespace
+
+void bench::matrix4()
+{
+    // 64 products, 24 KiB of matrices: fits in L1, so the kernel is timed,
+    // not the cache
+    const int count = 64, runs = 8000;
+
+    Random random( 2 );
+    QVector<Matrix4> a( count ), b( count ), scalar( count ), simd( count );
+    for ( int i = 0; i < count; i ++ ) {
+        random.fill( a[ i ].elements.data(), 16, -1, 1 );
+        random.fill( b[ i ].elements.data(), 16, -1, 1 );
+    }
+
+    // independent products
+    double scalarTime = bench::time( count, runs, [&]() {
+        for ( int i = 0; i < count; i ++ ) {
+            scalarMultiply( a[ i ], b[ i ], scalar[ i ] );
+        }
+    } );
+    double simdTime = bench::time( count, runs, [&]() {
+        for ( int i = 0; i < count; i ++ ) {
+            simd[ i ].multiplyMatrices( a[ i ], b[ i ] );
+        }
+    } );
+
+    int mismatches = 0;
+    for ( int i = 0; i < count; i ++ ) {
+        mismatches += std::memcmp( scalar[ i ].elements.data(), simd[ i ].elements.data(), sizeof( Matrix4Elements ) ) != 0;
+    }
+
+    // a chain of products, each waiting for the one before
+    Matrix4 chain;
+    double scalarChainTime = bench::time( count, runs, [&]() {
+        Matrix4 m;
+        for ( int i = 0; i < count; i ++ ) {
+            Matrix4 r;
+            scalarMultiply( m, b[ i ], r );
+            m = r;
+        }
+        chain = m;
+    } );
+    bench::consume( chain.elements[ 0 ] );
+    double simdChainTime = bench::time( count, runs, [&]() {
+        Matrix4 m;
+        for ( int i = 0; i < count; i ++ ) {
+            m.multiply( b[ i ] );
+        }
+        chain = m;
+    } );
+    bench::consume( chain.elements[ 0 ] );
+
+    std::printf( "multiplyMatrices, %d products\n", count );
+    std::printf( "  independent  scalar %6.2f ns  simd %6.2f ns  speedup %.2fx\n",
+                 scalarTime, simdTime, scalarTime / simdTime );
+    std::printf( "  chained      scalar %6.2f ns  simd %6.2f ns  speedup %.2fx\n",
+                 scalarChainTime, simdChainTime, scalarChainTime / simdChainTime );
+    std::printf( "  results differing from scalar: %d\n", mismatches );
+}
@@ -0,0 +1,84 @@
+#include <cstdio>
+
+#include <QThread>
+#include <QThreadPool>
+
+#include "three/core/scenegraph.h"
+#include "three/math/random.h"
+
+#include "bench.h"
+
+using namespace three;
+
+namespace {
+
+// 16 roots of 64 branches, each branch 16 chains of 16 nodes: 263k nodes
+void buildHierarchy( SceneGraph& graph )
+{
+    Random random( 7 );
+    auto node = [&]( SceneGraph::NodeId parent ) {
+        SceneGraph::NodeId n = graph.create();
+        if ( parent != SceneGraph::NoNode ) {
+            graph.add( parent, n );
+        }
+        int s = graph.touch( n );
+        graph.positions[ s ].set( random.nextDouble( -1, 1 ), random.nextDouble( -1, 1 ), random.nextDouble( -1, 1 ) );
+        graph.quaternions[ s ].set( random.nextDouble(), random.nextDouble(), random.nextDouble(), 1 ).normalize();
+        return n;
+    };
+
+    for ( int r = 0; r < 16; r ++ ) {
+        SceneGraph::NodeId root = node( SceneGraph::NoNode );
+        for ( int b = 0; b < 64; b ++ ) {
+            SceneGraph::NodeId branch = node( root );
+            for ( int c = 0; c < 16; c ++ ) {
+                SceneGraph::NodeId parent = branch;
+                for ( int d = 0; d < 16; d ++ ) {
+                    parent = node( parent );
+                }
+            }
+        }
+    }
+    graph.updateMatrixWorld( true );
+}
+
+} // namespace
+
+void bench::sceneGraph()
+{
+    const int runs = 10;
+
+    SceneGraph graph;
+    buildHierarchy( graph );
+    const int count = graph.size();
+
+    // forced passes recompose and update every node
+    double serial = bench::time( count, runs, [&]() {
+        graph.updateMatrixWorld( true, false );
+    } );
+
+    std::printf( "updateMatrixWorld( force ), %d nodes\n", count );
+    std::printf( "  serial               %6.2f ns / node\n", serial );
+
+    QThreadPool* pool = QThreadPool::globalInstance();
+    const int maxThreads = pool->maxThreadCount();
+    for ( int threads = 1; threads <= QThread::idealThreadCount(); threads *= 2 ) {
+        pool->setMaxThreadCount( threads );
+        double parallel = bench::time( count, runs, [&]() {
+            graph.updateMatrixWorld( true, true );
+        } );
+        std::printf( "  parallel, %2d threads %6.2f ns / node  speedup %.2fx\n", threads, parallel, serial / parallel );
+    }
+    pool->setMaxThreadCount( maxThreads );
+
+    // only the touched nodes and their descendants are redone
+    Random random( 8 );
+    double touched = bench::time( count, runs, [&]() {
+        for ( int i = 0; i < count / 100; i ++ ) {
+            graph.touch( graph.nodes[ random.nextUInt( quint32( count ) ) ] );
+        }
+        graph.updateMatrixWorld( false, false );
+    } );
+    std::printf( "  1%% of the nodes touched, serial %6.2f ns / node ( %d recomposed, %d updated )\n",
+                 touched, graph.lastComposedCount, graph.lastUpdatedCount );
+}
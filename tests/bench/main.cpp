@@ -0,0 +1,48 @@
+#include <cstdio>
+#include <cstring>
+
+#include "bench.h"
+
+namespace bench {
+
+volatile double sink;
+
+void consume(const double &value)
+{
+    sink = sink + value;
+}
+
+} // namespace bench
+
+namespace {
+
+struct Benchmark
+{
+    const char* name;
+    void ( *run )();
+};
+
+const Benchmark benchmarks[] = {
+    { "matrix4", bench::matrix4 },
+    { "scenegraph", bench::sceneGraph },
+    { "frustum", bench::frustum },
+    { "ray", bench::ray }
+};
+
+} // namespace
+
+// runs the benchmarks named on the command line, all of them without
+int main(int argc, char *argv[])
+{
+    for ( const Benchmark& benchmark : benchmarks ) {
+        bool selected = argc < 2;
+        for ( int i = 1; i < argc; i ++ ) {
+            selected = selected || std::strcmp( argv[ i ], benchmark.name ) == 0;
+        }
+        if ( selected ) {
+            std::printf( "== %s\n", benchmark.name );
+            benchmark.run();
+        }
+    }
+    return 0;
+}